@@ -0,0 +1,103 @@
+//
+// bench-db: spectrum bin dB kernel against the scalar path
+//
+
+#include "bench.h"
+
+/*
+  First a comparison: for every float exponent (denormals, normals, inf and
+  NaN) and both signs, a spread of mantissas is converted by both paths,
+  one frame at a time, and every bin and the frame min/max must agree within
+  1e-3 dB; zero and denormals must give SPECTRUM_FLOOR_DB. The startup
+  self-check must also pass. Any mismatch is reported and the program exits
+  with status 1, so `make bench` stops there. The same bins_to_db() clones
+  and bins_to_db_scalar() the server runs are the ones tested.
+
+  Then the timing: ns per frame and per bin for BENCH_BINS-bin frames
+  (radiod's default), kernel against scalar.
+*/
+
+#define BENCH_BINS 1620
+#define BENCH_MANTISSAS 64
+
+static void bench_put(uint8_t *in, int i, uint32_t bits)
+{
+  uint32_t const u = htonl(bits);
+  memcpy(in + 4 * i, &u, sizeof(u));
+}
+
+static void bench_compare(void)
+{
+  enum { N = 2 * 256 * BENCH_MANTISSAS };
+  static uint8_t in[4 * N];
+  static float fast[N], ref[N];
+  static uint32_t bits[N];
+  int n = 0;
+  for (uint32_t sign = 0; sign < 2; sign++) {
+    for (uint32_t e = 0; e < 256; e++) {
+      for (int m = 0; m < BENCH_MANTISSAS; m++) {
+        uint32_t mant = m == 0 ? 0 : m == 1 ? 1 : m == 2 ? 0x7fffff : arc4random() & 0x7fffff;
+        bits[n] = sign << 31 | e << 23 | mant;
+        bench_put(in, n, bits[n]);
+        n++;
+      }
+    }
+  }
+  /* Frame by frame, so min/max are checked over realistic spans too */
+  for (int first = 0; first < n; first += BENCH_MANTISSAS) {
+    float fmin = INFINITY, fmax = -INFINITY, rmin = INFINITY, rmax = -INFINITY;
+    bins_to_db(fast + first, in + 4 * first, BENCH_MANTISSAS, &fmin, &fmax);
+    bins_to_db_scalar(ref + first, in + 4 * first, BENCH_MANTISSAS, &rmin, &rmax);
+    for (int i = first; i < first + BENCH_MANTISSAS; i++) {
+      bool const floor = ((bits[i] >> 23) & 0xff) == 0;
+      BENCH_CHECK(spectrum_db_equal(fast[i], ref[i]) && (!floor || fast[i] == SPECTRUM_FLOOR_DB),
+                  "bits %08x: kernel %.6f dB, scalar %.6f dB\n", bits[i], fast[i], ref[i]);
+    }
+    BENCH_CHECK(spectrum_db_equal(fmin, rmin) && spectrum_db_equal(fmax, rmax),
+                "frame at %08x: kernel min/max %f/%f, scalar %f/%f\n", bits[first], fmin, fmax, rmin, rmax);
+  }
+  spectrum_kernel_check();
+  BENCH_CHECK(!spectrum_kernel_scalar, "startup self-check failed\n");
+  printf("compare: %d bins, %d mismatches\n", n, bench_failures);
+}
+
+static uint8_t bench_in[4 * BENCH_BINS];
+
+static void bench_frame_kernel(void *arg)
+{
+  static float out[BENCH_BINS];
+  float mn = INFINITY, mx = -INFINITY;
+  (void)arg;
+  bins_to_db(out, bench_in, BENCH_BINS, &mn, &mx);
+}
+
+static void bench_frame_scalar(void *arg)
+{
+  static float out[BENCH_BINS];
+  float mn = INFINITY, mx = -INFINITY;
+  (void)arg;
+  bins_to_db_scalar(out, bench_in, BENCH_BINS, &mn, &mx);
+}
+
+int main(void)
+{
+  bench_compare();
+  if (bench_failures != 0)
+    return 1;
+
+  for (int i = 0; i < BENCH_BINS; i++) {
+    float const p = powf(10.0f, -15.0f + 10.0f * (float)(arc4random() % 10000) / 10000.0f);
+    uint32_t u;
+    memcpy(&u, &p, sizeof(u));
+    bench_put(bench_in, i, u);
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  printf("cpu: avx2 %s, sse4.1 %s\n", __builtin_cpu_supports("avx2") ? "yes" : "no",
+         __builtin_cpu_supports("sse4.1") ? "yes" : "no");
+#endif
+  double const k = bench_time(bench_frame_kernel, NULL, 1);
+  double const s = bench_time(bench_frame_scalar, NULL, 1);
+  printf("%d bins: kernel %.0f ns/frame (%.2f ns/bin), scalar %.0f ns/frame (%.2f ns/bin), %.1fx\n",
+         BENCH_BINS, k, k / BENCH_BINS, s, s / BENCH_BINS, s / k);
+  return 0;
+}
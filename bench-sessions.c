@@ -0,0 +1,289 @@
+//
+// bench-sessions: per-datagram session lookup + enqueue, old vs new
+//
+
+#include "bench.h"
+
+/*
+  First a check of the SSRC table under churn: one thread inserts and
+  deletes sessions over BENCH_CHURN_SLOTS SSRCs (forcing table rebuilds
+  and tombstones along the way) while two threads look SSRCs up and
+  enqueue to what they find. A lookup must never return a session for a
+  different SSRC. Afterwards every live SSRC must resolve to its session
+  and no deleted one may resolve at all.
+
+  Then the timing. For every audio datagram the ingest thread finds the
+  session owning its SSRC and queues a frame that references the packet
+  buffer. Two paths:
+
+  - old: walk the session list under session_mutex and queue with the lock
+    still held, as find_session_from_ssrc() did before the SSRC table.
+  - new: session_table_lookup() (lock-free probe plus a reference), queue,
+    session_put().
+
+  Each is run at 5, 50 and 500 sessions (the session list is built directly,
+  so MAX_SESSIONS does not apply), looking up SSRCs in a shuffled order, once
+  alone and once with a thread that holds session_mutex for 1 ms out of every
+  10 ms the way a status page render or delete_session() join does. The
+  audio ring of each session fills up and from then on every queue also
+  drops the oldest frame; that cost is the same on both paths.
+*/
+
+#define BENCH_CHURN_SLOTS 512
+#define BENCH_CHURN_OPS 20000
+#define BENCH_BATCH 1024 /* lookups per timed call */
+
+static atomic_bool bench_stop;
+
+static struct session *bench_session_new(uint32_t ssrc)
+{
+  struct session *sp = calloc(1, sizeof(*sp));
+  sp->ssrc = ssrc;
+  sp->ws_fd = -1;
+  atomic_init(&sp->refs, 1);
+  pthread_mutex_init(&sp->out_mutex, NULL);
+  pthread_cond_init(&sp->out_cond, NULL);
+  pthread_mutex_init(&sp->state_mutex, NULL);
+  pthread_mutex_init(&sp->spectrum_mutex, NULL);
+  pthread_mutex_init(&sp->ws_mutex, NULL);
+  return sp;
+}
+
+/* Lookup plus enqueue of one datagram, the way dispatch_audio_packet() does */
+static struct session *bench_lookup_enqueue(uint32_t ssrc, struct pktbuf *pb)
+{
+  struct session *sp = session_table_lookup(ssrc);
+  if (sp != NULL)
+    send_ws_pktbuf_to_session(sp, pb, 256, WS_CLASS_AUDIO);
+  return sp;
+}
+
+/* Churn check
+   ----------- */
+static struct session *bench_churn_slot[BENCH_CHURN_SLOTS]; /* churn thread only */
+static atomic_ulong bench_churn_hits;
+
+static uint32_t bench_churn_ssrc(int i)
+{
+  return 100000 + 2 * (uint32_t)i;
+}
+
+static void *bench_churn_writer(void *arg)
+{
+  (void)arg;
+  for (int op = 0; op < BENCH_CHURN_OPS; op++) {
+    int const i = (int)arc4random_uniform(BENCH_CHURN_SLOTS);
+    pthread_mutex_lock(&session_mutex);
+    struct session *sp = bench_churn_slot[i];
+    if (sp == NULL) {
+      bench_churn_slot[i] = bench_session_new(bench_churn_ssrc(i));
+      session_table_insert(bench_churn_slot[i]);
+      pthread_mutex_unlock(&session_mutex);
+    } else {
+      session_table_remove(sp);
+      bench_churn_slot[i] = NULL;
+      pthread_mutex_unlock(&session_mutex);
+      synchronize_rcu();
+      session_put(sp);
+    }
+  }
+  return NULL;
+}
+
+static void *bench_churn_reader(void *arg)
+{
+  (void)arg;
+  struct pktbuf *pb = pktbuf_alloc();
+  memset(pb->data, 0, 256);
+  while (!atomic_load(&bench_stop)) {
+    uint32_t const ssrc = bench_churn_ssrc((int)arc4random_uniform(BENCH_CHURN_SLOTS));
+    struct session *sp = bench_lookup_enqueue(ssrc, pb);
+    if (sp != NULL) {
+      BENCH_CHECK(sp->ssrc == ssrc, "lookup of %u returned session %u\n", ssrc, sp->ssrc);
+      atomic_fetch_add(&bench_churn_hits, 1);
+      session_put(sp);
+    }
+  }
+  pktbuf_put(pb);
+  return NULL;
+}
+
+static void bench_churn(void)
+{
+  pthread_t writer, readers[2];
+  atomic_store(&bench_stop, false);
+  for (int i = 0; i < 2; i++)
+    pthread_create(&readers[i], NULL, bench_churn_reader, NULL);
+  pthread_create(&writer, NULL, bench_churn_writer, NULL);
+  pthread_join(writer, NULL);
+  atomic_store(&bench_stop, true);
+  for (int i = 0; i < 2; i++)
+    pthread_join(readers[i], NULL);
+
+  int live = 0;
+  for (int i = 0; i < BENCH_CHURN_SLOTS; i++) {
+    struct session *sp = session_table_lookup(bench_churn_ssrc(i));
+    if (bench_churn_slot[i] != NULL) {
+      live++;
+      BENCH_CHECK(sp == bench_churn_slot[i], "live ssrc %u resolves to %p, expected %p\n",
+                  bench_churn_ssrc(i), (void *)sp, (void *)bench_churn_slot[i]);
+    } else {
+      BENCH_CHECK(sp == NULL, "deleted ssrc %u still resolves\n", bench_churn_ssrc(i));
+    }
+    if (sp != NULL)
+      session_put(sp);
+  }
+  printf("churn: %d inserts/deletes, %lu hits during churn, %d live after, %d failures\n",
+         BENCH_CHURN_OPS, (unsigned long)atomic_load(&bench_churn_hits), live, bench_failures);
+
+  pthread_mutex_lock(&session_mutex);
+  for (int i = 0; i < BENCH_CHURN_SLOTS; i++)
+    if (bench_churn_slot[i] != NULL)
+      session_table_remove(bench_churn_slot[i]);
+  pthread_mutex_unlock(&session_mutex);
+  synchronize_rcu();
+  for (int i = 0; i < BENCH_CHURN_SLOTS; i++) {
+    if (bench_churn_slot[i] != NULL)
+      session_put(bench_churn_slot[i]);
+    bench_churn_slot[i] = NULL;
+  }
+}
+
+/* Timing
+   ------ */
+static struct session **bench_sessions;
+
+static struct session *bench_find_old(uint32_t ssrc)
+{
+  pthread_mutex_lock(&session_mutex);
+  struct session *sp = sessions;
+  while (sp != NULL && sp->ssrc != ssrc)
+    sp = sp->next;
+  if (sp == NULL)
+    pthread_mutex_unlock(&session_mutex);
+  return sp;
+}
+
+static void bench_setup(int n)
+{
+  bench_sessions = calloc((size_t)n, sizeof(*bench_sessions));
+  pthread_mutex_lock(&session_mutex);
+  for (int i = 0; i < n; i++) {
+    struct session *sp = bench_session_new(1000 + 2 * (uint32_t)i);
+    sp->next = sessions;
+    if (sessions != NULL)
+      sessions->previous = sp;
+    sessions = sp;
+    nsessions++;
+    session_table_insert(sp);
+    bench_sessions[i] = sp;
+  }
+  pthread_mutex_unlock(&session_mutex);
+}
+
+static void bench_teardown(int n)
+{
+  pthread_mutex_lock(&session_mutex);
+  for (int i = 0; i < n; i++)
+    session_table_remove(bench_sessions[i]);
+  sessions = NULL;
+  nsessions = 0;
+  pthread_mutex_unlock(&session_mutex);
+  synchronize_rcu();
+  for (int i = 0; i < n; i++)
+    session_put(bench_sessions[i]);
+  free(bench_sessions);
+}
+
+static void *bench_contend_thread(void *arg)
+{
+  (void)arg;
+  while (!atomic_load(&bench_stop)) {
+    pthread_mutex_lock(&session_mutex);
+    usleep(1000);
+    pthread_mutex_unlock(&session_mutex);
+    usleep(9000);
+  }
+  return NULL;
+}
+
+struct bench_run {
+  bool old;
+  int n;
+  uint32_t const *order;
+  struct pktbuf *pb;
+  int next;
+  uint64_t worst_ns; /* slowest sampled single lookup+enqueue */
+};
+
+static void bench_batch(void *arg)
+{
+  struct bench_run *r = arg;
+  for (int i = 0; i < BENCH_BATCH; i++) {
+    uint64_t const t0 = (i & 63) == 0 ? mono_ns() : 0;
+    uint32_t const ssrc = r->order[r->next];
+    r->next = (r->next + 1) % r->n;
+    if (r->old) {
+      struct session *sp = bench_find_old(ssrc);
+      if (sp != NULL) {
+        send_ws_pktbuf_to_session(sp, r->pb, 256, WS_CLASS_AUDIO);
+        pthread_mutex_unlock(&session_mutex);
+      }
+      BENCH_CHECK(sp != NULL, "old path: ssrc %u not found\n", ssrc);
+    } else {
+      struct session *sp = bench_lookup_enqueue(ssrc, r->pb);
+      BENCH_CHECK(sp != NULL && sp->ssrc == ssrc, "new path: ssrc %u not found\n", ssrc);
+      if (sp != NULL)
+        session_put(sp);
+    }
+    if (t0 != 0) {
+      uint64_t const d = mono_ns() - t0;
+      if (d > r->worst_ns)
+        r->worst_ns = d;
+    }
+  }
+}
+
+int main(void)
+{
+  bench_churn();
+
+  static int const sizes[] = { 5, 50, 500 };
+  struct pktbuf *pb = pktbuf_alloc();
+  memset(pb->data, 0, 256);
+  printf("%8s %10s %14s %14s %14s %14s\n", "sessions", "contended", "old ns/op", "new ns/op", "old worst us", "new worst us");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    int const n = sizes[s];
+    bench_setup(n);
+    uint32_t *order = malloc(sizeof(*order) * (size_t)n);
+    for (int i = 0; i < n; i++)
+      order[i] = bench_sessions[i]->ssrc;
+    for (int i = n - 1; i > 0; i--) {
+      int const j = (int)arc4random_uniform((uint32_t)(i + 1));
+      uint32_t const t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+    for (int contend = 0; contend < 2; contend++) {
+      pthread_t ct;
+      if (contend) {
+        atomic_store(&bench_stop, false);
+        pthread_create(&ct, NULL, bench_contend_thread, NULL);
+      }
+      struct bench_run old = { .old = true, .n = n, .order = order, .pb = pb };
+      struct bench_run new = { .old = false, .n = n, .order = order, .pb = pb };
+      double const o = bench_time(bench_batch, &old, BENCH_BATCH);
+      double const w = bench_time(bench_batch, &new, BENCH_BATCH);
+      if (contend) {
+        atomic_store(&bench_stop, true);
+        pthread_join(ct, NULL);
+      }
+      printf("%8d %10s %14.1f %14.1f %14.1f %14.1f\n", n, contend ? "yes" : "no", o, w,
+             old.worst_ns / 1000.0, new.worst_ns / 1000.0);
+    }
+    free(order);
+    bench_teardown(n);
+  }
+  pktbuf_put(pb);
+  return bench_failures != 0;
+}
@@ -0,0 +1,286 @@
+//
+// bench-tlv: status packet decode, full decode_radio_status() vs the index
+//
+
+#include "bench.h"
+
+/*
+  Input is the status records of a capture made with `ka9q-web -w file`
+  (bench-tlv file), or, without an argument, packets built the way
+  radiod-sim answers a poll: a channel status and a spectrum frame of
+  1024 float bins and of 1024 byte bins, plus a channel status in which
+  RADIO_FREQUENCY, PRESET and LOW_EDGE each appear twice.
+
+  First a check that the index decodes the same thing the old sequential
+  switch did. decode_radio_status_index() applies fields in type order,
+  last instance winning; the reference walks the packet in wire order and
+  applies each TLV on its own, through the same per-field decoder. Both
+  start from zeroed structures, and the resulting struct frontend and
+  struct channel must be byte-identical for every packet.
+
+  Then the timing, per packet, in ns:
+  - index:  tlv_index() alone, the one scan dispatch_status_packet() does.
+  - full:   decode_radio_status(), which scans and decodes every field; what
+            every status and spectrum packet cost before the index.
+  - fields: decode_radio_status_index() of spectrum_status_fields from an
+            existing index, what process_spectrum_packet() does now.
+  - all:    decode_radio_status_index() of every field from an existing
+            index, what process_status_packet() does now.
+*/
+
+struct bench_pkt {
+  uint8_t const *data; /* starts after the packet type byte */
+  size_t len;
+};
+
+static struct bench_pkt *bench_pkts;
+static int bench_npkts;
+
+static void bench_add(uint8_t const *data, size_t len)
+{
+  if (len < 2 || data[0] != STATUS)
+    return;
+  bench_pkts = realloc(bench_pkts, sizeof(*bench_pkts) * (size_t)(bench_npkts + 1));
+  bench_pkts[bench_npkts].data = data + 1;
+  bench_pkts[bench_npkts].len = len - 1;
+  bench_npkts++;
+}
+
+static int bench_load(char const *path)
+{
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    perror(path);
+    return -1;
+  }
+  uint8_t const *map = st.st_size > 0 ? mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (map == MAP_FAILED || st.st_size < CAPTURE_HEADER || memcmp(map, CAPTURE_MAGIC, 8) != 0
+      || get_le(map + 8, 4) != CAPTURE_VERSION) {
+    fprintf(stderr, "%s: not a ka9q-web capture\n", path);
+    return -1;
+  }
+  size_t const size = (size_t)st.st_size;
+  for (size_t off = CAPTURE_HEADER; off + CAPTURE_RECORD <= size;) {
+    uint8_t const *rec = map + off;
+    size_t const len = (size_t)get_le(rec + 8, 4);
+    if (off + CAPTURE_RECORD + len > size)
+      break;
+    if (rec[12] == CAPTURE_STATUS)
+      bench_add(rec + CAPTURE_RECORD, len);
+    off += CAPTURE_RECORD + len;
+  }
+  return 0;
+}
+
+/* Same fields, in the same order, as radiod-sim's sim_status(); kind 3 is
+   a channel status with repeated fields */
+static size_t bench_build(uint8_t *buf, uint32_t ssrc, int kind)
+{
+  uint8_t *bp = buf;
+  *bp++ = STATUS;
+  encode_int32(&bp, OUTPUT_SSRC, ssrc);
+  encode_int32(&bp, COMMAND_TAG, arc4random());
+  encode_int32(&bp, CMD_CNT, 1234);
+  encode_int64(&bp, GPS_TIME, (uint64_t)time(NULL) * 1000000000ULL);
+  encode_string(&bp, DESCRIPTION, "radiod-sim", strlen("radiod-sim"));
+  encode_int32(&bp, INPUT_SAMPRATE, 64800000);
+  encode_int(&bp, FILTER_BLOCKSIZE, 4800);
+  encode_int(&bp, FILTER_FIR_LENGTH, 4801);
+  encode_float(&bp, IF_POWER, -40.0);
+  encode_int(&bp, DEMOD_TYPE, kind == 1 ? SPECT_DEMOD : kind == 2 ? SPECT2_DEMOD : LINEAR_DEMOD);
+  encode_double(&bp, RADIO_FREQUENCY, 14074000.0);
+  if (kind == 0 || kind == 3) {
+    encode_string(&bp, PRESET, "usb", 3);
+    encode_double(&bp, SHIFT_FREQUENCY, 0.0);
+    encode_float(&bp, LOW_EDGE, 50.0);
+    encode_float(&bp, HIGH_EDGE, 3000.0);
+    encode_int32(&bp, OUTPUT_SAMPRATE, 12000);
+    encode_int(&bp, OUTPUT_ENCODING, S16BE);
+    encode_int(&bp, OUTPUT_CHANNELS, 1);
+    encode_float(&bp, BASEBAND_POWER, -60.0);
+    encode_float(&bp, NOISE_DENSITY, -150.0);
+    if (kind == 3) {
+      encode_double(&bp, RADIO_FREQUENCY, 7074000.0);
+      encode_string(&bp, PRESET, "lsb", 3);
+      encode_float(&bp, LOW_EDGE, -3000.0);
+    }
+  } else {
+    float power[1024];
+    uint8_t codes[1024];
+    for (int i = 0; i < 1024; i++) {
+      power[i] = 1e-12f * (1.0f + (float)(arc4random() % 1000));
+      codes[i] = (uint8_t)(arc4random() % 256);
+    }
+    encode_int(&bp, BIN_COUNT, 1024);
+    encode_float(&bp, RESOLUTION_BW, 1000.0);
+    encode_int(&bp, SPECTRUM_AVG, 1);
+    encode_int(&bp, WINDOW_TYPE, 0);
+    if (kind == 1) {
+      encode_vector(&bp, BIN_DATA, power, 1024);
+    } else {
+      encode_float(&bp, SPECTRUM_BASE, -150.0);
+      encode_float(&bp, SPECTRUM_STEP, 0.5);
+      encode_string(&bp, BIN_BYTE_DATA, codes, 1024);
+    }
+  }
+  encode_eol(&bp);
+  return (size_t)(bp - buf);
+}
+
+/* Equivalence check
+   ----------------- */
+
+/* Apply the packet's TLVs one at a time in wire order, as the old switch
+   did; the walk stops where tlv_index() would */
+static void bench_decode_wire(struct frontend *fe, struct channel *ch, uint8_t const *buf, size_t len)
+{
+  static struct tlv_index one;
+  uint8_t const *cp = buf;
+  uint8_t const *const end = buf + len;
+  while (cp < end) {
+    uint8_t const *const tlv = cp;
+    if (*cp++ == EOL || cp >= end)
+      break;
+    unsigned int optlen = *cp++;
+    if (optlen & 0x80) {
+      int n = optlen & 0x7f;
+      if (n > (int)sizeof(optlen) || cp + n > end)
+        break;
+      for (optlen = 0; n > 0; n--)
+        optlen = optlen << 8 | *cp++;
+    }
+    if (optlen > (size_t)(end - cp))
+      break;
+    cp += optlen;
+    tlv_index(&one, tlv, (size_t)(cp - tlv));
+    decode_radio_status_index(fe, ch, &one, NULL, 0);
+  }
+}
+
+/* Byte offset of the first difference, or -1 */
+static long bench_diff(void const *a, void const *b, size_t n)
+{
+  uint8_t const *x = a, *y = b;
+  for (size_t i = 0; i < n; i++)
+    if (x[i] != y[i])
+      return (long)i;
+  return -1;
+}
+
+static void bench_equivalence(void)
+{
+  struct frontend *fe[2] = { malloc(sizeof(struct frontend)), malloc(sizeof(struct frontend)) };
+  struct channel *ch[2] = { malloc(sizeof(struct channel)), malloc(sizeof(struct channel)) };
+  for (int i = 0; i < bench_npkts; i++) {
+    struct bench_pkt const *p = &bench_pkts[i];
+    for (int k = 0; k < 2; k++) {
+      memset(fe[k], 0, sizeof(*fe[k]));
+      memset(ch[k], 0, sizeof(*ch[k]));
+    }
+    bench_decode_wire(fe[0], ch[0], p->data, p->len);
+    decode_radio_status(fe[1], ch[1], p->data, p->len);
+    long const dfe = bench_diff(fe[0], fe[1], sizeof(*fe[0]));
+    long const dch = bench_diff(ch[0], ch[1], sizeof(*ch[0]));
+    BENCH_CHECK(dfe < 0 && dch < 0, "packet %d (ssrc %u): struct %s differs at byte %ld\n", i,
+                get_ssrc(p->data, p->len), dfe >= 0 ? "frontend" : "channel", dfe >= 0 ? dfe : dch);
+  }
+  printf("equivalence: %d packets, %d mismatches\n", bench_npkts, bench_failures);
+  for (int k = 0; k < 2; k++) {
+    free(fe[k]);
+    free(ch[k]);
+  }
+}
+
+/* Timing
+   ------ */
+enum bench_op { OP_INDEX, OP_FULL, OP_FIELDS, OP_ALL, OP_N };
+static char const *const bench_op_names[OP_N] = { "index", "full", "fields", "all" };
+
+struct bench_run {
+  enum bench_op op;
+  struct bench_pkt const *pkts;
+  struct tlv_index *idx;
+  int n;
+};
+
+static void bench_pass(void *arg)
+{
+  struct bench_run const *r = arg;
+  for (int i = 0; i < r->n; i++) {
+    struct bench_pkt const *p = &r->pkts[i];
+    switch (r->op) {
+    case OP_INDEX:
+      tlv_index(&r->idx[i], p->data, p->len);
+      break;
+    case OP_FULL:
+      decode_radio_status(&Frontend, &Channel, p->data, p->len);
+      break;
+    case OP_FIELDS:
+      decode_radio_status_index(&Frontend, &Channel, &r->idx[i], spectrum_status_fields,
+                                sizeof(spectrum_status_fields) / sizeof(spectrum_status_fields[0]));
+      break;
+    default:
+      decode_radio_status_index(&Frontend, &Channel, &r->idx[i], NULL, 0);
+      break;
+    }
+  }
+}
+
+static void bench_report(char const *name, int first, int n)
+{
+  if (n == 0)
+    return;
+  struct bench_run r = { .pkts = bench_pkts + first, .n = n, .idx = malloc(sizeof(struct tlv_index) * (size_t)n) };
+  for (int i = 0; i < n; i++)
+    tlv_index(&r.idx[i], r.pkts[i].data, r.pkts[i].len);
+  printf("%-22s %6d", name, n);
+  for (r.op = 0; r.op < OP_N; r.op++)
+    printf(" %10.1f", bench_time(bench_pass, &r, (unsigned long)n));
+  printf("\n");
+  free(r.idx);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1) {
+    if (bench_load(argv[1]) == -1)
+      return 1;
+  } else {
+    static uint8_t built[4][PKTSIZE];
+    for (int k = 0; k < 4; k++)
+      bench_add(built[k], bench_build(built[k], k == 1 || k == 2 ? 1001 : 1000, k));
+  }
+  if (bench_npkts == 0) {
+    fprintf(stderr, "no status packets\n");
+    return 1;
+  }
+  bench_equivalence();
+
+  printf("%-22s %6s", "ns per packet", "pkts");
+  for (int op = 0; op < OP_N; op++)
+    printf(" %10s", bench_op_names[op]);
+  printf("\n");
+  if (argc > 1) {
+    /* Split the capture into channel status (even SSRC) and spectrum (odd) */
+    struct bench_pkt *sorted = malloc(sizeof(*sorted) * (size_t)bench_npkts);
+    int neven = 0, nodd = 0;
+    for (int i = 0; i < bench_npkts; i++)
+      if (get_ssrc(bench_pkts[i].data, bench_pkts[i].len) % 2 == 0)
+        sorted[neven++] = bench_pkts[i];
+    for (int i = 0; i < bench_npkts; i++)
+      if (get_ssrc(bench_pkts[i].data, bench_pkts[i].len) % 2 == 1)
+        sorted[neven + nodd++] = bench_pkts[i];
+    free(bench_pkts);
+    bench_pkts = sorted;
+    bench_report("channel status", 0, neven);
+    bench_report("spectrum", neven, nodd);
+  } else {
+    bench_report("channel status", 0, 1);
+    bench_report("spectrum BIN_DATA", 1, 1);
+    bench_report("spectrum BIN_BYTE_DATA", 2, 1);
+    bench_report("repeated fields", 3, 1);
+  }
+  return bench_failures != 0;
+}
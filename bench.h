@@ -0,0 +1,43 @@
+//
+// bench.h: scaffolding shared by the bench-* programs
+//
+// Including it builds ka9q-web.c into the program with its main() renamed,
+// so the server's static functions and data are measured as they are, not
+// copies of them.
+// `make bench` runs every bench; each exits non-zero if a check failed.
+//
+
+#ifndef _BENCH_H
+#define _BENCH_H 1
+
+#define main ka9q_web_main
+#include "ka9q-web.c"
+#undef main
+
+#define BENCH_RUN_NS 500000000ULL /* run each measurement for about 0.5 s */
+
+/* Failed checks so far; main() returns bench_failures != 0 */
+static int bench_failures;
+
+/* Count a failed check, reporting the first few */
+#define BENCH_CHECK(cond, ...)                          \
+  do {                                                  \
+    if (!(cond) && bench_failures++ < 10)               \
+      fprintf(stderr, __VA_ARGS__);                     \
+  } while (0)
+
+/* Call `fn(arg)` repeatedly for about BENCH_RUN_NS; each call performs
+   `ops` operations. Returns ns per operation. */
+static inline double bench_time(void (*fn)(void *arg), void *arg, unsigned long ops)
+{
+  uint64_t calls = 0, elapsed;
+  uint64_t const start = mono_ns();
+  do {
+    fn(arg);
+    calls++;
+    elapsed = mono_ns() - start;
+  } while (elapsed < BENCH_RUN_NS);
+  return (double)elapsed / ((double)calls * (double)ops);
+}
+
+#endif
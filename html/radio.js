@@ -602,6 +602,109 @@ function applyQuickBW() {
       function ntohl(v) { return v >>> 0; }
       function ntohf(v) { return v; }
 
+      // Compressed spectrum frames (payload type 0x7C, opted in with X:1):
+      // the codes of the last decoded frame and its frame number
+      let spectrumRef = null;
+      let spectrumRefSeq = -1;
+      let spectrumKeyRequestTs = 0;
+      let spectrumCodingInfo = '';
+      let spectrumFrameMs = 0;
+      let spectrumRateMs = 0;
+
+      // Bin reduction: tell the server how many pixels the spectrum is drawn
+      // on (D:<px>[:max|mean|min]) so it does not send bins we cannot show.
+      // localStorage 'spectrumReduce' picks the mode, or 'off' for every bin.
+      let spectrumReportedPx = -1;
+      let spectrumResizeTimer = null;
+      function reportSpectrumWidth(force) {
+        if (!ws || ws.readyState !== WebSocket.OPEN) return;
+        let mode = null;
+        try { mode = window.localStorage ? localStorage.getItem('spectrumReduce') : null; } catch (e) {}
+        let px = 0;
+        if (mode !== 'off') {
+          const canvas = (typeof spectrum !== 'undefined' && spectrum && spectrum.canvas) ? spectrum.canvas : document.getElementById('waterfall');
+          const cssWidth = canvas ? canvas.clientWidth : 0;
+          px = Math.round(cssWidth * (window.devicePixelRatio || 1));
+        }
+        if (!force && px === spectrumReportedPx) return;
+        spectrumReportedPx = px;
+        const suffix = (mode === 'mean' || mode === 'min' || mode === 'max') ? ':' + mode : '';
+        try { ws.send('D:' + px + suffix); } catch (e) { console.warn('Failed to send D:', e); }
+      }
+      window.addEventListener('resize', function() {
+        if (spectrumResizeTimer) clearTimeout(spectrumResizeTimer);
+        spectrumResizeTimer = setTimeout(function() { spectrumResizeTimer = null; reportSpectrumWidth(false); }, 250);
+      });
+
+      // Decode the body of a compressed spectrum frame starting at `off`.
+      // Returns the codes, or null when the frame cannot be used (a delta
+      // frame that does not follow the last frame decoded).
+      function decodeSpectrumDelta(view, off, bits) {
+        const end = view.byteLength;
+        const bodyStart = off;
+        if (off + 8 > end) return null;
+        const flags = view.getUint8(off);
+        const seq = view.getUint16(off + 2, true);
+        const rawLen = view.getUint16(off + 4, true);
+        const encodeUs = view.getUint16(off + 6, true);
+        off += 8;
+        const key = (flags & 1) !== 0;
+        if (!key && (spectrumRef === null || spectrumRef.length !== rawLen || ((spectrumRefSeq + 1) & 0xffff) !== seq)) {
+          spectrumRefSeq = -1;
+          return null;
+        }
+        const sym = new Uint8Array(rawLen);
+        if (flags & 2) {
+          // rANS: symbol table, 32-bit state, then the byte stream
+          if (off + 1 > end) return null;
+          const nsym = view.getUint8(off) + 1; off += 1;
+          if (off + 3 * nsym + 4 > end) return null;
+          const total = 1 << 12;
+          const freq = new Uint16Array(256), start = new Uint16Array(256);
+          const slot2sym = new Uint8Array(total);
+          let cum = 0;
+          for (let k = 0; k < nsym; k++) {
+            const s = view.getUint8(off), f = view.getUint16(off + 1, true);
+            off += 3;
+            if (cum + f > total) return null;
+            freq[s] = f; start[s] = cum;
+            slot2sym.fill(s, cum, cum + f);
+            cum += f;
+          }
+          if (cum !== total) return null;
+          let x = view.getUint32(off, true) >>> 0; off += 4;
+          for (let k = 0; k < rawLen; k++) {
+            const slot = x & (total - 1);
+            const s = slot2sym[slot];
+            sym[k] = s;
+            x = (freq[s] * (x >>> 12) + slot - start[s]) >>> 0;
+            while (x < (1 << 23) && off < end) { x = ((x << 8) | view.getUint8(off++)) >>> 0; }
+          }
+        } else {
+          if (off + rawLen > end) return null;
+          sym.set(new Uint8Array(view.buffer, view.byteOffset + off, rawLen));
+        }
+        const codes = new Uint8Array(rawLen);
+        if (key) {
+          codes.set(sym);
+        } else if (bits === 4) {
+          for (let k = 0; k < rawLen; k++) {
+            codes[k] = (((spectrumRef[k] >> 4) + (sym[k] >> 4)) & 0x0f) << 4 | ((spectrumRef[k] + sym[k]) & 0x0f);
+          }
+        } else if (bits === 16) {
+          for (let k = 0; k + 1 < rawLen; k += 2) {
+            const v = ((spectrumRef[k] | (spectrumRef[k + 1] << 8)) + (sym[k] | (sym[k + 1] << 8))) & 0xffff;
+            codes[k] = v & 0xff; codes[k + 1] = v >> 8;
+          }
+        } else {
+          for (let k = 0; k < rawLen; k++) codes[k] = (spectrumRef[k] + sym[k]) & 0xff;
+        }
+        spectrumRef = codes;
+        spectrumRefSeq = seq;
+        spectrumCodingInfo = `, spectrum x${(rawLen / Math.max(1, end - bodyStart)).toFixed(1)} ${encodeUs} \u00b5s`;
+        return codes;
+      }
+
       function calcFrequencies() {
         lowHz = centerHz - ((binWidthHz * binCount) / 2);
         highHz = centerHz + ((binWidthHz * binCount) / 2);
@@ -619,6 +722,27 @@ function applyQuickBW() {
           /* Always force a known spectrum state on connect.
              1) Stop first to clear any stale server-side spectrum flags.
              2) Start only when UI state is run (not paused). */
+          // Spectrum frame format: v2 with 8-bit codes unless localStorage
+          // 'spectrumBits' asks for 4 (half the bandwidth), 16, or 0 (v1 frames)
+          try {
+            const savedBits = window.localStorage ? localStorage.getItem('spectrumBits') : null;
+            const bits = (savedBits === '0' || savedBits === '4' || savedBits === '16') ? savedBits : '8';
+            ws.send('Q:' + bits);
+            // Compressed spectrum frames are opt-in (localStorage 'spectrumCompress' = '1')
+            const compress = window.localStorage ? localStorage.getItem('spectrumCompress') : null;
+            spectrumRef = null;
+            spectrumRefSeq = -1;
+            spectrumCodingInfo = '';
+            if (compress === '1') ws.send('X:1');
+            reportSpectrumWidth(true);
+            // Spectrum interval bounds: the server adapts between the fastest
+            // (localStorage 'spectrumRateMs', default 100) and the slowest
+            // ('spectrumSlowestMs', default 2000) to what the link sustains
+            const fastMs = parseInt((window.localStorage && localStorage.getItem('spectrumRateMs')) || '100', 10);
+            const slowMs = parseInt((window.localStorage && localStorage.getItem('spectrumSlowestMs')) || '2000', 10);
+            spectrumRateMs = 0;
+            if (fastMs > 0) ws.send('R:' + fastMs + ':' + (slowMs >= fastMs ? slowMs : fastMs));
+          } catch (e) { console.warn('Failed to send Q:', e); }
           try { ws.send("S:STOP"); } catch (e) { console.warn('Failed to send S:STOP:', e); }
           if (!spectrum.paused) {
             try { setTimeout(() => { if (ws && ws.readyState === WebSocket.OPEN) ws.send("S:"); }, 80); } catch (e) { console.warn('Failed to send S:', e); }
@@ -1136,6 +1260,12 @@ function applyQuickBW() {
               return;
             }
           } catch (e) {}
+          // RATE:<ms>: spectrum interval the server settled on for our link
+          if (args[0] === 'RATE' && args.length > 1) {
+            const ms = parseInt(args[1], 10);
+            if (Number.isFinite(ms) && ms > 0) spectrumRateMs = ms;
+            return;
+          }
           if(args[0]=='S') { // get our ssrc
             ssrc=parseInt(args[1]);
           }
@@ -1389,6 +1519,8 @@ function applyQuickBW() {
           var data_length = data.byteLength - i;
           var update = 0;
           switch (type) {
+            case 0x7C: // SPECTRUM DATA, compressed v2 frame (opted in with X:1)
+            case 0x7D: // SPECTRUM DATA, v2 frame (negotiated with Q:<bits>)
             case 0x7F: // SPECTRUM DATA
             const newBinCount = view.getUint32(i, false); i += 4;
             if (binCount != newBinCount) {
@@ -1442,6 +1574,20 @@ function applyQuickBW() {
             const z_level = view.getUint32(i,true); i+=4;
             const bins_autorange_offset =  view.getFloat32(i,true); i+=4;
             const bins_autorange_gain =  view.getFloat32(i,true); i+=4;
+            // v2 frames: version, code width in bits, number of codes
+            let code_bits = 8;
+            let code_count = 0;
+            if (type !== 0x7F) {
+              if (!ensure(i, 4)) { console.warn('Truncated v2 spectrum header'); return; }
+              const frame_version = view.getUint8(i);
+              code_bits = view.getUint8(i + 1);
+              code_count = view.getUint16(i + 2, true);
+              i += 4;
+              if (frame_version !== 2 || (code_bits !== 4 && code_bits !== 8 && code_bits !== 16)) {
+                console.warn('Unsupported spectrum frame version/bits', frame_version, code_bits);
+                return;
+              }
+            }
 
             if(update) {
               calcFrequencies();
@@ -1524,17 +1670,49 @@ function applyQuickBW() {
                 }
               } catch (e) { /* ignore popup errors */ }
             }
+              const frameStartMs = performance.now();
               var dataBuffer = evt.data.slice(i,data.byteLength);
-              const i8 = new Uint8Array(dataBuffer);
-              const arr = new Float32Array(binCount);
+              let i8 = new Uint8Array(dataBuffer);
+              if (type === 0x7C) {
+                i8 = decodeSpectrumDelta(view, i, code_bits);
+                if (i8 === null) {
+                  // Lost our reference: skip the frame and ask for a keyframe
+                  const nowTs = Date.now();
+                  if (nowTs - spectrumKeyRequestTs > 1000 && ws && ws.readyState === WebSocket.OPEN) {
+                    spectrumKeyRequestTs = nowTs;
+                    try { ws.send('X:K'); } catch (e) {}
+                  }
+                  break;
+                }
+              }
+              // With bin reduction (D:<px>) a frame has fewer codes than binCount;
+              // each then covers binCount / nCodes bins of the same span.
+              let nCodes = Math.min(binCount, Math.floor(i8.length * 8 / code_bits));
+              if (code_count > 0 && code_count < nCodes) nCodes = code_count;
+              const arr = new Float32Array(nCodes);
+              spectrum.bins = nCodes;
               // dynamic autorange of 8 bit bin levels, using offset/gain from webserver
               // Guard against gain==0 (no SPECT2 packet received yet): fall back to
               // radiod's init_chan default of 0.5 dB/step so placeholder frames are visible.
               const effective_gain = (bins_autorange_gain !== 0) ? bins_autorange_gain : 0.5;
-              for (i = 0; i < binCount; i++) {
-                arr[i] = bins_autorange_offset + (effective_gain * i8[i]);
+              if (code_bits === 4) {
+                for (i = 0; i < nCodes; i++) {
+                  const b = i8[i >> 1];
+                  arr[i] = bins_autorange_offset + (effective_gain * ((i & 1) ? (b & 0x0f) : (b >> 4)));
+                }
+              } else if (code_bits === 16) {
+                for (i = 0; i < nCodes; i++) {
+                  arr[i] = bins_autorange_offset + (effective_gain * (i8[2 * i] | (i8[2 * i + 1] << 8)));
+                }
+              } else {
+                for (i = 0; i < nCodes; i++) {
+                  arr[i] = bins_autorange_offset + (effective_gain * i8[i]);
+                }
               }
               spectrum.addData(arr);
+              // Client cost of a frame (decode + draw), averaged over ~16 frames
+              const frameMs = performance.now() - frameStartMs;
+              spectrumFrameMs = spectrumFrameMs === 0 ? frameMs : spectrumFrameMs + (frameMs - spectrumFrameMs) / 16;
             /*
             if (pending_range_update) {
                 pending_range_update = false;
@@ -3310,7 +3488,7 @@ function adjustRange(element, event) {
 function level_to_string(f) {
   let bin = spectrum.hz_to_bin(f);
   let s = "";
-  if ((bin < 0) || (bin >= binCount)) {
+  if ((bin < 0) || (bin >= spectrum.bins)) {
     return;
   }
 
@@ -3404,7 +3582,9 @@ function update_stats() {
     spectrumAvgInputEl.value = spectrum_average;
   }
   document.getElementById('decay').innerHTML = "Decay: " + spectrum.decay.toString();
-  document.getElementById("rx_rate").textContent = `RX rate: ${((rx_rate / 1000.0) * 8.0).toFixed(0)} kbps`;
+  document.getElementById("rx_rate").textContent = `RX rate: ${((rx_rate / 1000.0) * 8.0).toFixed(0)} kbps` + spectrumCodingInfo +
+    (spectrumFrameMs > 0 ? `, ${spectrum.bins} bins ${spectrumFrameMs.toFixed(2)} ms/frame` : '') +
+    (spectrumRateMs > 0 ? `, ${(1000 / spectrumRateMs).toFixed(1)} frames/s` : '');
   if (typeof ssrc !== 'undefined') {
     document.getElementById('ssrc').innerHTML = "SSRC: " + ssrc.toString();
   }
@@ -3627,7 +3807,7 @@ function buildCSV() {
   var csvContent = data.map(row => row.join(",")).join("\n");
 
   csvContent += "\n\nBin, Amplitude (dB?), Average (dB?), Max hold (dB?), Min hold (dB?)\n";
-  for(let i = 0; i < binCount; i++) {
+  for(let i = 0; i < spectrum.bins; i++) {
     let b = (typeof spectrum.bin_copy !== 'undefined') ? spectrum.bin_copy[i].toFixed(3) : "";
     let a = (typeof spectrum.binsAverage !== 'undefined') ? spectrum.binsAverage[i].toFixed(3) : "";
     let m = (typeof spectrum.binsMax !== 'undefined') ? spectrum.binsMax[i].toFixed(3) : "";
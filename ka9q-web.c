@@ -44,6 +44,17 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/filter.h>
+#include <linux/sock_diag.h>
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
 
 #include "misc.h"
 #include "multicast.h"
@@ -51,8 +62,12 @@
 #include "radio.h"
 #include "config.h"
 
-/* Maximum number of concurrent websocket client sessions. Set conservatively. */
+/* Maximum number of concurrent websocket client sessions. Set conservatively;
+   output no longer costs a thread per client, so builds serving more clients
+   can raise it with -DMAX_SESSIONS=n. */
+#ifndef MAX_SESSIONS
 #define MAX_SESSIONS 5
+#endif
 
 /* Default lifetime (seconds) to request for created/active channels.
   Radiod will remove channels when this timer expires if no further
@@ -61,6 +76,29 @@
 #define DEFAULT_CHANNEL_LIFETIME 1000
 #endif
 
+/* Fixed command header built once per channel: CMD, then OUTPUT_SSRC and
+   COMMAND_TAG with 4-byte values so the tag can be patched in place.
+   See ctl_prefix_init() and ctl_begin(). */
+#define CTL_PREFIX_LEN 13
+#define CTL_TAG_OFFSET 9
+/* Room for any single command built on the control path */
+#define CTL_CMD_MAX 256
+
+/* Most spectrum bins in a frame (see zoom_table) */
+#define MAX_BINS 1620
+
+/* Slowest adaptive spectrum interval unless the client's R: gives one */
+#define SPECTRUM_RATE_SLOWEST_MS 2000
+
+/* How bins are combined when a client asks for fewer (D:), see spectrum_reduce() */
+enum spectrum_reduce {
+  SPECTRUM_REDUCE_MAX,
+  SPECTRUM_REDUCE_MEAN,
+  SPECTRUM_REDUCE_MIN,
+};
+
+static char const *const spectrum_reduce_names[] = {"max", "mean", "min"};
+
 /*
   Notes on recent changes (also applied to ka9q-web1/ka9q-web.c):
 
@@ -106,18 +144,85 @@ onion_handler *onion_handler_export_local_new(const char *localpath);
 double current_backend_frequency = 0.0;
 
 int Ctl_fd = -1, Input_fd = -1, Status_fd = -1;
-pthread_mutex_t ctl_mutex;
+pthread_t ctl_sender_task;
 pthread_t ctrl_task;
 pthread_t audio_task;
 pthread_t ws_ping_task;
 pthread_t ws_watchdog_task;
 pthread_t lifetime_refresh_task;
+pthread_t spectrum_sched_task;
 /* monitor removed: previously guarded by ENABLE_MONITOR */
 pthread_mutex_t output_dest_socket_mutex;
 pthread_cond_t output_dest_socket_cond;
-/* microseconds to sleep after successful control send to avoid overrunning backend */
+/* microseconds between control sends at the default rate (-C) to avoid overrunning backend */
 #define CONTROL_USLEEP_US 10000 // minimum of 20 ms observed for backend to process a command and update status, so 30 ms is a safe default
 
+/* Outgoing websocket traffic classes. Each class has its own bounded queue
+   and drop policy so a slow browser sheds stale data instead of piling up
+   an unbounded backlog:
+     CONTROL  - text replies (BFREQ:, M_FORCE:, ACK:, ...) and the first
+                status frame; FIFO, never dropped
+     STATUS   - periodic status frames; one slot, latest wins
+     AUDIO    - PCM/Opus packets; ring, packets older than the latency
+                budget (-L) are dropped, oldest dropped when full
+     SPECTRUM - spectrum frames; one slot, latest wins */
+enum ws_class {
+  WS_CLASS_CONTROL,
+  WS_CLASS_STATUS,
+  WS_CLASS_AUDIO,
+  WS_CLASS_SPECTRUM,
+  WS_NCLASSES
+};
+#ifndef WS_AUDIO_RING
+#define WS_AUDIO_RING 64 /* ~1.3 s of 20 ms packets */
+#endif
+
+/* Per-session audio reorder window, see audio_rx_packet() */
+#define AUDIO_REORDER_SLOTS 4  /* packets held while waiting for a gap to fill */
+#define AUDIO_REORDER_MS 40    /* longest a packet waits behind a gap */
+#define AUDIO_RESYNC 1000      /* sequence jump treated as a sender restart */
+struct audio_slot {
+  struct pktbuf *pb;          /* NULL when empty */
+  int size;
+  int samples;
+  uint64_t arrival_ns;
+};
+struct audio_rx {
+  struct rtp_state rtp;       /* counts what was released; drops = lost */
+  struct audio_slot slot[AUDIO_REORDER_SLOTS];
+  int held;
+  bool init;
+  bool pending;               /* on audio_rx_pending, see audio_rx_expire() */
+  uint16_t next_seq;          /* next sequence number to release */
+  uint16_t highest_seq;
+  uint64_t seen;              /* bit i: next_seq-1-i was sent */
+  uint64_t reordered;         /* arrived behind a later packet */
+  uint64_t late;              /* arrived after its gap was given up */
+  uint64_t dupes;
+  uint64_t resyncs;
+  bool jitter_init;
+  int32_t transit;
+  double jitter;              /* RFC 3550, timestamp units */
+  double jitter_ms;
+};
+
+/* Latency histograms, see latency_record() */
+#define LAT_SUB_BITS 3                  /* 8 buckets per octave: within 12.5% */
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_MAX_EXP 31                  /* values up to 2^32 us */
+#define LAT_BUCKETS ((LAT_MAX_EXP - LAT_SUB_BITS + 2) * LAT_SUB)
+#define LAT_SHARDS 16                   /* global histogram copies, one per recording thread */
+enum lat_stage {
+  LAT_INGEST,  /* multicast receive -> queued for the websocket */
+  LAT_QUEUE,   /* queued -> taken by the writer */
+  LAT_WRITE,   /* taken -> last byte handed to the socket */
+  LAT_TOTAL,   /* multicast receive -> last byte */
+  LAT_NSTAGES
+};
+struct lat_hist {
+  atomic_uint count[LAT_BUCKETS];       /* microseconds, log-bucketed */
+};
+
 struct session {
   bool spectrum_active;
   bool audio_active;
@@ -125,12 +230,30 @@ struct session {
   int ws_fd; /* underlying websocket socket fd, or -1 if unknown */
   pthread_mutex_t ws_mutex;
   uint32_t ssrc;
+  uint8_t ctl_prefix[CTL_PREFIX_LEN]; /* command header for ssrc, see ctl_begin() */
   bool write_in_progress;
   unsigned long last_write_start_ms;
   pthread_t poll_task;
-  pthread_t spectrum_task;
   pthread_mutex_t spectrum_mutex;
   useconds_t spectrum_poll_us; /* per-session poll interval (microseconds) */
+  /* Adaptive spectrum rate, see spectrum_rate_adjust(); guarded by spectrum_mutex */
+  unsigned spectrum_slowest_ms; /* slowest interval the client accepts (R:) */
+  float spectrum_rate_fps;      /* current frame rate */
+  unsigned long spectrum_rate_hold_ms; /* no further back-off before this */
+  uint64_t spectrum_rate_drops; /* out_drops[WS_CLASS_SPECTRUM] at the last check */
+  unsigned spectrum_rate_reported_ms; /* interval last sent in RATE: */
+  unsigned long spectrum_rate_report_time_ms;
+  float spectrum_write_ms;      /* queue-to-written latency of spectrum frames; guarded by out_mutex */
+  struct session *sched_next;   /* spectrum scheduler wheel link; guarded by spectrum_sched_mutex */
+  unsigned long sched_due_ms;   /* when the next spectrum request is due */
+  bool spectrum_scheduled;      /* on the scheduler wheel; guarded by spectrum_sched_mutex */
+  unsigned long spectrum_frame_ms; /* when the last spectrum frame was forwarded */
+  float spectrum_achieved_ms;   /* moving average of the achieved frame interval */
+  struct spectrum_view *view;   /* shared backend spectrum channel; guarded by spectrum_view_mutex */
+  int spectrum_window;          /* requested WINDOW_TYPE, -1 = backend default */
+  float spectrum_shape;         /* requested SPECTRUM_SHAPE, NAN = backend default */
+  int spectrum_avg;             /* requested SPECTRUM_AVG, -1 = backend default */
+  float spectrum_overlap;       /* requested SPECTRUM_OVERLAP, NAN = backend default */
   uint32_t center_frequency;
   uint32_t frequency;           // tuned frequency, in Hz
   uint32_t bin_width;
@@ -147,6 +270,29 @@ struct session {
   char requested_preset[32];
   float bins_min_db;
   float bins_max_db;
+  int spectrum_bits;            /* spectrum code width negotiated with Q:, 0 = v1 frames */
+  /* Compressed spectrum frames (X:), see spectrum_delta_encode(); the
+     reference frame and counters belong to the status thread; the two
+     flags are set by the websocket thread */
+  atomic_bool spectrum_delta;
+  atomic_bool spectrum_key_req; /* next frame is a keyframe */
+  uint8_t spectrum_ref[2 * MAX_BINS]; /* codes of the last frame sent */
+  int spectrum_ref_len;
+  int spectrum_ref_bits;
+  uint32_t spectrum_ref_center;
+  uint32_t spectrum_ref_bin_width;
+  uint64_t spectrum_ref_drops;  /* out_drops[WS_CLASS_SPECTRUM] when it was sent */
+  uint16_t spectrum_seq;
+  int spectrum_since_key;
+  uint64_t spectrum_keyframes;
+  uint64_t spectrum_coded_frames;
+  uint64_t spectrum_raw_bytes;
+  uint64_t spectrum_coded_bytes;
+  uint64_t spectrum_encode_ns;
+  int spectrum_px;              /* bin reduction width (D:), 0 = all bins */
+  enum spectrum_reduce spectrum_reduce;
+  uint64_t spectrum_reduced_bytes; /* code bytes not sent thanks to reduction */
+  uint64_t spectrum_reduced_frames;
   int freq_mismatch_count; /* counts consecutive status cycles with freq mismatch */
   int preset_mismatch_count; /* counts consecutive status cycles with preset mismatch */
   float spectrum_base;
@@ -175,13 +321,46 @@ struct session {
     unsigned long cw_flip_time_ms;
     char cw_flip_prev_preset[8];
     bool opus_active; /* true when client has requested Opus encoding */
-    /* Outgoing websocket queue and writer thread */
-    struct ws_msg *out_head;
+    bool server_opus; /* ... and ka9q-web encodes it (-O), see opus_submit() */
+    struct opus_stream *opus_stream; /* server-side encoder; used by its worker only */
+    struct audio_rx audio_rx; /* RTP reorder window and loss stats; audio_thread only */
+    uint64_t audio_packets;   /* datagrams for this SSRC; audio_thread only */
+    uint64_t status_packets;  /* ... ctrl_thread only */
+    struct lat_hist latency[WS_NCLASSES][LAT_NSTAGES]; /* written by the thread writing this session */
+    /* Outgoing websocket queues, one per ws_class; all guarded by out_mutex */
+    struct ws_msg *out_head;      /* control: FIFO */
     struct ws_msg *out_tail;
+    struct ws_msg *audio_ring[WS_AUDIO_RING];
+    int audio_head;               /* index of the oldest queued audio packet */
+    int audio_count;
+    struct ws_msg *status_slot;   /* latest-wins mailboxes */
+    struct ws_msg *spectrum_slot;
+    uint64_t out_drops[WS_NCLASSES];
     pthread_mutex_t out_mutex;
+    int out_frames;               /* backlog: frames queued (incl. partially written one) */
+    long out_bytes;               /* backlog: payload bytes queued (incl. partially written one) */
+    uint64_t sent_frames;
+    uint64_t sent_bytes;
+    /* Output engine state (see ws_engine below). Sessions whose socket fd is
+       not available fall back to a dedicated writer thread. */
+    struct ws_engine *engine;
+    struct session *ready_next;   /* engine ready list link; guarded by engine->mutex */
+    bool ready_queued;            /* on the engine ready list; guarded by engine->mutex */
+    bool engine_detach;           /* delete_session() asked the engine to let go */
+    int engine_fd;                /* fd registered with epoll, -1 if none (engine thread only) */
+    struct ws_msg *out_cur;       /* frame being written (engine thread only) */
+    uint8_t out_cur_hdr[10];      /* its websocket frame header */
+    int out_cur_hdr_len;
+    size_t out_cur_off;           /* bytes of header+payload already written */
     pthread_cond_t out_cond;
     pthread_t writer_task;
     bool writer_running;
+    /* Lifetime: one reference is owned by the session list/SSRC table and
+       one by every thread that looked the session up. The session is freed
+       by session_put() when the last reference goes away. */
+    atomic_int refs;
+    bool deleted;                 /* unlinked by delete_session(); guarded by session_mutex */
+    pthread_mutex_t state_mutex;  /* serializes client commands against status processing */
   /* uint32_t last_poll_tag; */
 };
 
@@ -198,18 +377,36 @@ extern void control_set_spectrum_overlap(struct session *sp, char *val_str);
 extern void control_set_window_type(struct session *sp, char *type_str, char *shape_str);
 extern void control_set_encoding(struct session *sp, bool use_opus);
 int init_demod(struct channel *channel);
-void control_get_powers(struct session *sp,float frequency,int bins,float bin_bw);
-/* New: request powers with explicit demod type (fallback to SPECT2_DEMOD if needed) */
-void control_get_powers_with_demod(struct session *sp,float frequency,int bins,float bin_bw,int demod_type);
+void control_stop_spectrum(uint8_t const *prefix,int bins,float bin_bw);
 void stop_spectrum_stream(struct session *sp);
-int extract_powers(float *power,int npower,uint64_t *time,double *freq,double *bin_bw,int32_t const ssrc,uint8_t const * const buffer,int length,struct session *sp);
+int extract_powers(float *power,int npower,uint64_t *time,double *freq,double *bin_bw,int32_t const ssrc,struct tlv_index const *idx,struct session *sp);
 void control_poll(struct session *sp);
 static void *lifetime_refresh_thread(void *arg);
-void *spectrum_thread(void *arg);
+static int control_sender_start(void);
+static void ctl_prefix_init(uint8_t *prefix, uint32_t ssrc);
+static void spectrum_kernel_check(void);
+static void control_stats(long *depth, unsigned long *sent, unsigned long *errors, unsigned long *merged,
+                          unsigned long *batched, double *avg_latency_ms, unsigned long *max_latency_ms);
+extern int control_rate;
+extern int control_coalesce_ms;
+extern int opus_bitrate;      /* -O: 0 = radiod encodes Opus itself */
+extern int opus_complexity;
+extern int opus_frame_ms;
+#define CAPTURE_STATUS 0 /* capture record socket: Status_fd */
+#define CAPTURE_AUDIO 1  /* ... Input_fd */
+int capture_open(char const *path);
+static void capture_write(int sock, uint8_t const *data, size_t len, uint64_t recv_ns);
+static FILE *capture_fp; /* -w */
+static void *replay_thread(void *arg);
+extern char const *replay_path;
+extern double replay_speed;
+extern bool replay_map;
+static void spectrum_sched_start(struct session *sp);
+static void *spectrum_scheduler_thread(void *arg);
 void *ctrl_thread(void *arg);
 
 /* websocket send helpers (forward declarations) */
-static void send_ws_binary_to_session(struct session *sp, uint8_t *buf, int size);
+static void send_ws_binary_to_session(struct session *sp, uint8_t *buf, int size, enum ws_class cls);
 static void send_ws_text_to_session(struct session *sp, const char *msg);
 static void *ws_ping_thread(void *arg);
 /* Reject-callback for new websockets when the server is at capacity. */
@@ -227,13 +424,47 @@ struct ws_msg {
   uint8_t *data;
   int size;
   int is_text; /* 1 => text, 0 => binary */
+  enum ws_class cls;
+  unsigned long enq_ms; /* monotonic ms when queued (audio deadline) */
+  uint64_t recv_ns;     /* monotonic ns: source datagram received */
+  uint64_t enq_ns;      /* ... queued */
+  uint64_t pop_ns;      /* ... taken by the writer */
+  int pool;             /* ws_msg_alloc() size class, -1 when heap allocated */
+  struct pktbuf *pb;    /* when set, data points into this shared buffer */
   struct ws_msg *next;
 };
 
+/* Refcounted, immutable packet buffer. Received datagrams and locally built
+   spectrum frames live in one of these so every session that forwards it
+   holds a reference instead of a private copy. */
+struct pktbuf {
+  atomic_int refs;
+  uint64_t recv_ns;     /* monotonic ns when received; 0 for locally built frames */
+  struct pktbuf *next;  /* free list link */
+  uint8_t data[];
+};
+#define PKTBUF_SIZE 4096
+#define PKTBUF_CAP ((int)(PKTBUF_SIZE - offsetof(struct pktbuf, data)))
+static struct pktbuf *pktbuf_alloc(void);
+static void pktbuf_put(struct pktbuf *pb);
+static void pktbuf_stats(unsigned long *in_use, unsigned long *resident);
+static void send_ws_pktbuf_to_session(struct session *sp, struct pktbuf *pb, int size, enum ws_class cls);
+
+/* Outgoing frame allocator (defined below) */
+static struct ws_msg *ws_msg_alloc(int size);
+static void ws_msg_free(struct ws_msg *m);
+static void ws_msg_pool_stats(unsigned long *allocs, unsigned long *hits, unsigned long *resident);
+
 /* Per-session writer helpers (defined below) */
-static void enqueue_ws_message(struct session *sp, const uint8_t *buf, int size, int is_text);
+static void enqueue_ws_message(struct session *sp, const uint8_t *buf, int size, int is_text, enum ws_class cls);
+static void ws_msg_queue(struct session *sp, struct ws_msg *m);
 static void free_out_queue(struct session *sp);
 static void *session_writer_thread(void *arg);
+static void ws_engine_kick(struct session *sp);
+static void ws_engine_attach(struct session *sp);
+static void ws_engine_detach(struct session *sp);
+static int ws_engine_start(void);
+static int ws_nengines;
 /* Forward declarations used by watchdog (defined later) */
 static unsigned long now_ms(void);
 extern pthread_mutex_t session_mutex;
@@ -288,6 +519,25 @@ static int nsessions;
 static struct session *sessions;
 /* Forward declaration so ws_watchdog_thread can call delete_session without implicit declaration warning */
 void delete_session(struct session *sp);
+static void session_get(struct session *sp);
+static void session_put(struct session *sp);
+struct opus_stream;
+static void opus_stream_free(struct opus_stream *st);
+static void audio_rx_free(struct audio_rx *rx);
+static void opus_workers_start(void);
+static void opus_stream_stats(struct session const *sp, char *buf, size_t len);
+static bool latency_percentiles(struct lat_hist const *h, int nh, int stride, double pct_ms[3]);
+static bool latency_global(enum ws_class cls, enum lat_stage stage, double pct_ms[3]);
+static char const *const lat_stage_names[LAT_NSTAGES];
+static char const *const lat_class_names[WS_NCLASSES];
+
+/* Counters exported at /metrics that no other structure keeps; bumped with
+   relaxed atomics on the paths that own them */
+static struct {
+  atomic_ullong spectrum_decoded;     /* spectrum packets with bin data */
+  atomic_ullong spectrum_placeholder; /* ... and without, painted mid-gray */
+  atomic_ullong watchdog_kills;
+} Metrics;
 
 struct frontend Frontend;
 struct sockaddr Metadata_source_socket;       // Source of metadata
@@ -313,6 +563,7 @@ static void *ws_watchdog_thread(void *arg) {
       int i = 0;
       struct session *sp = sessions;
       while (sp != NULL && i < n) {
+        session_get(sp);
         list[i++] = sp;
         sp = sp->next;
       }
@@ -322,7 +573,6 @@ static void *ws_watchdog_thread(void *arg) {
 
     for (int i = 0; i < n; ++i) {
       struct session *sp = list[i];
-      pthread_t spectrum_join = 0;
       /* Read write flags without taking ws_mutex to avoid blocking if a writer
          thread is stuck holding that mutex. This is racy but acceptable for
          watchdog recovery: detection only needs to be approximate. */
@@ -354,9 +604,8 @@ static void *ws_watchdog_thread(void *arg) {
             if (sp->spectrum_active) {
               pthread_mutex_lock(&sp->spectrum_mutex);
               sp->spectrum_active = false;
-              stop_spectrum_stream(sp);
-              spectrum_join = sp->spectrum_task;
               pthread_mutex_unlock(&sp->spectrum_mutex);
+              stop_spectrum_stream(sp);
             }
             sp->spectrum_requested_by_client = false;
             sp->spectrum_restart_attempts = 0;
@@ -367,10 +616,12 @@ static void *ws_watchdog_thread(void *arg) {
                expects `session_mutex` to be held and will release it before
                joining the writer thread. */
             delete_session(sp);
-            if (spectrum_join) pthread_join(spectrum_join, NULL);
+            atomic_fetch_add_explicit(&Metrics.watchdog_kills, 1, memory_order_relaxed);
         }
       }
     }
+    for (int i = 0; i < n; ++i)
+      session_put(list[i]);
     free(list);
   }
   return NULL;
@@ -385,6 +636,7 @@ int IP_tos = DEFAULT_IP_TOS;
 const char *App_path;
 int64_t Timeout = BILLION;
 int ConnTimeoutSeconds = 60; /* seconds; 0 == wait forever */
+int audio_latency_budget_ms = 500; /* drop queued audio older than this; 0 == never */
 uint16_t rtp_seq=0;
 int verbose = 0;
 /* Gate extra SSRC/session debug prints to avoid console flooding */
@@ -400,6 +652,8 @@ static unsigned long poll_start_ms = 0;
 static unsigned long last_status_recv_ms = 0;
 /* Monotonic ms timestamp of last successful audio packet recv */
 static unsigned long last_audio_recv_ms = 0;
+/* Batched receive counters for Input_fd / Status_fd (single writer each) */
+static struct mcast_ingest_stats Audio_ingest, Status_ingest;
 
 /* Forward declaration: monotonic time in milliseconds helper */
 static unsigned long now_ms(void);
@@ -419,6 +673,16 @@ static unsigned long now_ms(void) {
   return (unsigned long)(ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL);
 }
 
+/* Monotonic time in nanoseconds, for latency measurements */
+static uint64_t mono_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Receive time of the datagram batch the calling ingest thread is dispatching */
+static __thread uint64_t ingest_recv_ns;
+
 /* If no build-time `GIT_COMMIT` is embedded, provide a runtime fallback that
    reads the short commit from the local git metadata. This helper is omitted
    when `GIT_COMMIT` is defined to avoid unused-function warnings. */
@@ -472,8 +736,6 @@ static void log_git_commit_index_runtime(void) {
 /* sleep time for spectrum polling and related retries (microseconds) */
 useconds_t spectrum_poll_us = 100000; // default 100 ms
 
-#define MAX_BINS 1620
-
 onion_connection_status websocket_cb(void *data, onion_websocket * ws,
                                                ssize_t data_ready_len);
 
@@ -484,6 +746,9 @@ static void zoom(struct session *sp, int shift);
 static void adjust_center_within_bounds(struct session *sp);
 static uint32_t allocate_session_ssrc(void);
 static bool session_pair_in_use(uint32_t ssrc);
+static void spectrum_view_poll(struct session *sp, bool force);
+static void spectrum_view_leave(struct session *sp);
+static unsigned long spectrum_rate_interval_ms(struct session const *sp);
 /* Define zoom_table type and table so handler can compute size */
 struct zoom_table_t {
   int bin_width;
@@ -517,7 +782,7 @@ const struct zoom_table_t zoom_table[] = {
 };
 
 /* Dispatch a single websocket text message `tmp` for session `sp`.
-   Called with `session_mutex` already held. Returns an Onion status. */
+   Called with `sp->state_mutex` held. Returns an Onion status. */
 static onion_connection_status handle_ws_message(struct session *sp, char *tmp) {
   char *saveptr = NULL;
   char *token = strtok_r(tmp, ":", &saveptr);
@@ -552,7 +817,7 @@ static onion_connection_status handle_ws_message(struct session *sp, char *tmp)
           send_ws_text_to_session(sp, temp);
           if (debugSSRC) fprintf(stderr, "ws: S: request from ssrc %u\n", sp->ssrc);
 
-          /* Avoid duplicate starts only when a spectrum thread is actually active.
+          /* Avoid duplicate starts only when spectrum is actually active.
              `spectrum_requested_by_client` can be stale after reconnects; in that case
              allow S: to restart so users do not need a stop/start double-toggle. */
           if (sp->spectrum_active) {
@@ -564,13 +829,7 @@ static onion_connection_status handle_ws_message(struct session *sp, char *tmp)
           sp->spectrum_restart_attempts = 0;
           sp->last_spectrum_restart_ms = 0;
           sp->spectrum_active = true;
-          if(pthread_create(&sp->spectrum_task,NULL,spectrum_thread,sp) == -1){
-            perror("pthread_create: spectrum_thread");
-          } else {
-            char buff[16];
-            snprintf(buff,16,"spec_%u",sp->ssrc+1);
-            pthread_setname_np(sp->spectrum_task, buff);
-          }
+          spectrum_sched_start(sp);
         }
         break;
       case 'A':
@@ -587,9 +846,12 @@ static onion_connection_status handle_ws_message(struct session *sp, char *tmp)
         token = strtok_r(NULL, ":", &saveptr);
         if(token && strcasecmp(token,"OPUS")==0) {
           sp->opus_active=true;
-          control_set_encoding(sp,true);
+          /* With -O the channel stays PCM and is encoded here */
+          sp->server_opus = opus_bitrate > 0;
+          control_set_encoding(sp,!sp->server_opus);
         } else if(token && strcasecmp(token,"PCM")==0) {
           sp->opus_active=false;
+          sp->server_opus=false;
           control_set_encoding(sp,false);
         }
         break;
@@ -687,25 +949,90 @@ static onion_connection_status handle_ws_message(struct session *sp, char *tmp)
           }
         }
         sp->last_client_command_ms = now_ms();
+        /* radiod answers the command with status, no separate poll needed */
         control_set_mode(sp,&tmp[2]);
-        control_poll(sp);
         break;
       case 'T':
       case 't':
         control_set_shift(sp, &tmp[2]);
         break;
+      case 'Q':
+      case 'q':
+        {
+          /* Spectrum frame format: Q:4, Q:8 or Q:16 for v2 frames with codes
+             of that width, Q:0 for v1; the reply gives the format in use */
+          char *endptr;
+          long v = strtol(&tmp[2], &endptr, 10);
+          if (&tmp[2] != endptr && (v == 0 || v == 4 || v == 8 || v == 16))
+            sp->spectrum_bits = (int)v;
+          char response[16];
+          snprintf(response, sizeof(response), "Q:%d", sp->spectrum_bits);
+          send_ws_text_to_session(sp, response);
+        }
+        break;
+      case 'D':
+      case 'd':
+        {
+          /* Bin reduction to the client's display width: D:<px>[:max|mean|min],
+             D:0 for every bin; the reply gives the setting in use */
+          char *width = strtok_r(NULL, ":", &saveptr);
+          char *mode = strtok_r(NULL, ":", &saveptr);
+          if (width != NULL) {
+            char *endptr;
+            long v = strtol(width, &endptr, 10);
+            if (width != endptr && v >= 0)
+              sp->spectrum_px = v > MAX_BINS ? MAX_BINS : (int)v;
+          }
+          if (mode != NULL) {
+            for (int m = 0; m < (int)(sizeof(spectrum_reduce_names) / sizeof(spectrum_reduce_names[0])); m++)
+              if (strcasecmp(mode, spectrum_reduce_names[m]) == 0)
+                sp->spectrum_reduce = (enum spectrum_reduce)m;
+          }
+          char response[32];
+          snprintf(response, sizeof(response), "D:%d:%s", sp->spectrum_px, spectrum_reduce_names[sp->spectrum_reduce]);
+          send_ws_text_to_session(sp, response);
+        }
+        break;
+      case 'X':
+      case 'x':
+        {
+          /* Compressed spectrum frames: X:1 on, X:0 off, X:K keyframe please */
+          char *param = strtok_r(NULL, ":", &saveptr);
+          if (param && strcasecmp(param, "K") == 0) {
+            atomic_store(&sp->spectrum_key_req, true);
+          } else if (param) {
+            atomic_store(&sp->spectrum_delta, atoi(param) != 0);
+            atomic_store(&sp->spectrum_key_req, true);
+          }
+        }
+        break;
       /* 'P' (adopt-on-mismatch) messages removed: adoption is now server-driven */
       case 'R':
       case 'r':
         {
+          /* R:<fastest_ms>[:<slowest_ms>] bounds the adaptive spectrum
+             interval; the rate restarts at the fastest and backs off from there */
           char *endptr;
           long v = strtol(&tmp[2], &endptr, 10);
           if (&tmp[2] != endptr && v > 0) {
+            long slowest = SPECTRUM_RATE_SLOWEST_MS;
+            if (*endptr == ':') {
+              char *end2;
+              long s = strtol(endptr + 1, &end2, 10);
+              if (end2 != endptr + 1 && s > 0)
+                slowest = s;
+            }
+            if (slowest < v)
+              slowest = v;
             pthread_mutex_lock(&sp->spectrum_mutex);
             sp->spectrum_poll_us = (useconds_t)(v * 1000L);
+            sp->spectrum_slowest_ms = (unsigned)slowest;
+            sp->spectrum_rate_fps = 1000.0f / (float)v;
+            sp->spectrum_rate_reported_ms = 0;
+            sp->spectrum_rate_report_time_ms = 0;
             pthread_mutex_unlock(&sp->spectrum_mutex);
             if (verbose)
-              fprintf(stderr, "%s: set sp->spectrum_poll_us to %u us (from %ld ms)\n", __FUNCTION__, (unsigned)sp->spectrum_poll_us, v);
+              fprintf(stderr, "%s: set sp->spectrum_poll_us to %u us (from %ld ms), slowest %ld ms\n", __FUNCTION__, (unsigned)sp->spectrum_poll_us, v, slowest);
           }
         }
         break;
@@ -733,9 +1060,9 @@ static onion_connection_status handle_ws_message(struct session *sp, char *tmp)
             }
           }
        adjust_center_within_bounds(sp);
-          pthread_mutex_lock(&sp->spectrum_mutex);
-          control_get_powers(sp,(float)sp->center_frequency,sp->bins,(float)sp->bin_width);
-          pthread_mutex_unlock(&sp->spectrum_mutex);
+          /* Re-centre now rather than at the next scheduled poll */
+          if (sp->spectrum_requested_by_client)
+            spectrum_view_poll(sp, true);
           control_poll(sp);
         } else if (token && strcmp(token, "SIZE") == 0) {
             int table_size = sizeof(zoom_table) / sizeof(zoom_table[0]);
@@ -790,6 +1117,7 @@ onion_connection_status status(void *data, onion_request * req,
                                           onion_response * res);
 onion_connection_status version(void *data, onion_request * req,
                                           onion_response * res);
+onion_connection_status metrics(void *data, onion_request *req, onion_response *res);
 
 pthread_mutex_t session_mutex;
 static int nsessions=0;
@@ -798,15 +1126,719 @@ static struct session *sessions=NULL;
 char const *description_override=0;
 bool run_with_realtime = false;
 
+/*
+  SSRC-indexed session table
+  --------------------------
+  The ingest threads (`audio_thread`, `ctrl_thread`) look up a session for
+  every datagram they receive. Walking `sessions` under `session_mutex` made
+  them wait behind anything else holding that lock (status page renders,
+  reattach scans in `home()`, `delete_session()` joins). Lookups by SSRC now
+  go through an open-addressed hash table that readers probe without taking
+  any lock:
+
+  - Writers (`add_session`/`delete_session`) still serialize on
+    `session_mutex` and keep the linked list for the management paths.
+  - Removed entries become tombstones; the table is rebuilt into a fresh
+    array when tombstones pile up and the old one is retired after a grace
+    period.
+  - Readers bracket the probe with rcu_read_lock()/rcu_read_unlock() and take
+    a reference on the session they find. A session is only freed after it
+    has been unlinked, a grace period has elapsed and the last reference has
+    been dropped, so a pointer obtained from the table stays valid until the
+    caller's session_put().
+*/
+#define SESSION_TABLE_MIN_SIZE 64
+#define SESSION_TOMBSTONE ((struct session *)1)
+
+struct session_table {
+  unsigned int size;   /* number of slots, power of two */
+  unsigned int bits;   /* log2(size) */
+  unsigned int used;   /* live entries + tombstones (writer side only) */
+  unsigned int live;   /* live entries (writer side only) */
+  _Atomic(struct session *) slot[];
+};
+
+static _Atomic(struct session_table *) session_table = NULL;
+
+/* Minimal epoch-based RCU. Each reader thread registers a record once and
+   publishes the grace period it entered in; 0 means "not reading". */
+struct rcu_reader {
+  atomic_ulong period;
+  struct rcu_reader *next;
+};
+static atomic_ulong rcu_grace_period = 1;
+static struct rcu_reader *rcu_readers = NULL;
+static pthread_mutex_t rcu_readers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct rcu_reader *rcu_self = NULL;
+
+static void rcu_read_lock(void) {
+  if (rcu_self == NULL) {
+    struct rcu_reader *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+      perror("calloc: rcu_reader");
+      abort();
+    }
+    pthread_mutex_lock(&rcu_readers_mutex);
+    r->next = rcu_readers;
+    rcu_readers = r;
+    pthread_mutex_unlock(&rcu_readers_mutex);
+    rcu_self = r;
+  }
+  atomic_store(&rcu_self->period, atomic_load(&rcu_grace_period));
+}
+
+static void rcu_read_unlock(void) {
+  atomic_store_explicit(&rcu_self->period, 0, memory_order_release);
+}
+
+/* Wait until every reader that might still see memory unpublished before
+   this call has left its read-side section. Read sections are a hash probe
+   long, so spinning with sched_yield() is fine. */
+static void synchronize_rcu(void) {
+  unsigned long const gp = atomic_fetch_add(&rcu_grace_period, 1) + 1;
+  pthread_mutex_lock(&rcu_readers_mutex);
+  for (struct rcu_reader *r = rcu_readers; r != NULL; r = r->next) {
+    for (;;) {
+      unsigned long p = atomic_load(&r->period);
+      if (p == 0 || p >= gp)
+        break;
+      sched_yield();
+    }
+  }
+  pthread_mutex_unlock(&rcu_readers_mutex);
+}
+
+static inline unsigned int session_hash(uint32_t ssrc, unsigned int bits) {
+  /* SSRCs are even; drop the constant low bit before the multiplicative hash */
+  return ((ssrc >> 1) * 2654435761u) >> (32 - bits);
+}
+
+static struct session_table *session_table_alloc(unsigned int live) {
+  unsigned int bits = 6;
+  while ((1u << bits) < SESSION_TABLE_MIN_SIZE || (1u << bits) < live * 4)
+    bits++;
+  struct session_table *t = calloc(1, sizeof(*t) + (sizeof(t->slot[0]) << bits));
+  if (t == NULL)
+    return NULL;
+  t->bits = bits;
+  t->size = 1u << bits;
+  return t;
+}
+
+/* Writer side; called with session_mutex held */
+static void session_table_place(struct session_table *t, struct session *sp) {
+  unsigned int const mask = t->size - 1;
+  unsigned int i = session_hash(sp->ssrc, t->bits);
+  for (;;) {
+    struct session *cur = atomic_load_explicit(&t->slot[i], memory_order_relaxed);
+    if (cur == NULL || cur == SESSION_TOMBSTONE) {
+      if (cur == NULL)
+        t->used++;
+      t->live++;
+      atomic_store_explicit(&t->slot[i], sp, memory_order_release);
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+/* Writer side; called with session_mutex held */
+static void session_table_insert(struct session *sp) {
+  struct session_table *t = atomic_load_explicit(&session_table, memory_order_relaxed);
+  if (t == NULL || (t->used + 1) * 4 > t->size * 3) {
+    /* Rebuild into a fresh array (drops tombstones, grows if needed) and
+       retire the old one once no reader can still be probing it. */
+    struct session_table *nt = session_table_alloc((t ? t->live : 0) + 1);
+    if (nt == NULL) {
+      perror("calloc: session_table");
+      abort();
+    }
+    if (t != NULL) {
+      for (unsigned int i = 0; i < t->size; i++) {
+        struct session *cur = atomic_load_explicit(&t->slot[i], memory_order_relaxed);
+        if (cur != NULL && cur != SESSION_TOMBSTONE)
+          session_table_place(nt, cur);
+      }
+    }
+    atomic_store_explicit(&session_table, nt, memory_order_release);
+    if (t != NULL) {
+      synchronize_rcu();
+      free(t);
+    }
+    t = nt;
+  }
+  session_table_place(t, sp);
+}
+
+/* Writer side; called with session_mutex held */
+static void session_table_remove(struct session *sp) {
+  struct session_table *t = atomic_load_explicit(&session_table, memory_order_relaxed);
+  if (t == NULL)
+    return;
+  unsigned int const mask = t->size - 1;
+  unsigned int i = session_hash(sp->ssrc, t->bits);
+  for (unsigned int n = 0; n < t->size; n++) {
+    struct session *cur = atomic_load_explicit(&t->slot[i], memory_order_relaxed);
+    if (cur == NULL)
+      return;
+    if (cur == sp) {
+      atomic_store_explicit(&t->slot[i], SESSION_TOMBSTONE, memory_order_release);
+      t->live--;
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+/* Lock-free lookup; returns a referenced session or NULL */
+static struct session *session_table_lookup(uint32_t ssrc) {
+  struct session *found = NULL;
+  rcu_read_lock();
+  struct session_table *t = atomic_load_explicit(&session_table, memory_order_acquire);
+  if (t != NULL) {
+    unsigned int const mask = t->size - 1;
+    unsigned int i = session_hash(ssrc, t->bits);
+    for (unsigned int n = 0; n < t->size; n++) {
+      struct session *cur = atomic_load_explicit(&t->slot[i], memory_order_acquire);
+      if (cur == NULL)
+        break;
+      if (cur != SESSION_TOMBSTONE && cur->ssrc == ssrc) {
+        session_get(cur);
+        found = cur;
+        break;
+      }
+      i = (i + 1) & mask;
+    }
+  }
+  rcu_read_unlock();
+  return found;
+}
+
+static void session_get(struct session *sp) {
+  atomic_fetch_add_explicit(&sp->refs, 1, memory_order_relaxed);
+}
+
+static void session_put(struct session *sp) {
+  if (atomic_fetch_sub_explicit(&sp->refs, 1, memory_order_acq_rel) != 1)
+    return;
+  /* Last reference: the writer thread was joined in delete_session() and
+     the output engine has let go of the session */
+  free_out_queue(sp);
+  opus_stream_free(sp->opus_stream);
+  audio_rx_free(&sp->audio_rx);
+  pthread_mutex_destroy(&sp->out_mutex);
+  pthread_cond_destroy(&sp->out_cond);
+  pthread_mutex_destroy(&sp->state_mutex);
+  pthread_mutex_destroy(&sp->spectrum_mutex);
+  pthread_mutex_destroy(&sp->ws_mutex);
+  free(sp);
+}
+
+/*
+  Spectrum views
+  --------------
+  A spectrum channel in radiod is a SPECT2 demodulator with its own SSRC
+  that answers each poll with one FFT frame. Sessions looking at the same
+  thing (same center, bin count, bin width, window and averaging) used to
+  each run their own channel at `ssrc+1`, so radiod computed identical FFTs
+  once per viewer. Now sessions subscribe to a spectrum view instead:
+
+  - A view is keyed by everything that determines the FFT output
+    (struct spectrum_view_key) and owns one backend channel (an odd SSRC,
+    the first subscriber's `ssrc+1` when free, otherwise a random one).
+  - spectrum_view_poll() is called by the spectrum poll scheduler. It
+    moves the session to the view matching its current settings (joining an
+    existing one or creating it) and requests a new frame unless another
+    subscriber has just done so, so a shared view is polled at about the
+    rate of its fastest subscriber, not the sum of all of them.
+  - Frames arriving on a view's SSRC are decoded once and fanned out to
+    every subscriber by process_spectrum_packet(), each with its own
+    header (tuned frequency, zoom index, ...) and frame format.
+  - A sole subscriber that zooms or pans keeps its view: the key is updated
+    and the channel retuned in place, so radiod never sees a 0 Hz stop
+    followed at once by a new request on the same SSRC.
+  - When the last subscriber leaves, the channel is stopped (tuned to 0 Hz)
+    and the view is freed. Its SSRC is quarantined for
+    SPECTRUM_SSRC_QUARANTINE_MS so a new view does not reuse it while the
+    stop may still be in flight.
+
+  Subscriber lists hold a session reference. Lock order: session_mutex,
+  then spectrum_view_mutex. sp->spectrum_mutex is a leaf: it is dropped
+  before anything takes spectrum_view_mutex (stop_spectrum_stream() is
+  called after clearing spectrum_active, not under it). Control commands
+  are sent after dropping the lock.
+*/
+struct spectrum_view_key {
+  uint32_t center;
+  int bins;
+  uint32_t bin_width;
+  int window;             /* -1 = backend default */
+  float shape;            /* NAN = backend default */
+  int averaging;          /* -1 = backend default */
+  float overlap;          /* NAN = backend default */
+};
+
+struct spectrum_view {
+  struct spectrum_view *next;
+  struct spectrum_view_key key;
+  uint32_t ssrc;                  /* backend spectrum channel (odd) */
+  uint8_t ctl_prefix[CTL_PREFIX_LEN]; /* command header for ssrc */
+  struct session *subs[MAX_SESSIONS];
+  int nsubs;
+  unsigned long last_poll_ms;     /* last spectrum request sent for this view */
+  uint64_t frames;                /* frames fanned out */
+};
+
+static pthread_mutex_t spectrum_view_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct spectrum_view *spectrum_views;
+static int nspectrum_views;
+
+/* Recently stopped view channels; a ring, the oldest entry is overwritten */
+#define SPECTRUM_SSRC_QUARANTINE_MS 2000
+#define SPECTRUM_SSRC_QUARANTINE_SLOTS 32
+static struct {
+  uint32_t ssrc;
+  unsigned long until_ms;
+} spectrum_ssrc_quarantine[SPECTRUM_SSRC_QUARANTINE_SLOTS];
+static int spectrum_ssrc_quarantine_next;
+
+/* Defaults for new sessions; see control_set_spectrum_average() and friends */
+static int spectrum_default_window = -1;
+static float spectrum_default_shape = NAN;
+static int spectrum_default_avg = -1;
+static float spectrum_default_overlap = NAN;
+
+static void control_get_powers_with_demod(uint8_t const *prefix, struct spectrum_view_key const *key, int demod_type,
+                                          bool with_params);
+static void ssrc_filter_update(void);
+
+static bool spectrum_param_equal(float a, float b) {
+  return (isnan(a) && isnan(b)) || a == b;
+}
+
+static bool spectrum_view_key_equal(struct spectrum_view_key const *a, struct spectrum_view_key const *b) {
+  return a->center == b->center && a->bins == b->bins && a->bin_width == b->bin_width
+    && a->window == b->window && spectrum_param_equal(a->shape, b->shape)
+    && a->averaging == b->averaging && spectrum_param_equal(a->overlap, b->overlap);
+}
+
+/* Called with spectrum_view_mutex held */
+static struct spectrum_view *spectrum_view_find_ssrc(uint32_t ssrc) {
+  for (struct spectrum_view *v = spectrum_views; v != NULL; v = v->next)
+    if (v->ssrc == ssrc)
+      return v;
+  return NULL;
+}
+
+/* Called with spectrum_view_mutex held */
+static bool spectrum_ssrc_quarantined(uint32_t ssrc, unsigned long now) {
+  for (int i = 0; i < SPECTRUM_SSRC_QUARANTINE_SLOTS; i++)
+    if (spectrum_ssrc_quarantine[i].ssrc == ssrc && now < spectrum_ssrc_quarantine[i].until_ms)
+      return true;
+  return false;
+}
+
+static bool spectrum_view_ssrc_in_use(uint32_t ssrc) {
+  pthread_mutex_lock(&spectrum_view_mutex);
+  bool const used = spectrum_view_find_ssrc(ssrc) != NULL;
+  pthread_mutex_unlock(&spectrum_view_mutex);
+  return used;
+}
+
+/* Pick the backend SSRC for a new view. Called with spectrum_view_mutex held,
+   so sessions are checked through the lock-free table, not the session list. */
+static uint32_t spectrum_view_alloc_ssrc(struct session const *sp) {
+  unsigned long const now = now_ms();
+  uint32_t candidate = sp->ssrc + 1;
+  for (;;) {
+    if (spectrum_view_find_ssrc(candidate) == NULL && !spectrum_ssrc_quarantined(candidate, now)) {
+      struct session *owner = session_table_lookup(candidate - 1);
+      if (owner == NULL || owner == sp) {
+        if (owner != NULL)
+          session_put(owner);
+        return candidate;
+      }
+      session_put(owner);
+    }
+    candidate = (arc4random() & 0x7ffffffeU) | 1; /* odd, positive 31-bit */
+  }
+}
+
+/* Remove `sp` from its view. Called with spectrum_view_mutex held. Returns
+   the freed view when `sp` was its last subscriber (the caller stops the
+   channel and frees it after dropping the lock), otherwise NULL. */
+static struct spectrum_view *spectrum_view_leave_locked(struct session *sp) {
+  struct spectrum_view *v = sp->view;
+  if (v == NULL)
+    return NULL;
+  sp->view = NULL;
+  for (int i = 0; i < v->nsubs; i++) {
+    if (v->subs[i] == sp) {
+      v->subs[i] = v->subs[--v->nsubs];
+      break;
+    }
+  }
+  if (v->nsubs > 0)
+    return NULL;
+  struct spectrum_view **pp = &spectrum_views;
+  while (*pp != v)
+    pp = &(*pp)->next;
+  *pp = v->next;
+  nspectrum_views--;
+  int const q = spectrum_ssrc_quarantine_next;
+  spectrum_ssrc_quarantine[q].ssrc = v->ssrc;
+  spectrum_ssrc_quarantine[q].until_ms = now_ms() + SPECTRUM_SSRC_QUARANTINE_MS;
+  spectrum_ssrc_quarantine_next = (q + 1) % SPECTRUM_SSRC_QUARANTINE_SLOTS;
+  return v;
+}
+
+/* A view other than `self` that `key` can join, or NULL. Called with
+   spectrum_view_mutex held. */
+static struct spectrum_view *spectrum_view_find_key(struct spectrum_view_key const *key, struct spectrum_view const *self) {
+  for (struct spectrum_view *v = spectrum_views; v != NULL; v = v->next)
+    if (v != self && v->nsubs < MAX_SESSIONS && spectrum_view_key_equal(&v->key, key))
+      return v;
+  return NULL;
+}
+
+/* Put `sp` on the view for `key`, creating it if needed. Called with
+   spectrum_view_mutex held and `sp` on no view. */
+static struct spectrum_view *spectrum_view_join_locked(struct session *sp, struct spectrum_view_key const *key, bool *created) {
+  struct spectrum_view *v = spectrum_view_find_key(key, NULL);
+  if (v == NULL) {
+    v = calloc(1, sizeof(*v));
+    if (v == NULL)
+      return NULL;
+    v->key = *key;
+    v->ssrc = spectrum_view_alloc_ssrc(sp);
+    ctl_prefix_init(v->ctl_prefix, v->ssrc);
+    v->next = spectrum_views;
+    spectrum_views = v;
+    nspectrum_views++;
+    *created = true;
+  }
+  session_get(sp);
+  v->subs[v->nsubs++] = sp;
+  sp->view = v;
+  return v;
+}
+
+/* Stop the backend channel of a view nobody subscribes to any more and
+   release the subscriber references it held. Called without locks. */
+static void spectrum_view_release(struct spectrum_view *v, struct session *leaver) {
+  if (v != NULL) {
+    if (verbose)
+      fprintf(stderr, "spectrum view ssrc=%u: last subscriber left, stopping channel\n", v->ssrc);
+    control_stop_spectrum(v->ctl_prefix, v->key.bins, (float)v->key.bin_width);
+    free(v);
+  }
+  if (leaver != NULL)
+    session_put(leaver);
+}
+
+/* Leave the session's spectrum view, if any */
+static void spectrum_view_leave(struct session *sp) {
+  pthread_mutex_lock(&spectrum_view_mutex);
+  bool const was_subscribed = sp->view != NULL;
+  struct spectrum_view *v = spectrum_view_leave_locked(sp);
+  pthread_mutex_unlock(&spectrum_view_mutex);
+  if (was_subscribed)
+    spectrum_view_release(v, sp);
+}
+
+/*
+  Make sure `sp` is subscribed to the view matching its current spectrum
+  settings and request a new frame on it. The request is skipped when
+  another subscriber polled the view within 3/4 of this session's poll
+  interval, unless `force` is set (the client just moved the display).
+*/
+static void spectrum_view_poll(struct session *sp, bool force) {
+  struct spectrum_view_key key;
+
+  pthread_mutex_lock(&sp->spectrum_mutex);
+  key.center = sp->center_frequency;
+  key.bins = sp->bins;
+  key.bin_width = sp->bin_width;
+  key.window = sp->spectrum_window;
+  key.shape = sp->spectrum_shape;
+  key.averaging = sp->spectrum_avg;
+  key.overlap = sp->spectrum_overlap;
+  unsigned long const interval_ms = spectrum_rate_interval_ms(sp);
+  pthread_mutex_unlock(&sp->spectrum_mutex);
+
+  /* Avoid sending a spectrum request with frequency == 0. A 0 Hz tune
+     is interpreted by the backend as a command to close the spectrum
+     demod thread; that can race with startup and leave the spectrum
+     channel permanently closed. */
+  if (key.center == 0) {
+    if (verbose) fprintf(stderr, "%s: skipping zero-frequency spectrum request for ssrc=%u\n", __FUNCTION__, sp->ssrc);
+    return;
+  }
+
+  struct spectrum_view *old = NULL;
+  bool left = false, created = false, retuned = false, send = false;
+  uint32_t ssrc = 0;
+  uint8_t prefix[CTL_PREFIX_LEN];
+  unsigned long const now = now_ms();
+
+  pthread_mutex_lock(&spectrum_view_mutex);
+  struct spectrum_view *v = sp->view;
+  if (v != NULL && v->nsubs == 1 && sp->spectrum_active && !spectrum_view_key_equal(&v->key, &key)
+      && spectrum_view_find_key(&key, v) == NULL) {
+    /* Nobody else is on this channel and nobody has the new settings:
+       retune it instead of stopping it and starting another */
+    v->key = key;
+    retuned = true;
+  } else if (v == NULL || !spectrum_view_key_equal(&v->key, &key)) {
+    if (v != NULL) {
+      old = spectrum_view_leave_locked(sp);
+      left = true;
+    }
+    v = sp->spectrum_active ? spectrum_view_join_locked(sp, &key, &created) : NULL;
+  }
+  if (v != NULL) {
+    ssrc = v->ssrc;
+    memcpy(prefix, v->ctl_prefix, sizeof(prefix));
+    if (force || created || retuned || now - v->last_poll_ms >= interval_ms * 3 / 4) {
+      v->last_poll_ms = now;
+      send = true;
+    }
+  }
+  pthread_mutex_unlock(&spectrum_view_mutex);
+
+  if (left)
+    spectrum_view_release(old, sp);
+  if (created) {
+    if (verbose)
+      fprintf(stderr, "spectrum view ssrc=%u created for ssrc=%u (center=%u bins=%d bin_width=%u)\n",
+              ssrc, sp->ssrc, key.center, key.bins, key.bin_width);
+    /* Let the new channel's frames through the kernel filter */
+    pthread_mutex_lock(&session_mutex);
+    ssrc_filter_update();
+    pthread_mutex_unlock(&session_mutex);
+  }
+  if (retuned && verbose)
+    fprintf(stderr, "spectrum view ssrc=%u retuned for ssrc=%u (center=%u bins=%d bin_width=%u)\n",
+            ssrc, sp->ssrc, key.center, key.bins, key.bin_width);
+  /* A new or retuned channel gets its processing parameters in the same
+     command as its first spectrum request */
+  if (send)
+    control_get_powers_with_demod(prefix, &key, SPECT2_DEMOD, created || retuned);
+}
+
+/* Snapshot the backend SSRCs of all views; returns how many were stored */
+static int spectrum_view_ssrcs(uint32_t *ssrcs, int max) {
+  int n = 0;
+  pthread_mutex_lock(&spectrum_view_mutex);
+  for (struct spectrum_view *v = spectrum_views; v != NULL && n < max; v = v->next)
+    ssrcs[n++] = v->ssrc;
+  pthread_mutex_unlock(&spectrum_view_mutex);
+  return n;
+}
+
+/* Referenced subscribers of the view owning `ssrc` (release each with
+   session_put()); returns how many were stored, 0 if there is no such view */
+static int spectrum_view_subscribers(uint32_t ssrc, struct session **subs) {
+  int n = 0;
+  pthread_mutex_lock(&spectrum_view_mutex);
+  struct spectrum_view *v = spectrum_view_find_ssrc(ssrc);
+  if (v != NULL) {
+    for (n = 0; n < v->nsubs; n++) {
+      session_get(v->subs[n]);
+      subs[n] = v->subs[n];
+    }
+    v->frames++;
+  }
+  pthread_mutex_unlock(&spectrum_view_mutex);
+  return n;
+}
+
+/*
+  Kernel SSRC filter
+  ------------------
+  Input_fd and Status_fd see every channel on the radiod instance, including
+  channels that belong to other programs. To avoid waking up and copying for
+  traffic we would only discard, a classic BPF program is attached to each
+  socket (SO_ATTACH_FILTER) that accepts just our sessions' SSRCs:
+
+  - Audio (RTP): the SSRC is a fixed word in the RTP header, compared
+    against every session SSRC (even).
+  - Status: non-STATUS packets (commands from any client, including our own
+    on the shared group) are dropped. The TLV list is walked to find
+    OUTPUT_SSRC; cBPF has no backward jumps, so the walk is unrolled for
+    SSRC_FILTER_MAX_TLVS entries. The variable-length integer is extracted
+    by loading the four bytes that end at its last byte and shifting away
+    the leading ones, then compared against the session SSRCs (even) and
+    the spectrum view channels (odd, see "Spectrum views").
+
+  Anything the filter cannot parse (TLV lists longer than the unrolled walk,
+  lengths encoded in more than two bytes) is accepted and left to the
+  userspace dispatch. The programs are rebuilt from the session and view
+  lists by ssrc_filter_update(), called whenever add_session()/
+  delete_session() change the set, when a spectrum view is created and
+  whenever a socket is (re)opened. Channels of views that went away stay
+  in the filter until the next rebuild; userspace drops their stragglers.
+
+  For UDP sockets the filter sees the packet starting at the UDP header.
+*/
+#define SSRC_FILTER_MAX_TLVS 64
+#define SSRC_FILTER_MAX_SSRCS 1024 /* 2 instructions each */
+#define SSRC_FILTER_ACCEPT 0xffffffffu
+#define UDP_PAYLOAD 8
+
+static int ssrc_filter_nssrc = -1;      /* SSRCs covered by the attached filters, -1 if none */
+static bool ssrc_filter_warned;
+
+/* Emit "if A == ssrc accept" pairs followed by a final reject */
+static int ssrc_filter_match(struct sock_filter *f, int pc, uint32_t const *ssrcs, int n)
+{
+  for (int i = 0; i < n; i++) {
+    f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ssrcs[i], 0, 1);
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SSRC_FILTER_ACCEPT);
+  }
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+  return pc;
+}
+
+static int ssrc_filter_audio(struct sock_filter *f, uint32_t const *ssrcs, int n)
+{
+  int pc = 0;
+  /* RTP SSRC: bytes 8..11 of the RTP header */
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, UDP_PAYLOAD + 8);
+  return ssrc_filter_match(f, pc, ssrcs, n);
+}
+
+static int ssrc_filter_status(struct sock_filter *f, uint32_t const *ssrcs, int n)
+{
+  int pc = 0;
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, UDP_PAYLOAD);
+  f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, STATUS, 1, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_LDX | BPF_W | BPF_IMM, UDP_PAYLOAD + 1);
+
+  /* Unrolled TLV walk; X holds the offset of the current type byte. Each
+     step is 21 instructions; the jumps to "found" go through a BPF_JA
+     because conditional jump offsets are limited to 255. */
+  int found_ja[SSRC_FILTER_MAX_TLVS];
+  for (int t = 0; t < SSRC_FILTER_MAX_TLVS; t++) {
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0);           /*  0 type */
+    f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, EOL, 16, 0);  /*  1 -> 18 reject */
+    f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, OUTPUT_SSRC, 17, 0); /* 2 -> 20 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_IND, 1);           /*  3 length */
+    f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x80, 2, 0); /*  4 -> 7 long form */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 2);           /*  5 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, 8);                     /*  6 -> 15 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x7f);        /*  7 */
+    f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 1, 0);     /*  8 -> 10 */
+    f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 2, 3, 9);     /*  9 -> 13, else 19 accept */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_IND, 2);           /* 10 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 3);           /* 11 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, 2);                     /* 12 -> 15 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2);           /* 13 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 4);           /* 14 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0);           /* 15 next = X + A */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_MISC | BPF_TAX, 0);                  /* 16 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, 3);                     /* 17 -> next step */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);                     /* 18 */
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SSRC_FILTER_ACCEPT);    /* 19 */
+    found_ja[t] = pc;
+    f[pc++] = (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, 0);                     /* 20 -> found */
+  }
+  /* Too many TLVs to follow: let userspace decide */
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SSRC_FILTER_ACCEPT);
+
+  int const found = pc;
+  for (int t = 0; t < SSRC_FILTER_MAX_TLVS; t++)
+    f[found_ja[t]].k = found - (found_ja[t] + 1);
+
+  /* OUTPUT_SSRC at X: 1..4 value bytes at X+2 */
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_IND, 1);
+  f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0);
+  f[pc++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 4, 0, 1);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_ST, 1);                               /* M[1] = len */
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, 2);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_MISC | BPF_TAX, 0);                   /* X = end of value - 4 */
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_IND, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_ST, 0);                               /* M[0] = word */
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_MEM, 1);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 8);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_MISC | BPF_TAX, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_IMM, 32);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_SUB | BPF_X, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_MISC | BPF_TAX, 0);                   /* X = 32 - 8*len */
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_MEM, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_LSH | BPF_X, 0);
+  f[pc++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_RSH | BPF_X, 0);
+  return ssrc_filter_match(f, pc, ssrcs, n);
+}
+
+static void ssrc_filter_attach(int fd, struct sock_filter *f, int len, char const *what)
+{
+  struct sock_fprog prog = { .len = (unsigned short)len, .filter = f };
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0 && !ssrc_filter_warned) {
+    fprintf(stderr, "SO_ATTACH_FILTER on %s socket failed: %s; filtering SSRCs in userspace only\n",
+            what, strerror(errno));
+    ssrc_filter_warned = true;
+  }
+}
+
+/* Rebuild and attach the SSRC filters for the current session and
+   spectrum view set. Called with session_mutex held. */
+static void ssrc_filter_update(void)
+{
+  static struct sock_filter prog[BPF_MAXINSNS];
+  uint32_t ssrcs[2 * MAX_SESSIONS]; /* sessions, then view channels */
+  int n = 0;
+  for (struct session *sp = sessions; sp != NULL && n < MAX_SESSIONS; sp = sp->next)
+    ssrcs[n++] = sp->ssrc;
+  int const naudio = n;
+  n += spectrum_view_ssrcs(ssrcs + n, MAX_SESSIONS);
+
+  int const audio_fd = Input_fd, status_fd = Status_fd;
+  if (n > SSRC_FILTER_MAX_SSRCS) {
+    /* Program would not fit in BPF_MAXINSNS; filter in userspace only */
+    if (audio_fd != -1)
+      setsockopt(audio_fd, SOL_SOCKET, SO_DETACH_FILTER, NULL, 0);
+    if (status_fd != -1)
+      setsockopt(status_fd, SOL_SOCKET, SO_DETACH_FILTER, NULL, 0);
+    ssrc_filter_nssrc = -1;
+    return;
+  }
+  if (audio_fd != -1)
+    ssrc_filter_attach(audio_fd, prog, ssrc_filter_audio(prog, ssrcs, naudio), "audio");
+  if (status_fd != -1)
+    ssrc_filter_attach(status_fd, prog, ssrc_filter_status(prog, ssrcs, n), "status");
+  ssrc_filter_nssrc = n;
+}
+
+/* Packets the kernel dropped on this socket: filter rejects plus receive
+   buffer overflows (both count toward sk_drops). -1 if unknown. */
+static long socket_kernel_drops(int fd)
+{
+#if defined(SO_MEMINFO)
+  uint32_t meminfo[SK_MEMINFO_VARS];
+  socklen_t len = sizeof(meminfo);
+  if (fd != -1 && getsockopt(fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0 && len > SK_MEMINFO_DROPS * sizeof(uint32_t))
+    return meminfo[SK_MEMINFO_DROPS];
+#else
+  (void)fd;
+#endif
+  return -1;
+}
+
 void add_session(struct session *sp) {
   /* Ensure per-session spectrum/restart fields are deterministic */
   sp->last_spectrum_recv_ms = 0;
-  sp->ws_fd = -1;
   sp->spectrum_requested_by_client = false;
   sp->spectrum_restart_attempts = 0;
   sp->last_spectrum_restart_ms = 0;
   sp->write_in_progress = false;
   sp->last_write_start_ms = 0;
+  sp->deleted = false;
+  atomic_init(&sp->refs, 1); /* owned by the session list/table */
+  pthread_mutex_init(&sp->state_mutex, NULL);
 
   pthread_mutex_lock(&session_mutex);
   if(sessions==NULL) {
@@ -817,21 +1849,40 @@ void add_session(struct session *sp) {
     sessions=sp;
   }
   nsessions++;
-  /* Initialize outgoing queue and start writer thread for this session */
+  /* Initialize outgoing queue. Sessions with a known socket fd are served
+     by the output engines; otherwise start a writer thread for this session. */
   sp->out_head = sp->out_tail = NULL;
+  sp->audio_head = sp->audio_count = 0;
+  sp->status_slot = sp->spectrum_slot = NULL;
+  memset(sp->out_drops, 0, sizeof(sp->out_drops));
   pthread_mutex_init(&sp->out_mutex, NULL);
   pthread_cond_init(&sp->out_cond, NULL);
-  sp->writer_running = true;
-  if (pthread_create(&sp->writer_task, NULL, session_writer_thread, sp) == -1) {
-    perror("pthread_create: session_writer_thread");
-    sp->writer_running = false;
+  if (sp->ws_fd >= 0 && ws_nengines > 0) {
+    ws_engine_attach(sp);
+  } else {
+    sp->writer_running = true;
+    if (pthread_create(&sp->writer_task, NULL, session_writer_thread, sp) != 0) {
+      perror("pthread_create: session_writer_thread");
+      sp->writer_running = false;
+    }
   }
+  session_table_insert(sp);
+  ssrc_filter_update();
   pthread_mutex_unlock(&session_mutex);
 //fprintf(stderr,"%s: ssrc=%d first=%p ws=%p nsessions=%d\n",__FUNCTION__,sp->ssrc,sessions,sp->ws,nsessions);
 }
 
+/* Unlink a session and drop the list's reference to it. Called with
+   `session_mutex` held; releases it. Safe to call more than once (the
+   watchdog and the ingest threads may race to remove the same session);
+   callers holding their own reference must still session_put() it. */
 void delete_session(struct session *sp) {
 //fprintf(stderr,"%s: sp=%p src=%d ws=%p\n",__FUNCTION__,sp,sp->ssrc,sp->ws);
+  if (sp->deleted) {
+    pthread_mutex_unlock(&session_mutex);
+    return;
+  }
+  sp->deleted = true;
   if(sp->next!=NULL) {
     sp->next->previous=sp->previous;
   }
@@ -841,14 +1892,20 @@ void delete_session(struct session *sp) {
   if(sessions==sp) {
     sessions=sp->next;
   }
+  sp->next = sp->previous = NULL;
+  session_table_remove(sp);
   nsessions--;
+  ssrc_filter_update();
   /* Stop writer thread without holding session_mutex while joining it.
      Holding session_mutex during pthread_join can deadlock if the writer
      thread attempts to acquire session_mutex while cleaning up a blocked
      write. To avoid that, signal the writer to stop, release
-     session_mutex, then join the writer. */
+     session_mutex, then join the writer. Engine-served sessions are just
+     handed back to their engine, which lets go asynchronously. */
   bool need_join = false;
-  if (sp->writer_running) {
+  if (sp->engine != NULL) {
+    ws_engine_detach(sp);
+  } else if (sp->writer_running) {
     need_join = true;
     pthread_mutex_lock(&sp->out_mutex);
     sp->writer_running = false;
@@ -860,72 +1917,58 @@ void delete_session(struct session *sp) {
 
   if (need_join)
     pthread_join(sp->writer_task, NULL);
+  /* The view's subscriber reference would otherwise keep `sp` alive */
+  spectrum_view_leave(sp);
 
-  free_out_queue(sp);
-  pthread_mutex_destroy(&sp->out_mutex);
-  pthread_cond_destroy(&sp->out_cond);
-  free(sp);
+  /* Readers that found `sp` in the table before it was unlinked hold their
+     own reference by the time the grace period ends. */
+  synchronize_rcu();
+  session_put(sp);
 }
 
-// Note that this locks the session_mutex *if* it finds a session
+// Returns a referenced session (release with session_put()), or NULL
 static struct session *find_session_from_websocket(onion_websocket *ws) {
   pthread_mutex_lock(&session_mutex);
 //fprintf(stderr,"%s: first=%p ws=%p\n",__FUNCTION__,sessions,ws);
   struct session *sp=sessions;
   while(sp!=NULL) {
     if(sp->ws==ws) {
+      session_get(sp);
       break;
     }
     sp=sp->next;
   }
 //fprintf(stderr,"%s: ws=%p sp=%p\n",__FUNCTION__,ws,sp);
-  if (sp == NULL) {
-    pthread_mutex_unlock(&session_mutex);
-  }
+  pthread_mutex_unlock(&session_mutex);
   return sp;
 }
 
-// Note that this locks the session_mutex *if* it finds a session
-static struct session *find_session_from_ssrc(int ssrc) {
-  pthread_mutex_lock(&session_mutex);
-//fprintf(stderr,"%s: first=%p ssrc=%d\n",__FUNCTION__,sessions,ssrc);
-  struct session *sp=sessions;
-  while(sp!=NULL) {
-    if(sp->ssrc==ssrc) {
-      break;
-    }
-    sp=sp->next;
-  }
-//fprintf(stderr,"%s: ssrc=%d sp=%p\n",__FUNCTION__,ssrc,sp);
-  if (sp == NULL) {
-    pthread_mutex_unlock(&session_mutex);
-  }
-  return sp;
+// Returns a referenced session (release with session_put()), or NULL.
+// Does not take session_mutex; safe to call from the packet hot path.
+static struct session *find_session_from_ssrc(uint32_t ssrc) {
+  return session_table_lookup(ssrc);
 }
 
 void websocket_closed(struct session *sp) {
   if (verbose)
     fprintf(stderr,"%s(): SSRC=%d audio_active=%d spectrum_active=%d\n",__FUNCTION__,sp->ssrc,sp->audio_active,sp->spectrum_active);
-  pthread_t spectrum_join = 0;
-    pthread_mutex_lock(&sp->ws_mutex);
-    /* Do not command the backend to tune to 0 when a websocket closes.
-      This can result in BFREQ:0.000 being sent to other clients and
-      cause audio to disappear. */
-    // control_set_frequency(sp,"0");
+  pthread_mutex_lock(&sp->ws_mutex);
+  /* Do not command the backend to tune to 0 when a websocket closes.
+    This can result in BFREQ:0.000 being sent to other clients and
+    cause audio to disappear. */
+  // control_set_frequency(sp,"0");
   sp->audio_active=false;
   if(sp->spectrum_active) {
     pthread_mutex_lock(&sp->spectrum_mutex);
     sp->spectrum_active=false;
-    stop_spectrum_stream(sp);
-    spectrum_join = sp->spectrum_task;
     pthread_mutex_unlock(&sp->spectrum_mutex);
+    stop_spectrum_stream(sp);
   }
   /* Client disconnected: mark that client no longer requests spectrum */
   sp->spectrum_requested_by_client = false;
   sp->spectrum_restart_attempts = 0;
   sp->last_spectrum_restart_ms = 0;
   pthread_mutex_unlock(&sp->ws_mutex);
-  if (spectrum_join) pthread_join(spectrum_join, NULL);
 }
 
 static void check_frequency(struct session *sp) {
@@ -1033,7 +2076,8 @@ static bool session_pair_in_use(uint32_t ssrc) {
     }
     sp = sp->next;
   }
-  return false;
+  /* A view may still run on the spectrum SSRC of a session that is gone */
+  return spectrum_view_ssrc_in_use(ssrc + 1);
 }
 
 static uint32_t allocate_session_ssrc(void) {
@@ -1059,8 +2103,9 @@ static void *ws_ping_thread(void *arg) {
     pthread_mutex_lock(&session_mutex);
     struct session *sp = sessions;
     int n = 0;
-    struct session *list[64];
+    struct session *list[MAX_SESSIONS];
     while (sp != NULL && n < (int)(sizeof(list)/sizeof(list[0]))) {
+      session_get(sp);
       list[n++] = sp;
       sp = sp->next;
     }
@@ -1069,6 +2114,7 @@ static void *ws_ping_thread(void *arg) {
     for (int i = 0; i < n; ++i) {
       struct session *ssp = list[i];
       send_ws_text_to_session(ssp, "PING");
+      session_put(ssp);
     }
 
     if (debug_ws_ping) fprintf(stderr, "ws_ping: iter=%lu sessions=%d\n", iter, n);
@@ -1090,13 +2136,13 @@ removing the session from the global list.
 When a message is received, the function reads and parses the command, which may request actions such as starting or
 stopping spectrum or audio streaming, changing the frequency, adjusting the demodulator mode, or modifying the spectrum
 zoom level. Each command is processed by updating the session state, sending control commands to the radio backend,
-or starting/stopping per-session threads as needed. For example, a spectrum start command will launch a
-dedicated spectrum thread for that client, while a frequency change will update the session’s frequency and
+or starting/stopping per-session streams as needed. For example, a spectrum start command will put the session
+on the spectrum poll scheduler, while a frequency change will update the session’s frequency and
 notify the backend.
 
-The function uses mutexes to ensure thread-safe access to shared session data and to synchronize operations that
-affect the WebSocket or session state. After processing the command, it unlocks the session mutex and signals
-readiness for more data.
+The function holds a reference on the session while it works and serializes command handling against status
+processing with the per-session `state_mutex`; the global session mutex is only taken to unlink the session
+when the connection closes. After processing the command it drops its reference and signals readiness for more data.
 
 Overall, `websocket_cb` acts as the main dispatcher for client interactions, managing session lifecycle, interpreting
 commands, and ensuring robust, concurrent operation for multiple clients in a real-time SDR web application.
@@ -1112,7 +2158,9 @@ onion_connection_status websocket_cb(void *data, onion_websocket * ws,
   if ((int) data_ready_len < 0) {
     // The browser is closing the connection
     websocket_closed(sp);
+    pthread_mutex_lock(&session_mutex);
     delete_session(sp);                         // Note that this releases the lock
+    session_put(sp);
     return OCS_CLOSE_CONNECTION;
   }
 
@@ -1128,7 +2176,9 @@ onion_connection_status websocket_cb(void *data, onion_websocket * ws,
     ONION_ERROR("Error reading data: %d: %s (%d) ws=%p", errno, strerror(errno),
                 data_ready_len,ws);
     websocket_closed(sp);
+    pthread_mutex_lock(&session_mutex);
     delete_session(sp);                         // Note that this releases the lock
+    session_put(sp);
     return OCS_CLOSE_CONNECTION;
   }
   tmp[len] = 0;
@@ -1144,8 +2194,10 @@ onion_connection_status websocket_cb(void *data, onion_websocket * ws,
   //ONION_INFO("Read from websocket: %d: %s", len, tmp);
 
 
+  pthread_mutex_lock(&sp->state_mutex);
   onion_connection_status rc = handle_ws_message(sp, tmp);
-  pthread_mutex_unlock(&session_mutex);
+  pthread_mutex_unlock(&sp->state_mutex);
+  session_put(sp);
 
   return rc;
 }
@@ -1212,34 +2264,85 @@ int main(int argc,char **argv) {
 #endif
   {
     int c;
-    while((c = getopt(argc,argv,"d:p:m:hn:vb:rT:")) != -1){
+    while((c = getopt(argc,argv,"d:p:m:hn:vb:rT:L:C:W:O:w:R:")) != -1){
       switch(c) {
       case 'T':
         ConnTimeoutSeconds = atoi(optarg);
         if (ConnTimeoutSeconds < 0) ConnTimeoutSeconds = 0;
         break;
-        case 'd':
-          dirname=optarg;
-          break;
-        case 'p':
-          port=optarg;
-          break;
-        case 'm':
-          mcast=optarg;
-          break;
-        case 'n':
-          description_override=optarg;
-          break;
-        case 'v':
-          ++verbose;
-          break;
+      case 'L':
+        audio_latency_budget_ms = atoi(optarg);
+        if (audio_latency_budget_ms < 0) audio_latency_budget_ms = 0;
+        break;
+      case 'C':
+        control_rate = atoi(optarg);
+        if (control_rate < 1) control_rate = 1;
+        break;
+      case 'W':
+        control_coalesce_ms = atoi(optarg);
+        if (control_coalesce_ms < 0) control_coalesce_ms = 0;
+        break;
+      case 'w':
+        if (capture_open(optarg) != 0)
+          exit(EX_CANTCREAT);
+        break;
+      case 'R':
+        {
+          /* file[:speed[:map]] */
+          static char path[PATH_MAX];
+          strlcpy(path, optarg, sizeof(path));
+          char *colon = strchr(path, ':');
+          if (colon != NULL) {
+            *colon++ = '\0';
+            char *ep;
+            replay_speed = strtod(colon, &ep);
+            if (replay_speed < 0) replay_speed = 0;
+            if (*ep == ':')
+              replay_map = atoi(ep + 1) != 0;
+          }
+          replay_path = path;
+        }
+        break;
+      case 'O':
+        {
+          /* bitrate[:complexity[:frame_ms]] */
+          char *ep;
+          opus_bitrate = (int)strtol(optarg, &ep, 10);
+          if (*ep == ':')
+            opus_complexity = (int)strtol(ep + 1, &ep, 10);
+          if (*ep == ':')
+            opus_frame_ms = (int)strtol(ep + 1, &ep, 10);
+          if (opus_bitrate < 0) opus_bitrate = 0;
+          if (opus_complexity < 0) opus_complexity = 0;
+          if (opus_complexity > 10) opus_complexity = 10;
+          if (opus_frame_ms != 10 && opus_frame_ms != 20 && opus_frame_ms != 40 && opus_frame_ms != 60) {
+            fprintf(stderr, "Opus frame size must be 10, 20, 40 or 60 ms; using 20\n");
+            opus_frame_ms = 20;
+          }
+        }
+        break;
+        case 'd':
+          dirname=optarg;
+          break;
+        case 'p':
+          port=optarg;
+          break;
+        case 'm':
+          mcast=optarg;
+          break;
+        case 'n':
+          description_override=optarg;
+          break;
+        case 'v':
+          ++verbose;
+          break;
         case 'r':
           run_with_realtime = true;
           break;
         case 'h':
         default:
           fprintf(stderr,"Usage: %s\n",App_path);
-          fprintf(stderr,"       %s [-d directory] [-p port] [-m mcast_address] [-n radio description] [-r]\n",App_path);
+          fprintf(stderr,"       %s [-d directory] [-p port] [-m mcast_address] [-n radio description] [-r] [-T conn_timeout_s] [-L audio_latency_ms] [-C control_cmds_per_s] [-W coalesce_window_ms] [-O opus_bitrate[:complexity[:frame_ms]]] [-w capture_file] [-R capture_file[:speed[:map]]]\n",App_path);
           exit(EX_USAGE);
           break;
       }
@@ -1287,12 +2390,17 @@ int main(int argc,char **argv) {
   }
 
   fprintf(stderr, "ka9q-web version: v%s\n", webserver_version);
+  spectrum_kernel_check();
   pthread_mutex_init(&session_mutex,NULL);
+  if (opus_bitrate > 0)
+    opus_workers_start();
+  if (ws_engine_start() != 0)
+    fprintf(stderr, "Failed to start websocket output engines; using per-session writer threads\n");
   if (init_connections(mcast) != EX_OK) {
     fprintf(stderr, "Failed to initialize multicast connections; exiting\n");
     return EX_IOERR;
   }
-  /* Send default spectrum averaging to backend at startup (default 10) */
+  /* Default spectrum averaging for new sessions (applied per spectrum view) */
   control_set_spectrum_average(NULL, "10");
     /* Do not send a default spectrum overlap at startup; prefer client-provided value.
       control_set_spectrum_overlap(NULL, "0.5"); */
@@ -1304,6 +2412,7 @@ int main(int argc,char **argv) {
   onion_handler_add(onion_url_to_handler(urls), pages);
   onion_url_add(urls, "status", status);
   onion_url_add(urls, "version.json", version);
+  onion_url_add(urls, "metrics", metrics);
   onion_url_add(urls, "^$", home);
 
   /* Start websocket ping thread to detect dead clients (sends "PING" every 2s) */
@@ -1341,7 +2450,7 @@ that the displayed information accurately reflects the server’s real-time stat
 */
 onion_connection_status status(void *data, onion_request * req,
                                           onion_response * res) {
-    char text[1024];
+    char text[2048];
     onion_response_write0(res,
       "<!DOCTYPE html>"
       "<html>"
@@ -1365,6 +2474,81 @@ onion_connection_status status(void *data, onion_request * req,
       onion_response_write0(res, tbuf);
     }
 
+    /* Outgoing frame allocator: share of allocations served without malloc */
+    {
+      unsigned long allocs, hits, resident;
+      ws_msg_pool_stats(&allocs, &hits, &resident);
+      snprintf(text, sizeof(text), "<p><b>Frame allocator:</b> %lu allocs, %.1f%% pooled, %lu KiB resident</p>",
+               allocs, allocs ? 100.0 * hits / allocs : 100.0, resident / 1024);
+      onion_response_write0(res, text);
+      unsigned long in_use;
+      pktbuf_stats(&in_use, &resident);
+      snprintf(text, sizeof(text), "<p><b>Packet buffers:</b> %lu in use, %lu KiB resident</p>",
+               in_use, resident / 1024);
+      onion_response_write0(res, text);
+    }
+
+    /* Control command pipeline: backlog and how long commands wait to go out */
+    {
+      long depth;
+      unsigned long sent, errors, merged, batched, max_latency;
+      double avg_latency;
+      control_stats(&depth, &sent, &errors, &merged, &batched, &avg_latency, &max_latency);
+      snprintf(text, sizeof(text), "<p><b>Control commands:</b> %lu datagrams sent (%lu errors), %ld queued, "
+               "%lu merged (%d ms window), %lu folded into another datagram, "
+               "enqueue-to-send latency avg %.1f ms / max %lu ms, limit %d/s</p>",
+               sent, errors, depth, merged, control_coalesce_ms, batched, avg_latency, max_latency, control_rate);
+      onion_response_write0(res, text);
+    }
+
+    /* Multicast ingest batching: datagrams per recvmmsg() call */
+    {
+      struct mcast_ingest_stats const *st[2] = { &Audio_ingest, &Status_ingest };
+      char const *name[2] = { "audio", "status" };
+      for (int i = 0; i < 2; i++) {
+        uint64_t calls = st[i]->syscalls, pkts = st[i]->datagrams;
+        snprintf(text, sizeof(text), "<p><b>Ingest %s:</b> %llu datagrams in %llu syscalls (%.2f per syscall), %llu oversize dropped, "
+                 "%llu GRO segments overflowed</p>",
+                 name[i], (unsigned long long)pkts, (unsigned long long)calls, calls ? (double)pkts / calls : 0.0,
+                 (unsigned long long)st[i]->truncated, (unsigned long long)st[i]->overflow);
+        onion_response_write0(res, text);
+      }
+      /* In-kernel SSRC filter: what it let through vs. what never reached us */
+      if (ssrc_filter_nssrc < 0) {
+        onion_response_write0(res, "<p><b>Kernel SSRC filter:</b> not attached</p>");
+      } else {
+        snprintf(text, sizeof(text), "<p><b>Kernel SSRC filter:</b> %d SSRCs; audio %llu accepted, %ld dropped in kernel; "
+                 "status %llu accepted, %ld dropped in kernel (filter rejects and buffer overflows)</p>",
+                 ssrc_filter_nssrc, (unsigned long long)Audio_ingest.datagrams, socket_kernel_drops(Input_fd),
+                 (unsigned long long)Status_ingest.datagrams, socket_kernel_drops(Status_fd));
+        onion_response_write0(res, text);
+      }
+    }
+
+    /* Frame latency from multicast receive to the last byte written, by class and stage */
+    {
+      onion_response_write0(res, "<p><b>Frame latency ms (p50 / p99 / p99.9):</b></p><table border=1><tr><th>class</th>");
+      for (int s = 0; s < LAT_NSTAGES; s++) {
+        snprintf(text, sizeof(text), "<th>%s</th>", lat_stage_names[s]);
+        onion_response_write0(res, text);
+      }
+      onion_response_write0(res, "</tr>");
+      for (int c = WS_CLASS_STATUS; c < WS_NCLASSES; c++) {
+        snprintf(text, sizeof(text), "<tr><td>%s</td>", lat_class_names[c]);
+        onion_response_write0(res, text);
+        for (int s = 0; s < LAT_NSTAGES; s++) {
+          double p[3];
+          if (latency_global(c, s, p))
+            snprintf(text, sizeof(text), "<td>%.3f / %.3f / %.3f</td>", p[0], p[1], p[2]);
+          else
+            snprintf(text, sizeof(text), "<td>-</td>");
+          onion_response_write0(res, text);
+        }
+        onion_response_write0(res, "</tr>");
+      }
+      onion_response_write0(res, "</table>");
+    }
+
     if(nsessions!=0) {
       onion_response_write0(res, "<table border=1>"
         "<tr>"
@@ -1376,7 +2560,16 @@ onion_connection_status status(void *data, onion_request * req,
           "<th>bins</th>"
           "<th>bin width(Hz)</th>"
           "<th>Last spectrum recv</th>"
+          "<th>Spectrum interval ms (requested/adaptive/achieved)</th>"
           "<th>Audio</th>"
+          "<th>Backlog (frames/bytes)</th>"
+          "<th>Sent (frames/bytes)</th>"
+          "<th>Drops (status/audio/spectrum)</th>"
+          "<th>Spectrum coding (ratio / &micro;s per frame / keyframes)</th>"
+          "<th>Spectrum width (px / mode / bytes saved per frame)</th>"
+          "<th>Server Opus (kbit/s out / kbit/s saved / encoder CPU %)</th>"
+          "<th>Audio RTP (packets / lost / reordered / late / dupes / jitter ms)</th>"
+          "<th>Latency ms, receive to written (audio / spectrum p50 / p99 / p99.9)</th>"
           "</tr>");
 
       /* Protect iteration over the global sessions list */
@@ -1397,8 +2590,49 @@ onion_connection_status status(void *data, onion_request * req,
             snprintf(specbuf, sizeof(specbuf), "%lu ms ago", spec_age);
           }
         }
-        sprintf(text,"<tr><td>%s</td><td>%d</td><td>%d to %d</td><td>%d</td><td>%d</td><td>%d</td><td>%d</td><td>%s</td><td>%s</td></tr>",
-                sp->client,sp->ssrc,min_f,max_f,sp->frequency,sp->center_frequency,sp->bins,sp->bin_width,specbuf,sp->audio_active?"Enabled":"Disabled");
+        char codingbuf[64];
+        if (sp->spectrum_coded_frames == 0 || sp->spectrum_coded_bytes == 0)
+          snprintf(codingbuf, sizeof(codingbuf), "%s", atomic_load(&sp->spectrum_delta) ? "on" : "off");
+        else
+          snprintf(codingbuf, sizeof(codingbuf), "%.2f / %.1f / %llu",
+                   (double)sp->spectrum_raw_bytes / (double)sp->spectrum_coded_bytes,
+                   (double)sp->spectrum_encode_ns / 1000.0 / (double)sp->spectrum_coded_frames,
+                   (unsigned long long)sp->spectrum_keyframes);
+        char widthbuf[64];
+        if (sp->spectrum_px == 0)
+          snprintf(widthbuf, sizeof(widthbuf), "all bins");
+        else
+          snprintf(widthbuf, sizeof(widthbuf), "%d / %s / %.0f", sp->spectrum_px, spectrum_reduce_names[sp->spectrum_reduce],
+                   sp->spectrum_reduced_frames ? (double)sp->spectrum_reduced_bytes / (double)sp->spectrum_reduced_frames : 0.0);
+        char opusbuf[64];
+        opus_stream_stats(sp, opusbuf, sizeof(opusbuf));
+        char rtpbuf[96];
+        snprintf(rtpbuf, sizeof(rtpbuf), "%llu / %llu / %llu / %llu / %llu / %.1f",
+                 (unsigned long long)sp->audio_rx.rtp.packets, (unsigned long long)sp->audio_rx.rtp.drops,
+                 (unsigned long long)sp->audio_rx.reordered, (unsigned long long)sp->audio_rx.late,
+                 (unsigned long long)sp->audio_rx.dupes, sp->audio_rx.jitter_ms);
+        char latbuf[128];
+        {
+          double a[3], s[3];
+          bool const ha = latency_percentiles(&sp->latency[WS_CLASS_AUDIO][LAT_TOTAL], 1, 0, a);
+          bool const hs = latency_percentiles(&sp->latency[WS_CLASS_SPECTRUM][LAT_TOTAL], 1, 0, s);
+          int const n = ha ? snprintf(latbuf, sizeof(latbuf), "%.1f / %.1f / %.1f", a[0], a[1], a[2])
+                           : snprintf(latbuf, sizeof(latbuf), "-");
+          if (hs)
+            snprintf(latbuf + n, sizeof(latbuf) - n, "<br>%.1f / %.1f / %.1f", s[0], s[1], s[2]);
+          else
+            snprintf(latbuf + n, sizeof(latbuf) - n, "<br>-");
+        }
+        pthread_mutex_lock(&sp->spectrum_mutex);
+        unsigned const poll_ms = (unsigned)(sp->spectrum_poll_us / 1000);
+        unsigned long const rate_ms = spectrum_rate_interval_ms(sp);
+        pthread_mutex_unlock(&sp->spectrum_mutex);
+        sprintf(text,"<tr><td>%s</td><td>%d</td><td>%d to %d</td><td>%d</td><td>%d</td><td>%d</td><td>%d</td><td>%s</td><td>%u / %lu / %.0f</td><td>%s</td><td>%d / %ld</td><td>%llu / %llu</td><td>%llu / %llu / %llu</td><td>%s</td><td>%s</td><td>%s</td><td>%s</td><td>%s</td></tr>",
+                sp->client,sp->ssrc,min_f,max_f,sp->frequency,sp->center_frequency,sp->bins,sp->bin_width,specbuf,
+                poll_ms,rate_ms,(double)sp->spectrum_achieved_ms,sp->audio_active?"Enabled":"Disabled",
+                sp->out_frames,sp->out_bytes,(unsigned long long)sp->sent_frames,(unsigned long long)sp->sent_bytes,
+                (unsigned long long)sp->out_drops[WS_CLASS_STATUS],(unsigned long long)sp->out_drops[WS_CLASS_AUDIO],
+                (unsigned long long)sp->out_drops[WS_CLASS_SPECTRUM],codingbuf,widthbuf,opusbuf,rtpbuf,latbuf);
         onion_response_write0(res, text);
         sp=sp->next;
       }
@@ -1406,12 +2640,268 @@ onion_connection_status status(void *data, onion_request * req,
       onion_response_write0(res, "</table>");
     }
 
+    /* Shared backend spectrum channels and how many sessions each one serves.
+       Copied out under the lock (a session is on at most one view) so a slow
+       HTTP client never holds up spectrum polling and fan-out. */
+    struct {
+      uint32_t ssrc;
+      struct spectrum_view_key key;
+      int nsubs;
+      uint64_t frames;
+    } views[MAX_SESSIONS];
+    int nviews = 0;
+    pthread_mutex_lock(&spectrum_view_mutex);
+    for (struct spectrum_view *v = spectrum_views; v != NULL && nviews < MAX_SESSIONS; v = v->next) {
+      views[nviews].ssrc = v->ssrc;
+      views[nviews].key = v->key;
+      views[nviews].nsubs = v->nsubs;
+      views[nviews].frames = v->frames;
+      nviews++;
+    }
+    pthread_mutex_unlock(&spectrum_view_mutex);
+
+    snprintf(text, sizeof(text), "<p><b>Spectrum views: %d</b></p>", nviews);
+    onion_response_write0(res, text);
+    if (nviews != 0) {
+      onion_response_write0(res, "<table border=1>"
+        "<tr>"
+          "<th>channel ssrc</th>"
+          "<th>center frequency(Hz)</th>"
+          "<th>bins</th>"
+          "<th>bin width(Hz)</th>"
+          "<th>window</th>"
+          "<th>averaging</th>"
+          "<th>subscribers</th>"
+          "<th>frames</th>"
+          "</tr>");
+      for (int i = 0; i < nviews; i++) {
+        snprintf(text, sizeof(text), "<tr><td>%u</td><td>%u</td><td>%d</td><td>%u</td><td>%d</td><td>%d</td><td>%d</td><td>%llu</td></tr>",
+                 views[i].ssrc, views[i].key.center, views[i].key.bins, views[i].key.bin_width, views[i].key.window,
+                 views[i].key.averaging, views[i].nsubs, (unsigned long long)views[i].frames);
+        onion_response_write0(res, text);
+      }
+      onion_response_write0(res, "</table>");
+    }
+
     onion_response_write0(res,
         "</body>"
         "</html>");
     return OCS_PROCESSED;
 }
 
+/*
+  Prometheus exposition at /metrics (text format 0.0.4). Everything here is
+  read from counters the hot paths already keep, or from the few in
+  `Metrics` that they bump with relaxed atomics, so a scrape never stalls
+  ingest. The session and spectrum view lists are copied out under their
+  usual mutexes and formatted after releasing them, so a slow scraper
+  never holds a lock across a write. Per-session series are labelled with
+  the session's SSRC.
+*/
+static void metrics_head(onion_response *res, char const *name, char const *type, char const *help)
+{
+  char text[256];
+  snprintf(text, sizeof(text), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+  onion_response_write0(res, text);
+}
+
+static void metrics_value(onion_response *res, char const *name, char const *labels, double value)
+{
+  char text[256];
+  snprintf(text, sizeof(text), "%s%s%s%s %.17g\n", name, labels ? "{" : "", labels ? labels : "", labels ? "}" : "", value);
+  onion_response_write0(res, text);
+}
+
+onion_connection_status metrics(void *data, onion_request *req, onion_response *res)
+{
+  char labels[96];
+  onion_response_set_header(res, "Content-Type", "text/plain; version=0.0.4");
+
+  metrics_head(res, "ka9q_web_sessions", "gauge", "Open websocket sessions");
+  metrics_value(res, "ka9q_web_sessions", NULL, nsessions);
+
+  /* Multicast sockets */
+  struct mcast_ingest_stats const *st[2] = { &Audio_ingest, &Status_ingest };
+  char const *sock[2] = { "audio", "status" };
+  int const fds[2] = { Input_fd, Status_fd };
+  metrics_head(res, "ka9q_web_socket_datagrams_total", "counter", "Datagrams received per multicast socket");
+  for (int i = 0; i < 2; i++) {
+    snprintf(labels, sizeof(labels), "socket=\"%s\"", sock[i]);
+    metrics_value(res, "ka9q_web_socket_datagrams_total", labels, (double)st[i]->datagrams);
+  }
+  metrics_head(res, "ka9q_web_socket_syscalls_total", "counter", "recvmmsg() calls per multicast socket");
+  for (int i = 0; i < 2; i++) {
+    snprintf(labels, sizeof(labels), "socket=\"%s\"", sock[i]);
+    metrics_value(res, "ka9q_web_socket_syscalls_total", labels, (double)st[i]->syscalls);
+  }
+  metrics_head(res, "ka9q_web_socket_truncated_total", "counter", "Oversize datagrams dropped per multicast socket");
+  for (int i = 0; i < 2; i++) {
+    snprintf(labels, sizeof(labels), "socket=\"%s\"", sock[i]);
+    metrics_value(res, "ka9q_web_socket_truncated_total", labels, (double)st[i]->truncated);
+  }
+  metrics_head(res, "ka9q_web_socket_gro_overflow_total", "counter", "GRO segments dropped for lack of segment slots per multicast socket");
+  for (int i = 0; i < 2; i++) {
+    snprintf(labels, sizeof(labels), "socket=\"%s\"", sock[i]);
+    metrics_value(res, "ka9q_web_socket_gro_overflow_total", labels, (double)st[i]->overflow);
+  }
+  metrics_head(res, "ka9q_web_socket_kernel_drops_total", "counter", "Datagrams the kernel dropped per multicast socket");
+  for (int i = 0; i < 2; i++) {
+    long const drops = socket_kernel_drops(fds[i]);
+    if (drops < 0)
+      continue;
+    snprintf(labels, sizeof(labels), "socket=\"%s\"", sock[i]);
+    metrics_value(res, "ka9q_web_socket_kernel_drops_total", labels, (double)drops);
+  }
+
+  /* Control commands to radiod */
+  {
+    long depth;
+    unsigned long sent, errors, merged, batched, max_latency;
+    double avg_latency;
+    control_stats(&depth, &sent, &errors, &merged, &batched, &avg_latency, &max_latency);
+    metrics_head(res, "ka9q_web_control_sent_total", "counter", "Control datagrams sent to radiod");
+    metrics_value(res, "ka9q_web_control_sent_total", NULL, sent);
+    metrics_head(res, "ka9q_web_control_errors_total", "counter", "Control datagrams that failed to send");
+    metrics_value(res, "ka9q_web_control_errors_total", NULL, errors);
+    metrics_head(res, "ka9q_web_control_merged_total", "counter", "Control commands merged into a queued one");
+    metrics_value(res, "ka9q_web_control_merged_total", NULL, merged);
+    metrics_head(res, "ka9q_web_control_batched_total", "counter", "Control commands folded into another datagram");
+    metrics_value(res, "ka9q_web_control_batched_total", NULL, batched);
+    metrics_head(res, "ka9q_web_control_queue_depth", "gauge", "Control commands waiting to be sent");
+    metrics_value(res, "ka9q_web_control_queue_depth", NULL, depth);
+    metrics_head(res, "ka9q_web_control_pacing_delay_seconds", "gauge", "Enqueue-to-send delay of control commands");
+    metrics_value(res, "ka9q_web_control_pacing_delay_seconds", "stat=\"avg\"", avg_latency / 1000.0);
+    metrics_value(res, "ka9q_web_control_pacing_delay_seconds", "stat=\"max\"", max_latency / 1000.0);
+  }
+
+  /* Spectrum decode and housekeeping */
+  metrics_head(res, "ka9q_web_spectrum_packets_total", "counter", "Spectrum frames decoded from radiod vs. placeholders synthesized");
+  metrics_value(res, "ka9q_web_spectrum_packets_total", "kind=\"decoded\"",
+                (double)atomic_load_explicit(&Metrics.spectrum_decoded, memory_order_relaxed));
+  metrics_value(res, "ka9q_web_spectrum_packets_total", "kind=\"placeholder\"",
+                (double)atomic_load_explicit(&Metrics.spectrum_placeholder, memory_order_relaxed));
+  metrics_head(res, "ka9q_web_watchdog_kills_total", "counter", "Sessions removed by the websocket write watchdog");
+  metrics_value(res, "ka9q_web_watchdog_kills_total", NULL,
+                (double)atomic_load_explicit(&Metrics.watchdog_kills, memory_order_relaxed));
+  {
+    unsigned long in_use, resident;
+    pktbuf_stats(&in_use, &resident);
+    metrics_head(res, "ka9q_web_pktbufs_in_use", "gauge", "Shared packet buffers in use");
+    metrics_value(res, "ka9q_web_pktbufs_in_use", NULL, in_use);
+  }
+
+  /* Frame latency, summed over the per-thread shards */
+  metrics_head(res, "ka9q_web_frame_latency_seconds", "summary", "Multicast receive to websocket write, by class and stage");
+  for (int c = WS_CLASS_STATUS; c < WS_NCLASSES; c++) {
+    for (int s = 0; s < LAT_NSTAGES; s++) {
+      static char const *const quantile[3] = { "0.5", "0.99", "0.999" };
+      double p[3];
+      if (!latency_global(c, s, p))
+        continue;
+      for (int k = 0; k < 3; k++) {
+        snprintf(labels, sizeof(labels), "class=\"%s\",stage=\"%s\",quantile=\"%s\"",
+                 lat_class_names[c], lat_stage_names[s], quantile[k]);
+        metrics_value(res, "ka9q_web_frame_latency_seconds", labels, p[k] / 1000.0);
+      }
+    }
+  }
+
+  /* Per session, from a snapshot of the session and view lists */
+  struct metrics_session {
+    uint32_t ssrc;
+    uint64_t audio_packets, status_packets;
+    double value[10]; /* by family below; 0, 5 and 8 have their own series */
+    uint64_t drops[WS_NCLASSES];
+    uint64_t late, dupes;
+  } *ms = malloc(sizeof(*ms) * MAX_SESSIONS);
+  struct {
+    uint32_t ssrc;
+    uint64_t frames;
+  } views[MAX_SESSIONS];
+  int nms = 0, nviews = 0;
+  if (ms == NULL)
+    return OCS_PROCESSED;
+  pthread_mutex_lock(&session_mutex);
+  for (struct session *sp = sessions; sp != NULL && nms < MAX_SESSIONS; sp = sp->next) {
+    struct audio_rx const *rx = &sp->audio_rx;
+    struct metrics_session *m = &ms[nms++];
+    m->ssrc = sp->ssrc;
+    m->audio_packets = sp->audio_packets;
+    m->status_packets = sp->status_packets;
+    double const value[10] = {
+      0, (double)sp->out_frames, (double)sp->out_bytes, (double)sp->sent_frames, (double)sp->sent_bytes,
+      0, (double)rx->rtp.drops, (double)rx->reordered, 0, rx->jitter_ms / 1000.0,
+    };
+    memcpy(m->value, value, sizeof(value));
+    for (int c = 0; c < WS_NCLASSES; c++)
+      m->drops[c] = sp->out_drops[c];
+    m->late = rx->late;
+    m->dupes = rx->dupes;
+  }
+  pthread_mutex_lock(&spectrum_view_mutex);
+  for (struct spectrum_view *v = spectrum_views; v != NULL && nviews < MAX_SESSIONS; v = v->next) {
+    views[nviews].ssrc = v->ssrc;
+    views[nviews].frames = v->frames;
+    nviews++;
+  }
+  pthread_mutex_unlock(&spectrum_view_mutex);
+  pthread_mutex_unlock(&session_mutex);
+
+  static struct {
+    char const *name, *type, *help;
+  } const family[] = {
+    { "ka9q_web_ssrc_packets_total", "counter", "Datagrams received per SSRC" },
+    { "ka9q_web_session_queue_frames", "gauge", "Frames queued to the websocket" },
+    { "ka9q_web_session_queue_bytes", "gauge", "Bytes queued to the websocket" },
+    { "ka9q_web_session_sent_frames_total", "counter", "Frames written to the websocket" },
+    { "ka9q_web_session_sent_bytes_total", "counter", "Bytes written to the websocket" },
+    { "ka9q_web_session_drops_total", "counter", "Frames shed from the websocket queue" },
+    { "ka9q_web_audio_lost_total", "counter", "Audio packets never received" },
+    { "ka9q_web_audio_reordered_total", "counter", "Audio packets received out of order" },
+    { "ka9q_web_audio_discarded_total", "counter", "Audio packets discarded as late or duplicate" },
+    { "ka9q_web_audio_jitter_seconds", "gauge", "RFC 3550 interarrival jitter" },
+  };
+  int const nfamily = sizeof(family) / sizeof(family[0]);
+  for (int f = 0; f < nfamily; f++) {
+    metrics_head(res, family[f].name, family[f].type, family[f].help);
+    for (int i = 0; i < nms; i++) {
+      struct metrics_session const *m = &ms[i];
+      switch (f) {
+      case 0:
+        snprintf(labels, sizeof(labels), "ssrc=\"%u\",stream=\"audio\"", m->ssrc);
+        metrics_value(res, family[f].name, labels, (double)m->audio_packets);
+        snprintf(labels, sizeof(labels), "ssrc=\"%u\",stream=\"status\"", m->ssrc);
+        metrics_value(res, family[f].name, labels, (double)m->status_packets);
+        continue;
+      case 5:
+        for (int c = WS_CLASS_STATUS; c < WS_NCLASSES; c++) {
+          static char const *const cls[WS_NCLASSES] = { "control", "status", "audio", "spectrum" };
+          snprintf(labels, sizeof(labels), "ssrc=\"%u\",class=\"%s\"", m->ssrc, cls[c]);
+          metrics_value(res, family[f].name, labels, (double)m->drops[c]);
+        }
+        continue;
+      case 8:
+        snprintf(labels, sizeof(labels), "ssrc=\"%u\",reason=\"late\"", m->ssrc);
+        metrics_value(res, family[f].name, labels, (double)m->late);
+        snprintf(labels, sizeof(labels), "ssrc=\"%u\",reason=\"duplicate\"", m->ssrc);
+        metrics_value(res, family[f].name, labels, (double)m->dupes);
+        continue;
+      }
+      snprintf(labels, sizeof(labels), "ssrc=\"%u\"", m->ssrc);
+      metrics_value(res, family[f].name, labels, m->value[f]);
+    }
+    /* Spectrum channels are per view, not per session */
+    if (f == 0) {
+      for (int i = 0; i < nviews; i++) {
+        snprintf(labels, sizeof(labels), "ssrc=\"%u\",stream=\"spectrum\"", views[i].ssrc);
+        metrics_value(res, family[f].name, labels, (double)views[i].frames);
+      }
+    }
+  }
+  free(ms);
+  return OCS_PROCESSED;
+}
+
 onion_connection_status version(void *data, onion_request * req,
                                           onion_response * res) {
     char text[1024];
@@ -1581,6 +3071,7 @@ onion_connection_status home(void *data, onion_request * req,
    *    sessions/clients are active.
    */
   sp->ssrc = allocate_session_ssrc();
+  ctl_prefix_init(sp->ctl_prefix, sp->ssrc);
   sp->ws=ws;
   /* Try to set the underlying websocket socket to non-blocking so slow
      clients do not block server threads. As with the reattach path above,
@@ -1668,6 +3159,12 @@ onion_connection_status home(void *data, onion_request * req,
   pthread_mutex_init(&sp->spectrum_mutex,NULL);
   /* initialize per-session poll interval from global default */
   sp->spectrum_poll_us = spectrum_poll_us;
+  sp->spectrum_slowest_ms = SPECTRUM_RATE_SLOWEST_MS;
+  sp->spectrum_rate_fps = 1e6f / (float)spectrum_poll_us;
+  sp->spectrum_window = spectrum_default_window;
+  sp->spectrum_shape = spectrum_default_shape;
+  sp->spectrum_avg = spectrum_default_avg;
+  sp->spectrum_overlap = spectrum_default_overlap;
   add_session(sp);
   init_control(sp);
   //fprintf(stderr,"%s: onion_websocket_set_callback: websocket_cb\n",__FUNCTION__);
@@ -1678,23 +3175,500 @@ onion_connection_status home(void *data, onion_request * req,
   return OCS_WEBSOCKET;
 }
 
+/* Datagrams drained from Input_fd per recvmmsg() call */
+#define AUDIO_BATCH 16
+
+/*
+  Server-side Opus encoding
+  -------------------------
+  With -O bitrate[:complexity[:frame_ms]] a client's `O:OPUS` no longer asks
+  radiod to encode its channel: the channel stays S16BE and ka9q-web encodes
+  it, so radiod runs no Opus encoder for web listeners and clients still get
+  Opus-sized audio. Without -O, `O:OPUS` is passed on to radiod as before.
+
+  There is one encoder per source stream (a radiod SSRC), created by the
+  worker that owns the stream and kept with the session that stream feeds.
+  A small pool of worker threads does the encoding, away from audio_thread;
+  a stream always goes to the same worker (by SSRC), so its packets stay in
+  order. audio_thread only hands the shared packet buffer over by reference.
+  The worker collects S16BE samples until it has a frame of opus_frame_ms,
+  encodes it and queues the packet (payload type Opus_pt, 48 kHz timestamps)
+  to the subscribed session. Streams the browser cannot take as Opus
+  (stereo, or a sample rate Opus does not accept) are forwarded unchanged.
+
+  Per stream, the status page shows the Opus bit rate, the bandwidth saved
+  against the PCM it replaced and the encoder's share of one CPU.
+*/
+#define OPUS_WORKERS_MAX 8
+#define OPUS_JOB_RING 256  /* pending packets per worker */
+#define OPUS_FRAME_MAX 2880 /* samples in 60 ms at 48 kHz */
+
+int opus_bitrate = 0;
+int opus_complexity = 5;
+int opus_frame_ms = 20;
+
+struct opus_stream {
+  OpusEncoder *enc;
+  int samprate;
+  int frame;                  /* samples per Opus frame */
+  int16_t pcm[OPUS_FRAME_MAX];
+  int npcm;
+  uint16_t seq;
+  uint32_t timestamp;         /* 48 kHz units */
+  unsigned long start_ms;
+  uint64_t encode_ns;
+  uint64_t in_bytes;          /* PCM datagrams replaced */
+  uint64_t out_bytes;         /* Opus datagrams sent */
+};
+
+struct opus_job {
+  struct session *sp;
+  struct pktbuf *pb;
+  int size;
+};
+
+struct opus_worker {
+  pthread_t task;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  struct opus_job ring[OPUS_JOB_RING];
+  int head;
+  int count;
+  uint64_t dropped;
+};
+
+static struct opus_worker opus_workers[OPUS_WORKERS_MAX];
+static int opus_nworkers;
+
+/* (Re)create the stream's encoder for `samprate`; returns false if it cannot be used */
+static bool opus_stream_setup(struct opus_stream *st, int samprate)
+{
+  int error = OPUS_OK;
+  if (st->enc != NULL)
+    opus_encoder_destroy(st->enc);
+  st->enc = opus_encoder_create(samprate, 1, OPUS_APPLICATION_AUDIO, &error);
+  if (st->enc == NULL || error != OPUS_OK) {
+    fprintf(stderr, "opus_encoder_create(%d): %s\n", samprate, opus_strerror(error));
+    st->enc = NULL;
+    st->samprate = 0;
+    return false;
+  }
+  opus_encoder_ctl(st->enc, OPUS_SET_BITRATE(opus_bitrate));
+  opus_encoder_ctl(st->enc, OPUS_SET_COMPLEXITY(opus_complexity));
+  st->samprate = samprate;
+  st->frame = samprate / 1000 * opus_frame_ms;
+  st->npcm = 0;
+  return true;
+}
+
+/* Encode one PCM datagram of session `sp` (called on the stream's worker) */
+static void opus_encode_packet(struct session *sp, struct pktbuf *pb, int size)
+{
+  struct rtp_header rtp;
+  uint8_t const *dp = ntoh_rtp(&rtp, pb->data);
+  int len = size - (int)(dp - pb->data);
+  if (rtp.pad)
+    len -= dp[len - 1];
+
+  int const samprate = samprate_from_pt(rtp.type);
+  bool const usable = len > 0 && encoding_from_pt(rtp.type) == S16BE && channels_from_pt(rtp.type) == 1
+    && (samprate == 8000 || samprate == 12000 || samprate == 16000 || samprate == 24000 || samprate == 48000);
+  if (!usable) {
+    send_ws_pktbuf_to_session(sp, pb, size, WS_CLASS_AUDIO);
+    return;
+  }
+
+  struct opus_stream *st = sp->opus_stream;
+  if (st == NULL) {
+    st = calloc(1, sizeof(*st));
+    if (st == NULL)
+      return;
+    st->start_ms = now_ms();
+    sp->opus_stream = st;
+  }
+  if (st->samprate != samprate && !opus_stream_setup(st, samprate)) {
+    send_ws_pktbuf_to_session(sp, pb, size, WS_CLASS_AUDIO);
+    return;
+  }
+  st->in_bytes += size;
+
+  int const nsamples = len / 2;
+  for (int i = 0; i < nsamples; i++) {
+    st->pcm[st->npcm++] = (int16_t)(dp[2 * i] << 8 | dp[2 * i + 1]);
+    if (st->npcm < st->frame)
+      continue;
+    st->npcm = 0;
+
+    struct pktbuf *out = pktbuf_alloc();
+    if (out == NULL)
+      continue;
+    out->recv_ns = pb->recv_ns;
+    struct rtp_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.version = RTP_VERS;
+    hdr.type = Opus_pt;
+    hdr.ssrc = rtp.ssrc;
+    hdr.seq = st->seq++;
+    hdr.timestamp = st->timestamp;
+    st->timestamp += 48 * opus_frame_ms;
+    uint8_t *bp = (uint8_t *)hton_rtp((char *)out->data, &hdr);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    opus_int32 const n = opus_encode(st->enc, st->pcm, st->frame, bp, PKTBUF_CAP - (int)(bp - out->data));
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    st->encode_ns += (uint64_t)((t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec));
+    if (n > 0) {
+      int const total = (int)(bp - out->data) + n;
+      st->out_bytes += total;
+      send_ws_pktbuf_to_session(sp, out, total, WS_CLASS_AUDIO);
+    }
+    pktbuf_put(out);
+  }
+}
+
+static void *opus_worker_thread(void *arg)
+{
+  struct opus_worker *w = (struct opus_worker *)arg;
+  for (;;) {
+    pthread_mutex_lock(&w->mutex);
+    while (w->count == 0)
+      pthread_cond_wait(&w->cond, &w->mutex);
+    struct opus_job job = w->ring[w->head];
+    w->head = (w->head + 1) % OPUS_JOB_RING;
+    w->count--;
+    pthread_mutex_unlock(&w->mutex);
+
+    if (job.sp->ws != NULL && job.sp->audio_active)
+      opus_encode_packet(job.sp, job.pb, job.size);
+    pktbuf_put(job.pb);
+    session_put(job.sp);
+  }
+  return NULL;
+}
+
+/* Hand a PCM datagram of `sp` to its stream's worker; the packet buffer and
+   the session are referenced until the worker is done with them */
+static void opus_submit(struct session *sp, struct pktbuf *pb, int size)
+{
+  struct opus_worker *w = &opus_workers[sp->ssrc % (uint32_t)opus_nworkers];
+  pthread_mutex_lock(&w->mutex);
+  if (w->count == OPUS_JOB_RING) {
+    w->dropped++;
+    pthread_mutex_unlock(&w->mutex);
+    return;
+  }
+  session_get(sp);
+  atomic_fetch_add_explicit(&pb->refs, 1, memory_order_relaxed);
+  struct opus_job *job = &w->ring[(w->head + w->count) % OPUS_JOB_RING];
+  job->sp = sp;
+  job->pb = pb;
+  job->size = size;
+  w->count++;
+  pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->mutex);
+}
+
+/* Start the encoder pool (only when -O was given) */
+static void opus_workers_start(void)
+{
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int n = ncpu > 1 ? (int)(ncpu / 2) : 1;
+  if (n > OPUS_WORKERS_MAX)
+    n = OPUS_WORKERS_MAX;
+  for (int i = 0; i < n; i++) {
+    struct opus_worker *w = &opus_workers[i];
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->task, NULL, opus_worker_thread, w) != 0) {
+      perror("pthread_create: opus_worker_thread");
+      break;
+    }
+    pthread_setname_np(w->task, "opus_enc");
+    opus_nworkers = i + 1;
+  }
+}
+
+/* Status page cell: kbit/s sent, kbit/s saved against PCM, encoder CPU % */
+static void opus_stream_stats(struct session const *sp, char *buf, size_t len)
+{
+  struct opus_stream const *st = sp->opus_stream;
+  if (!sp->server_opus || st == NULL) {
+    snprintf(buf, len, "%s", sp->server_opus ? "on" : "off");
+    return;
+  }
+  double const secs = (double)(now_ms() - st->start_ms + 1) / 1000.0;
+  snprintf(buf, len, "%.1f / %.1f / %.2f",
+           8.0 * (double)st->out_bytes / secs / 1000.0,
+           8.0 * ((double)st->in_bytes - (double)st->out_bytes) / secs / 1000.0,
+           100.0 * (double)st->encode_ns / 1e9 / secs);
+}
+
+/* Free the stream's encoder with its session */
+static void opus_stream_free(struct opus_stream *st)
+{
+  if (st == NULL)
+    return;
+  if (st->enc != NULL)
+    opus_encoder_destroy(st->enc);
+  free(st);
+}
+
+/*
+  Audio RTP sequence tracking
+  ---------------------------
+  radiod's multicast reaches us in whatever order the network delivers it,
+  and browsers play what they get. Each session therefore runs its audio
+  through a small reorder window before anything is queued to the websocket.
+  A packet is held in its slot (by reference, not copied) until everything
+  before it has arrived, the window fills up, or the oldest held packet has
+  waited AUDIO_REORDER_MS; then released packets go out in sequence order
+  and any gap left behind counts as lost. Duplicates and packets whose turn
+  has already passed are discarded here. The age limit is also enforced
+  without new arrivals: sessions holding packets are listed (with a
+  reference) on audio_rx_pending, and audio_rx_expire() releases their stale
+  packets whenever the receive call returns, which with its short timeout
+  is at least every AUDIO_REORDER_MS / 2.
+
+  Packets released from the window go through rtp_process(), so lost
+  packets show up as its drops. Interarrival jitter follows RFC 3550 A.8,
+  measured in RTP timestamp units and shown in milliseconds. Only
+  audio_thread touches this state; the status page reads the counters
+  without a lock, as it does the other per-session statistics.
+*/
+/* Queue one in-order packet to the browser, or to the Opus encoder pool */
+static void audio_forward(struct session *sp, struct audio_slot const *slot)
+{
+  struct rtp_header hdr;
+  ntoh_rtp(&hdr, slot->pb->data);
+  rtp_process(&sp->audio_rx.rtp, &hdr, slot->samples);
+  sp->audio_rx.rtp.bytes += slot->size;
+  if (sp->server_opus && opus_nworkers > 0)
+    opus_submit(sp, slot->pb, slot->size);
+  else
+    send_ws_pktbuf_to_session(sp, slot->pb, slot->size, WS_CLASS_AUDIO);
+}
+
+/* Release the slot expected next, held or not, and advance past it */
+static void audio_rx_release_one(struct session *sp)
+{
+  struct audio_rx *rx = &sp->audio_rx;
+  struct audio_slot *slot = &rx->slot[rx->next_seq % AUDIO_REORDER_SLOTS];
+  if (slot->pb != NULL) {
+    audio_forward(sp, slot);
+    pktbuf_put(slot->pb);
+    slot->pb = NULL;
+    rx->held--;
+    rx->seen = rx->seen << 1 | 1;
+  } else {
+    rx->seen <<= 1;
+  }
+  rx->next_seq++;
+}
+
+/* Sessions with packets in their reorder window; audio thread only */
+static struct session *audio_rx_pending[MAX_SESSIONS];
+static int audio_rx_npending;
+
+/* Send what is in order; give up on a gap once its successor is stale */
+static void audio_rx_drain(struct session *sp, uint64_t now)
+{
+  struct audio_rx *rx = &sp->audio_rx;
+  while (rx->held > 0) {
+    struct audio_slot const *head = &rx->slot[rx->next_seq % AUDIO_REORDER_SLOTS];
+    if (head->pb == NULL) {
+      uint64_t oldest = UINT64_MAX;
+      for (int i = 0; i < AUDIO_REORDER_SLOTS; i++)
+        if (rx->slot[i].pb != NULL && rx->slot[i].arrival_ns < oldest)
+          oldest = rx->slot[i].arrival_ns;
+      if (now - oldest < (uint64_t)AUDIO_REORDER_MS * 1000000ULL)
+        break;
+    }
+    audio_rx_release_one(sp);
+  }
+}
+
+/* Release packets that have waited too long in any session's window, even
+   if no later packet arrived to push them out, and forget sessions that no
+   longer hold anything */
+static void audio_rx_expire(uint64_t now)
+{
+  for (int i = 0; i < audio_rx_npending;) {
+    struct session *sp = audio_rx_pending[i];
+    if (sp->audio_active && sp->ws != NULL)
+      audio_rx_drain(sp, now);
+    if (sp->audio_rx.held > 0 && sp->audio_active && sp->ws != NULL) {
+      i++;
+      continue;
+    }
+    sp->audio_rx.pending = false;
+    audio_rx_pending[i] = audio_rx_pending[--audio_rx_npending];
+    session_put(sp);
+  }
+}
+
+/* Release everything held, in order */
+static void audio_rx_flush(struct session *sp)
+{
+  struct audio_rx *rx = &sp->audio_rx;
+  for (int i = 0; i < AUDIO_REORDER_SLOTS && rx->held > 0; i++)
+    audio_rx_release_one(sp);
+}
+
+/* Run one arriving datagram through the session's reorder window */
+static void audio_rx_packet(struct session *sp, struct pktbuf *pb, int size, struct rtp_header const *rtp, int samples)
+{
+  struct audio_rx *rx = &sp->audio_rx;
+  uint64_t const now = mono_ns();
+  int const samprate = samprate_from_pt(rtp->type);
+
+  /* RFC 3550 interarrival jitter, in timestamp units */
+  if (samprate > 0) {
+    uint32_t const arrival = (uint32_t)(now / 1000000000ULL * (uint64_t)samprate
+                                        + now % 1000000000ULL * (uint64_t)samprate / 1000000000ULL);
+    int32_t const transit = (int32_t)(arrival - rtp->timestamp);
+    if (rx->jitter_init) {
+      int32_t d = transit - rx->transit;
+      if (d < 0)
+        d = -d;
+      rx->jitter += ((double)d - rx->jitter) / 16.0;
+      rx->jitter_ms = rx->jitter * 1000.0 / samprate;
+    }
+    rx->transit = transit;
+    rx->jitter_init = true;
+  }
+
+  if (!rx->init) {
+    rx->rtp.seq = rtp->seq; /* a pause in audio is not loss */
+    rx->next_seq = rtp->seq;
+    rx->highest_seq = rtp->seq;
+    rx->init = true;
+  }
+  int step = (int16_t)(rtp->seq - rx->next_seq);
+  if (step < -AUDIO_RESYNC || step > AUDIO_RESYNC) {
+    /* Sender restarted: play out what we hold and start over here. The
+       jump is not loss, so the RTP counters restart here too. */
+    audio_rx_flush(sp);
+    rx->rtp.seq = rtp->seq;
+    rx->rtp.timestamp = rtp->timestamp;
+    rx->next_seq = rtp->seq;
+    rx->highest_seq = rtp->seq;
+    rx->seen = 0;
+    rx->resyncs++;
+    step = 0;
+  }
+  if (step < 0) {
+    /* Its turn has passed: a copy we already sent, or too late to use */
+    if (-step <= 64 && (rx->seen >> (-step - 1) & 1))
+      rx->dupes++;
+    else
+      rx->late++;
+    return;
+  }
+  if ((int16_t)(rtp->seq - rx->highest_seq) < 0)
+    rx->reordered++;
+  else
+    rx->highest_seq = rtp->seq;
+
+  /* Make room: anything that would fall out of the window is released */
+  while (step >= AUDIO_REORDER_SLOTS) {
+    audio_rx_release_one(sp);
+    step--;
+  }
+  struct audio_slot *slot = &rx->slot[rtp->seq % AUDIO_REORDER_SLOTS];
+  if (slot->pb != NULL) {
+    rx->dupes++;
+    return;
+  }
+  atomic_fetch_add_explicit(&pb->refs, 1, memory_order_relaxed);
+  slot->pb = pb;
+  slot->size = size;
+  slot->samples = samples;
+  slot->arrival_ns = now;
+  rx->held++;
+
+  audio_rx_drain(sp, now);
+  if (rx->held > 0 && !rx->pending && audio_rx_npending < MAX_SESSIONS) {
+    session_get(sp);
+    rx->pending = true;
+    audio_rx_pending[audio_rx_npending++] = sp;
+  }
+}
+
+/* Drop the packets still held when the session goes away */
+static void audio_rx_free(struct audio_rx *rx)
+{
+  for (int i = 0; i < AUDIO_REORDER_SLOTS; i++) {
+    if (rx->slot[i].pb != NULL)
+      pktbuf_put(rx->slot[i].pb);
+    rx->slot[i].pb = NULL;
+  }
+  rx->held = 0;
+}
+
+/* Forward one RTP datagram, received into `pb`, to the session owning its SSRC */
+static void dispatch_audio_packet(struct pktbuf *pb, ssize_t size)
+{
+  struct session *sp;
+  struct rtp_header rtp;
+
+  if (size <= RTP_MIN_SIZE)
+    return; /* Must be big enough for RTP header and at least some data */
+
+  // Convert RTP header to host format
+  uint8_t const *dp = ntoh_rtp(&rtp,pb->data);
+  ssize_t len = size - (dp - pb->data);
+  if(rtp.pad)
+    len -= dp[len-1];
+  if(len <= 0)
+    return; // Used to be an assert, but would be triggered by bogus packets
+
+  /* record last successful audio packet recv for watchdog */
+  last_audio_recv_ms = now_ms();
+  if (debugSSRC) fprintf(stderr, "monitor: audio recv ssrc=%u at %lu\n", rtp.ssrc, last_audio_recv_ms);
+
+  sp = find_session_from_ssrc(rtp.ssrc);
+//fprintf(stderr,"%s: sp=%p ssrc=%d\n",__FUNCTION__,sp,rtp.ssrc);
+  if (sp != NULL) {
+    sp->audio_packets++;
+    if (sp->ws == NULL) {
+      if (debugSSRC) fprintf(stderr, "%s: removing stale audio session ssrc=%d sp=%p\n", __FUNCTION__, sp->ssrc, (void *)sp);
+      pthread_mutex_lock(&session_mutex);
+      delete_session(sp);
+    } else if (sp->audio_active) {
+      int samples = 0;
+      int const channels = channels_from_pt(rtp.type);
+      if (encoding_from_pt(rtp.type) == S16BE && channels > 0)
+        samples = (int)(len / (2 * channels));
+      audio_rx_packet(sp, pb, (int)size, &rtp, samples);
+    } else if (sp->audio_rx.init) {
+      /* Audio muted: start a fresh window when it comes back */
+      audio_rx_free(&sp->audio_rx);
+      sp->audio_rx.init = false;
+      sp->audio_rx.jitter_init = false;
+    }
+    session_put(sp);
+  }  // not found
+}
+
 /*
 The `audio_thread` function is a POSIX thread entry point designed to handle audio packet reception
-and forwarding in a networked application. It begins by allocating memory for a `packet` structure,
-which will be used to store incoming audio data. The function then waits for the `Channel.output.dest_socket`
+and forwarding in a networked application. It begins by waiting for the `Channel.output.dest_socket`
 to be initialized (its `sa_family` field set), using a mutex and condition variable to synchronize with other
  threads. Once the destination socket is ready, it calls `listen_mcast` to join a multicast group and obtain a
  socket file descriptor for receiving audio data.
 
 If the socket setup fails (`Input_fd == -1`), the thread exits cleanly. Otherwise, the thread enters an infinite
-loop where it waits for incoming packets using `recvfrom`. If an error occurs (other than an interrupt), it logs
-the error and briefly sleeps before retrying. It also skips packets that are too small to be valid RTP packets.
+loop where it drains the socket in batches with `mcast_recv_batch()` (one `recvmmsg` call for up to AUDIO_BATCH
+datagrams, each received into its own shared packet buffer). If an error occurs (other than an interrupt), it logs
+the error and briefly sleeps before retrying.
 
-For each valid packet, the function parses the RTP header and adjusts the data pointer and length accordingly,
-handling RTP padding if present. It then attempts to find an active session matching the packet's SSRC (synchronization source identifier).
-If a session is found and is marked as audio-active, the function locks the session's websocket mutex, sets the
-websocket opcode to binary, and writes the packet data to the websocket. If the write fails, it logs an error.
-After handling the packet, it unlocks the session mutex.
+Each datagram is handed to `dispatch_audio_packet()`, which skips packets that are too small to be valid RTP
+packets, parses the RTP header and adjusts the data pointer and length accordingly,
+handling RTP padding if present. It then looks up the session matching the packet's SSRC (synchronization source
+identifier) in the lock-free SSRC table, which hands back a referenced session without taking the global session
+mutex. If the session is marked as audio-active, the packet is queued for that session's websocket, and the
+reference is dropped afterwards.
 
 Throughout, the function uses careful synchronization to avoid race conditions, and it is robust against
 malformed or unexpected network data. The design allows for real-time forwarding of audio streams from
@@ -1702,8 +3676,9 @@ multicast to websocket clients, making it suitable for applications like network
 conferencing.
 */
 static void *audio_thread(void *arg) {
-  struct session *sp;
-  struct packet *pkt = malloc(sizeof(*pkt));
+  struct pktbuf *pbs[AUDIO_BATCH] = { NULL };
+  uint8_t *bufs[AUDIO_BATCH];
+  struct mcast_seg segs[AUDIO_BATCH];
 
   //fprintf(stderr,"%s\n",__FUNCTION__);
 
@@ -1719,14 +3694,15 @@ static void *audio_thread(void *arg) {
       Input_fd = listen_mcast(NULL, &Channel.output.dest_socket, NULL);
       if (Input_fd != -1) {
         /* Increase receive buffer to 256 KiB to reduce packet drops during
-           brief bursts of multicast traffic; also set a 1s recv timeout so
-           the thread can periodically check shutdown conditions. */
+           brief bursts of multicast traffic; also set a short recv timeout
+           so held audio is released on time (audio_rx_expire()) when
+           nothing arrives. */
         int rcv = 256 * 1024; /* 256 KiB */
         if (setsockopt(Input_fd, SOL_SOCKET, SO_RCVBUF, &rcv, sizeof(rcv)) < 0) {
           perror("setsockopt SO_RCVBUF Input_fd");
         }
         struct timeval tv;
-        tv.tv_sec = 1; tv.tv_usec = 0;
+        tv.tv_sec = 0; tv.tv_usec = AUDIO_REORDER_MS / 2 * 1000;
         if (setsockopt(Input_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
           perror("setsockopt SO_RCVTIMEO Input_fd");
         }
@@ -1739,6 +3715,10 @@ static void *audio_thread(void *arg) {
       usleep(500000);
       continue;
     }
+    /* Only our sessions' audio gets past the kernel */
+    pthread_mutex_lock(&session_mutex);
+    ssrc_filter_update();
+    pthread_mutex_unlock(&session_mutex);
     break;
   }
 
@@ -1755,60 +3735,50 @@ static void *audio_thread(void *arg) {
       continue;
     }
 
-    struct sockaddr_storage sender;
-    socklen_t socksize = sizeof(sender);
-    ssize_t size = recvfrom(fd, &pkt->content, sizeof(pkt->content), 0,
-                            (struct sockaddr *)&sender, &socksize);
+    /* Receive straight into shared packet buffers; sessions forward them by
+       reference. Buffers nobody else holds are reused for the next batch. */
+    int nbufs = 0;
+    while (nbufs < AUDIO_BATCH && (pbs[nbufs] != NULL || (pbs[nbufs] = pktbuf_alloc()) != NULL)) {
+      bufs[nbufs] = pbs[nbufs]->data;
+      nbufs++;
+    }
+    if (nbufs == 0) {
+      usleep(1000);
+      continue;
+    }
+    int n = mcast_recv_batch(fd, bufs, PKTBUF_CAP, nbufs, segs, nbufs, &Audio_ingest);
 
-    if (size == -1) {
-      if (errno == EINTR)
-        continue; /* interrupted, try again */
-      if (errno == EAGAIN || errno == EWOULDBLOCK)
-        continue; /* no data available yet, not an error to log */
+    if (n == -1) {
       if (errno == EBADF) {
         /* Socket was closed by monitor thread after we snapped it; back off */
         usleep(1000);
         continue;
       }
       /* Unexpected error; log it once and back off briefly */
-      perror("recvfrom");
+      perror("recvmmsg");
       fprintf(stderr, "address=%s\n", formatsock(&Channel.output.dest_socket, false));
       usleep(1000);
-      continue; /* reuse current buffer */
+      continue; /* reuse current buffers */
     }
 
-    if (size <= RTP_MIN_SIZE)
-      continue; /* Must be big enough for RTP header and at least some data */
-
-    // Convert RTP header to host format
-    uint8_t const *dp = ntoh_rtp(&pkt->rtp,pkt->content);
-    pkt->data = dp;
-    pkt->len = size - (dp - pkt->content);
-    if(pkt->rtp.pad){
-      pkt->len -= dp[pkt->len-1];
-      pkt->rtp.pad = 0;
-    }
-    if(pkt->len <= 0)
-      continue; // Used to be an assert, but would be triggered by bogus packets
-
-    /* record last successful audio packet recv for watchdog */
-    last_audio_recv_ms = now_ms();
-    if (debugSSRC) fprintf(stderr, "monitor: audio recv ssrc=%u at %lu\n", pkt->rtp.ssrc, last_audio_recv_ms);
-
-
-    sp = find_session_from_ssrc(pkt->rtp.ssrc);
-//fprintf(stderr,"%s: sp=%p ssrc=%d\n",__FUNCTION__,sp,pkt->rtp.ssrc);
-    if (sp != NULL) {
-      if (sp->ws == NULL) {
-        if (debugSSRC) fprintf(stderr, "%s: removing stale audio session ssrc=%d sp=%p\n", __FUNCTION__, sp->ssrc, (void *)sp);
-        delete_session(sp);
-        continue;
+    ingest_recv_ns = mono_ns();
+    for (int i = 0; i < nbufs; i++)
+      pbs[i]->recv_ns = ingest_recv_ns;
+    if (capture_fp != NULL)
+      for (int i = 0; i < n; i++)
+        capture_write(CAPTURE_AUDIO, segs[i].data, segs[i].len, ingest_recv_ns);
+    for (int i = 0; i < n; i++)
+      dispatch_audio_packet(pbs[segs[i].buf], (ssize_t)segs[i].len);
+    if (audio_rx_npending > 0)
+      audio_rx_expire(ingest_recv_ns);
+
+    /* Buffers are immutable once queued: take fresh ones next time */
+    for (int i = 0; i < nbufs; i++) {
+      if (atomic_load_explicit(&pbs[i]->refs, memory_order_acquire) != 1) {
+        pktbuf_put(pbs[i]);
+        pbs[i] = NULL;
       }
-      if (sp->audio_active) {
-        send_ws_binary_to_session(sp, (uint8_t *)pkt->content, size);
-      }
-      pthread_mutex_unlock(&session_mutex);
-    }  // not found
+    }
   }
 
   //fprintf(stderr,"EXIT %s\n",__FUNCTION__);
@@ -1820,15 +3790,15 @@ The `init_connections` function is responsible for initializing network connecti
 for a networked application that uses multicast communication and threading. It takes a multicast group address as
 input and performs several key steps to set up the environment.
 
-First, it prepares a buffer (`iface`) to store the name of the network interface used for multicast. It then
-initializes a mutex (`ctl_mutex`) to ensure thread-safe access to shared resources. The function calls `resolve_mcast`
+First, it prepares a buffer (`iface`) to store the name of the network interface used for multicast. The function calls `resolve_mcast`
 to resolve the multicast group address and populate the `Metadata_dest_socket` structure, also determining the appropriate
 network interface. Next, it attempts to listen for multicast status messages by calling `listen_mcast`. If this fails
 (indicated by `Status_fd == -1`), it logs an error and returns an error code.
 
 If the status socket is set up successfully, the function tries to connect to the multicast control channel using `connect_mcast`.
 If this connection fails, it logs an error and returns an error code as well. Assuming both sockets are ready,
-the function creates two threads: one for control operations (`ctrl_thread`) and one for audio processing (`audio_thread`).
+it starts the control sender thread (`control_sender_thread`), which from then on is the only writer of `Ctl_fd`,
+and creates two threads: one for control operations (`ctrl_thread`) and one for audio processing (`audio_thread`).
 For each thread, it checks if thread creation was successful; if not, it logs an error. If successful, it assigns
 a human-readable name to each thread using `pthread_setname_np` for easier debugging and monitoring.
 
@@ -1839,7 +3809,6 @@ providing a robust foundation for real-time networked operations.
 int init_connections(const char *multicast_group) {
   char iface[1024]; // Multicast interface
 
-  pthread_mutex_init(&ctl_mutex,NULL);
   time_t start = time(NULL);
 
   /* Retry resolving and listening for multicast status until successful or timeout.
@@ -1875,6 +3844,9 @@ int init_connections(const char *multicast_group) {
       perror("setsockopt SO_RCVTIMEO Status_fd");
     }
   }
+  pthread_mutex_lock(&session_mutex);
+  ssrc_filter_update();
+  pthread_mutex_unlock(&session_mutex);
 
   /* Retry connecting control socket until successful or timeout. */
   for (;;) {
@@ -1889,7 +3861,17 @@ int init_connections(const char *multicast_group) {
     sleep(2);
   }
 
-  if(pthread_create(&ctrl_task,NULL,ctrl_thread,NULL) == -1){
+  /* All commands to radiod go out through one paced sender thread */
+  if (control_sender_start() != 0)
+    return EX_OSERR;
+
+  if (replay_path != NULL) {
+    /* The replay dispatches both streams itself; see replay_thread() */
+    if (pthread_create(&ctrl_task, NULL, replay_thread, NULL) != 0)
+      perror("pthread_create: replay_thread");
+    else
+      pthread_setname_np(ctrl_task, "replay");
+  } else if(pthread_create(&ctrl_task,NULL,ctrl_thread,NULL) == -1){
     perror("pthread_create: ctrl_thread");
     //free(sp);
   } else {
@@ -1898,7 +3880,9 @@ int init_connections(const char *multicast_group) {
     pthread_setname_np(ctrl_task,buff);
   }
 
-  if(pthread_create(&audio_task,NULL,audio_thread,NULL) == -1){
+  if (replay_path != NULL) {
+    /* no live audio while replaying */
+  } else if(pthread_create(&audio_task,NULL,audio_thread,NULL) == -1){
     perror("pthread_create");
   } else {
     char buff[16];
@@ -1913,72 +3897,512 @@ int init_connections(const char *multicast_group) {
     snprintf(buff2, sizeof(buff2), "lifetime_refresh");
     pthread_setname_np(lifetime_refresh_task, buff2);
   }
-  /* monitor thread will be started on first client connect to avoid startup noise */
+  /* One thread paces the spectrum requests of all sessions */
+  if(pthread_create(&spectrum_sched_task, NULL, spectrum_scheduler_thread, NULL) == -1) {
+    perror("pthread_create: spectrum_scheduler_thread");
+  } else {
+    pthread_setname_np(spectrum_sched_task, "spectrum_sched");
+  }
+  /* monitor thread will be started on first client connect to avoid startup noise */
   return(EX_OK);
 }
 
+/*
+  Control command pipeline
+  ------------------------
+  Commands for radiod used to be sent inline by whichever thread produced
+  them, each followed by a CONTROL_USLEEP_US sleep with ctl_mutex held, so
+  websocket callbacks, the spectrum scheduler and the lifetime refresher all
+  queued up behind each other's sleeps. Now control_send() only copies the
+  encoded command into a struct ctl_cmd and pushes it onto a lock-free
+  multi-producer inbox; the caller returns immediately.
+
+  A single control_sender_thread owns Ctl_fd:
+  - It takes the whole inbox with one atomic exchange (a Treiber stack, so
+    it is reversed back into arrival order) and appends each command to the
+    FIFO of its flow. Commands for one SSRC (a session and its even/odd
+    neighbour share a flow) are sent in the order they were issued.
+  - Flows with pending commands are served round-robin, one command per
+    turn, so a client issuing a burst does not delay the others.
+  - Sends are paced by a token bucket: `control_rate` commands per second
+    (-C, default the old one-per-CONTROL_USLEEP_US pace) with bursts of up
+    to CTL_BURST, instead of sleeping after every command.
+
+  Tuning commands (frequency, filter edges, shift) are coalesced per
+  (flow, parameter): dragging the waterfall or spinning the wheel produces
+  far more values than radiod can usefully apply. A command queued with a
+  coalescing key (see ctl_finish()) is sent at once if nothing of its kind
+  went out in the last `control_coalesce_ms` (-W); otherwise it waits for
+  the end of that window, and while it waits a newer value for the same parameter
+  replaces it in place. Only the newest value is ever sent, and at most one
+  per window. A newer value is appended instead when other commands were
+  queued behind the pending one, so ordering against them is kept.
+
+  When a flow's turn comes, the command at its head is sent together with
+  every later command queued for the same SSRC that may go out now: their
+  parameter TLVs are folded into one CMD datagram, a later value replacing
+  an earlier one of the same type. A mode change and the poll behind it, or
+  a frequency and filter change issued together, cost radiod one packet to
+  parse and one status reply. Commands are built with ctl_begin() from a
+  header encoded once per channel (ctl_prefix_init()), with only the command
+  tag patched, into small CTL_CMD_MAX buffers.
+
+  Queue depth, the enqueue-to-send latency of each command, the number of
+  commands merged away and the number folded into another's datagram are
+  kept for the status page.
+*/
+#ifndef CTL_BURST
+#define CTL_BURST 8
+#endif
+#define CTL_FLOW_IDLE_MS 60000 /* forget a flow's coalescing state after this */
+#define CTL_BATCH_MAX 1024     /* largest datagram built by folding commands */
+#define CTL_BATCH_TLVS 64      /* most parameters in one folded datagram */
+
+/* Coalescing keys: commands that only set one of these parameters */
+enum ctl_key {
+  CTL_KEY_NONE,
+  CTL_KEY_FREQUENCY,
+  CTL_KEY_FILTER,
+  CTL_KEY_SHIFT,
+  CTL_NKEYS
+};
+
+struct ctl_cmd {
+  struct ctl_cmd *next;
+  uint32_t flow;
+  uint32_t ssrc;
+  enum ctl_key key;
+  unsigned long enq_ms;
+  int len;
+  uint8_t data[];
+};
+
+struct ctl_flow {
+  struct ctl_flow *next;          /* all known flows */
+  struct ctl_flow *ring_next;     /* round-robin ring of flows with work */
+  bool in_ring;
+  uint32_t flow;
+  struct ctl_cmd *head, *tail;
+  unsigned long last_sent_ms[CTL_NKEYS];
+  unsigned long last_active_ms;
+};
+
+int control_rate = 1000000 / CONTROL_USLEEP_US; /* commands per second, -C */
+int control_coalesce_ms = 30;                    /* tuning command window, -W */
+static _Atomic(struct ctl_cmd *) ctl_inbox;
+static int ctl_wake_fd = -1;
+static atomic_long ctl_depth;
+static atomic_ulong ctl_sent, ctl_errors, ctl_merged, ctl_batched, ctl_latency_sum_ms, ctl_latency_max_ms;
+
+/* Queue an encoded command for radiod, coalescing it with a pending one
+   for the same SSRC and `key` (see above). Safe from any thread; never blocks. */
+static int control_send(uint32_t ssrc, enum ctl_key key, uint8_t const *cmd, int len)
+{
+  struct ctl_cmd *c = malloc(sizeof(*c) + len);
+  if (c == NULL) {
+    perror("control_send: malloc");
+    return -1;
+  }
+  c->flow = ssrc & ~1u;
+  c->ssrc = ssrc;
+  c->key = key;
+  c->enq_ms = now_ms();
+  c->len = len;
+  memcpy(c->data, cmd, len);
+  atomic_fetch_add_explicit(&ctl_depth, 1, memory_order_relaxed);
+  struct ctl_cmd *head = atomic_load_explicit(&ctl_inbox, memory_order_relaxed);
+  do {
+    c->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&ctl_inbox, &head, c, memory_order_release, memory_order_relaxed));
+  if (head == NULL && ctl_wake_fd != -1) {
+    /* Inbox was empty: the sender may be asleep */
+    uint64_t one = 1;
+    if (write(ctl_wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+      perror("control_send: eventfd write");
+  }
+  return 0;
+}
+
+/* Encode the fixed header of every command for `ssrc` */
+static void ctl_prefix_init(uint8_t *prefix, uint32_t ssrc)
+{
+  uint8_t *bp = prefix;
+  *bp++ = CMD;
+  *bp++ = OUTPUT_SSRC;
+  *bp++ = 4;
+  for (int shift = 24; shift >= 0; shift -= 8)
+    *bp++ = (uint8_t)(ssrc >> shift);
+  *bp++ = COMMAND_TAG;
+  *bp++ = 4;
+  memset(bp, 0, 4); /* patched by ctl_begin() */
+}
+
+/* Start a command in `buf` (CTL_CMD_MAX bytes) from a channel's prefix with
+   a fresh command tag; returns where the parameters go */
+static uint8_t *ctl_begin(uint8_t *buf, uint8_t const *prefix)
+{
+  memcpy(buf, prefix, CTL_PREFIX_LEN);
+  uint32_t const tag = arc4random();
+  for (int i = 0; i < 4; i++)
+    buf[CTL_TAG_OFFSET + i] = (uint8_t)(tag >> (24 - 8 * i));
+  return buf + CTL_PREFIX_LEN;
+}
+
+/* The SSRC a command header addresses */
+static uint32_t ctl_prefix_ssrc(uint8_t const *prefix)
+{
+  return (uint32_t)prefix[3] << 24 | (uint32_t)prefix[4] << 16 | (uint32_t)prefix[5] << 8 | prefix[6];
+}
+
+/* Terminate a command started with ctl_begin() and queue it */
+static int ctl_finish(uint8_t *buf, uint8_t *bp, enum ctl_key key)
+{
+  encode_eol(&bp);
+  return control_send(ctl_prefix_ssrc(buf), key, buf, bp - buf);
+}
+
+static void control_stats(long *depth, unsigned long *sent, unsigned long *errors, unsigned long *merged,
+                          unsigned long *batched, double *avg_latency_ms, unsigned long *max_latency_ms)
+{
+  *depth = atomic_load(&ctl_depth);
+  *sent = atomic_load(&ctl_sent);
+  *errors = atomic_load(&ctl_errors);
+  *merged = atomic_load(&ctl_merged);
+  *batched = atomic_load(&ctl_batched);
+  unsigned long const commands = *sent + *batched;
+  *avg_latency_ms = commands ? (double)atomic_load(&ctl_latency_sum_ms) / commands : 0.0;
+  *max_latency_ms = atomic_load(&ctl_latency_max_ms);
+}
+
+static void *control_sender_thread(void *arg);
+
+static int control_sender_start(void)
+{
+  ctl_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (ctl_wake_fd == -1) {
+    perror("eventfd: control sender");
+    return -1;
+  }
+  if (pthread_create(&ctl_sender_task, NULL, control_sender_thread, NULL) != 0) {
+    perror("pthread_create: control_sender_thread");
+    return -1;
+  }
+  pthread_setname_np(ctl_sender_task, "ctl_sender");
+  return 0;
+}
+
+/* When command `c` of flow `f` may be sent (0 if not throttled) */
+static unsigned long ctl_cmd_due_ms(struct ctl_flow const *f, struct ctl_cmd const *c)
+{
+  if (c->key == CTL_KEY_NONE || f->last_sent_ms[c->key] == 0)
+    return 0;
+  return f->last_sent_ms[c->key] + control_coalesce_ms;
+}
+
+/* One parameter TLV of a queued command, header included */
+struct ctl_tlv {
+  uint8_t const *p;
+  int len;
+};
+
+/*
+  Fold the parameters of `c` into the datagram being assembled in `acc`
+  (`*n` TLVs, `*bytes` long once header and EOL are added). A parameter
+  already present is dropped from its old position and the new value is
+  appended, so the datagram applies values in the order they were issued.
+  Returns false, leaving `acc` untouched, if the result would not fit.
+*/
+static bool ctl_fold(struct ctl_tlv *acc, int *n, int *bytes, struct ctl_cmd const *c)
+{
+  struct ctl_tlv tlv[CTL_BATCH_TLVS];
+  int ntlv = 0, add = 0;
+  uint8_t const *cp = c->data + CTL_PREFIX_LEN;
+  uint8_t const *const end = c->data + c->len;
+
+  if (c->len < CTL_PREFIX_LEN + 1 || c->data[0] != CMD)
+    return false;
+  while (cp < end && *cp != EOL) {
+    uint8_t const *const start = cp;
+    if (end - cp < 2)
+      return false;
+    cp++;
+    unsigned int optlen = *cp++;
+    if (optlen & 0x80) {
+      int length_of_length = optlen & 0x7f;
+      optlen = 0;
+      while (length_of_length-- > 0 && cp < end) {
+        optlen <<= 8;
+        optlen |= *cp++;
+      }
+    }
+    if (optlen > (unsigned int)(end - cp) || ntlv == CTL_BATCH_TLVS)
+      return false;
+    cp += optlen;
+    tlv[ntlv].p = start;
+    tlv[ntlv].len = cp - start;
+    add += tlv[ntlv].len;
+    ntlv++;
+  }
+  if (*n + ntlv > CTL_BATCH_TLVS || *bytes + add > CTL_BATCH_MAX)
+    return false;
+  for (int i = 0; i < ntlv; i++) {
+    for (int j = 0; j < *n; j++) {
+      if (acc[j].p[0] == tlv[i].p[0]) {
+        *bytes -= acc[j].len;
+        memmove(&acc[j], &acc[j + 1], (*n - j - 1) * sizeof(*acc));
+        (*n)--;
+        break;
+      }
+    }
+    acc[(*n)++] = tlv[i];
+    *bytes += tlv[i].len;
+  }
+  return true;
+}
+
+static void *control_sender_thread(void *arg)
+{
+  (void)arg;
+  struct ctl_flow *flows = NULL;  /* every flow seen recently */
+  struct ctl_flow *ring = NULL;   /* flow served next; ring is circular */
+  struct ctl_flow *ring_prev = NULL;
+  double tokens = CTL_BURST;
+  struct timespec last;
+  clock_gettime(CLOCK_MONOTONIC, &last);
+
+  for (;;) {
+    /* Move everything that arrived into the per-flow FIFOs */
+    struct ctl_cmd *in = atomic_exchange_explicit(&ctl_inbox, NULL, memory_order_acquire);
+    struct ctl_cmd *fifo = NULL;
+    while (in != NULL) { /* reverse into arrival order */
+      struct ctl_cmd *next = in->next;
+      in->next = fifo;
+      fifo = in;
+      in = next;
+    }
+    unsigned long now_m = now_ms();
+    while (fifo != NULL) {
+      struct ctl_cmd *c = fifo;
+      fifo = c->next;
+      c->next = NULL;
+      struct ctl_flow *f;
+      for (f = flows; f != NULL; f = f->next)
+        if (f->flow == c->flow)
+          break;
+      if (f == NULL) {
+        f = calloc(1, sizeof(*f));
+        if (f == NULL) {
+          perror("control_sender: calloc");
+          atomic_fetch_sub_explicit(&ctl_depth, 1, memory_order_relaxed);
+          free(c);
+          continue;
+        }
+        f->flow = c->flow;
+        f->next = flows;
+        flows = f;
+      }
+      f->last_active_ms = now_m;
+      if (c->key != CTL_KEY_NONE && f->tail != NULL && f->tail->key == c->key && f->tail->ssrc == c->ssrc) {
+        /* Newer value for a parameter still waiting to go out: replace it
+           in place, keeping the original enqueue time for the latency stats */
+        struct ctl_cmd *old = f->tail;
+        c->enq_ms = old->enq_ms;
+        struct ctl_cmd **pp = &f->head;
+        while (*pp != old)
+          pp = &(*pp)->next;
+        *pp = c;
+        f->tail = c;
+        free(old);
+        atomic_fetch_sub_explicit(&ctl_depth, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&ctl_merged, 1, memory_order_relaxed);
+        continue;
+      }
+      if (f->tail)
+        f->tail->next = c;
+      else
+        f->head = c;
+      f->tail = c;
+      if (!f->in_ring) {
+        /* Join the ring just before the flow served next */
+        f->in_ring = true;
+        if (ring == NULL) {
+          f->ring_next = f;
+          ring = ring_prev = f;
+        } else {
+          f->ring_next = ring;
+          ring_prev->ring_next = f;
+          ring_prev = f;
+        }
+      }
+    }
+
+    /* Find the next flow, in ring order, whose head command may go out */
+    struct ctl_flow *f = NULL;
+    long wait_ms = -1; /* -1: nothing to do until woken */
+    if (ring != NULL) {
+      struct ctl_flow *p = ring_prev, *q = ring;
+      do {
+        unsigned long const due = ctl_cmd_due_ms(q, q->head);
+        if ((long)(due - now_m) <= 0) {
+          f = q;
+          ring_prev = p;
+          ring = q;
+          break;
+        }
+        if (wait_ms < 0 || (long)(due - now_m) < wait_ms)
+          wait_ms = (long)(due - now_m);
+        p = q;
+        q = q->ring_next;
+      } while (q != ring);
+    }
+
+    /* Token bucket */
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double const rate = control_rate > 0 ? control_rate : 1;
+    tokens += ((now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9) * rate;
+    if (tokens > CTL_BURST)
+      tokens = CTL_BURST;
+    last = now;
+    if (f != NULL && tokens < 1.0) {
+      wait_ms = (long)ceil((1.0 - tokens) / rate * 1000.0);
+      f = NULL;
+    }
+
+    if (f == NULL) {
+      /* Sleep until a producer finds the inbox empty, or the next command
+         (throttled or out of tokens) becomes sendable */
+      struct pollfd pfd = { .fd = ctl_wake_fd, .events = POLLIN };
+      if (poll(&pfd, 1, wait_ms < 0 ? -1 : (int)wait_ms) > 0) {
+        uint64_t v;
+        if (read(ctl_wake_fd, &v, sizeof(v)) < 0 && errno != EAGAIN && errno != EINTR)
+          perror("control_sender: eventfd read");
+      }
+      /* Forget flows that have been quiet for a long time */
+      now_m = now_ms();
+      for (struct ctl_flow **pp = &flows; *pp != NULL; ) {
+        struct ctl_flow *g = *pp;
+        if (!g->in_ring && now_m - g->last_active_ms > CTL_FLOW_IDLE_MS) {
+          *pp = g->next;
+          free(g);
+        } else {
+          pp = &g->next;
+        }
+      }
+      continue;
+    }
+
+    /* Serve the head command of this flow, folding in the later commands
+       for the same SSRC that may go out now */
+    struct ctl_cmd *c = f->head;
+    f->head = c->next;
+    c->next = NULL;
+    struct ctl_cmd **batch_tail = &c->next;
+    int nbatch = 1;
+    struct ctl_tlv acc[CTL_BATCH_TLVS];
+    int nacc = 0, bytes = CTL_PREFIX_LEN + 1;
+    if (ctl_fold(acc, &nacc, &bytes, c)) {
+      for (struct ctl_cmd **pp = &f->head; *pp != NULL; ) {
+        struct ctl_cmd *d = *pp;
+        if (d->ssrc != c->ssrc) {
+          pp = &d->next;
+          continue;
+        }
+        /* Stop at a throttled command so values stay in issue order */
+        if ((long)(ctl_cmd_due_ms(f, d) - now_m) > 0 || !ctl_fold(acc, &nacc, &bytes, d))
+          break;
+        *pp = d->next;
+        d->next = NULL;
+        *batch_tail = d;
+        batch_tail = &d->next;
+        nbatch++;
+      }
+    }
+    f->tail = NULL;
+    for (struct ctl_cmd *d = f->head; d != NULL; d = d->next)
+      f->tail = d;
+
+    uint8_t const *pkt = c->data;
+    int len = c->len;
+    if (nbatch > 1) {
+      static uint8_t batch[CTL_BATCH_MAX];
+      uint8_t *bp = batch;
+      memcpy(bp, c->data, CTL_PREFIX_LEN);
+      bp += CTL_PREFIX_LEN;
+      for (int i = 0; i < nacc; i++) {
+        memcpy(bp, acc[i].p, acc[i].len);
+        bp += acc[i].len;
+      }
+      encode_eol(&bp);
+      pkt = batch;
+      len = bp - batch;
+    }
+    if (send(Ctl_fd, pkt, len, 0) != len) {
+      perror("command send");
+      atomic_fetch_add_explicit(&ctl_errors, 1, memory_order_relaxed);
+    }
+    tokens -= 1.0;
+    now_m = now_ms();
+    f->last_active_ms = now_m;
+    atomic_fetch_add_explicit(&ctl_sent, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ctl_batched, nbatch - 1, memory_order_relaxed);
+    while (c != NULL) {
+      struct ctl_cmd *next = c->next;
+      if (c->key != CTL_KEY_NONE)
+        f->last_sent_ms[c->key] = now_m;
+      unsigned long const latency = now_m - c->enq_ms;
+      atomic_fetch_add_explicit(&ctl_latency_sum_ms, latency, memory_order_relaxed);
+      if (latency > atomic_load_explicit(&ctl_latency_max_ms, memory_order_relaxed))
+        atomic_store_explicit(&ctl_latency_max_ms, latency, memory_order_relaxed);
+      atomic_fetch_sub_explicit(&ctl_depth, 1, memory_order_relaxed);
+      free(c);
+      c = next;
+    }
+
+    /* Advance the ring, dropping the flow from it if it ran dry */
+    if (f->head == NULL) {
+      f->in_ring = false;
+      if (f->ring_next == f) {
+        ring = ring_prev = NULL;
+      } else {
+        ring_prev->ring_next = f->ring_next;
+        ring = f->ring_next;
+      }
+    } else {
+      ring_prev = f;
+      ring = f->ring_next;
+    }
+  }
+  return NULL;
+}
+
 /*
 The `init_control` function is responsible for initializing control communication for a session in a networked
 application, likely related to radio or audio streaming. It takes a pointer to a `session` structure as its
-argument. The function prepares and sends two command packets over a control socket, each packet configuring a
-specific SSRC (Synchronization Source identifier) for the session.
+argument. The function prepares and sends a command packet that creates the channel for the session's SSRC
+(Synchronization Source identifier).
 
-First, the function creates a command buffer and a pointer (`bp`) to build the command message. It writes a
-command identifier, encodes a frequency value, the session's SSRC, a randomly generated command tag, and a
-preset string ("am") into the buffer. It then finalizes the command with an end-of-line marker and calculates
-the total length of the command. The function locks a mutex (`ctl_mutex`) to ensure thread-safe access to the
-control socket (`Ctl_fd`) and sends the command. If the send operation fails, it logs an error message. The
-mutex is then unlocked.
+First, the function starts the command from the session's precompiled header with `ctl_begin()`, which carries
+the session's SSRC and a fresh command tag. It then encodes a lifetime, a frequency value and a preset string
+("am"), and `ctl_finish()` terminates the command and queues it for the control sender thread.
+The session's spectrum channel is not created here; it belongs to a spectrum view, created on demand.
 
-The process is repeated for a second command, this time incrementing the SSRC by one and omitting the preset string.
-Again, the command is sent over the control socket with proper mutex protection.
-
-After sending both commands, the function initializes the demodulator for the channel by calling `init_demod(&Channel)`.
+After queueing the command, the function initializes the demodulator for the channel by calling `init_demod(&Channel)`.
 It also resets the frontend frequency and intermediate frequency (IF) values to "not a number" (`NAN`), indicating
 that these values are not currently set. Finally, the function returns a success code (`EX_OK`). This setup ensures
 that the session is properly configured and ready for further control operations.
 */
 int init_control(struct session *sp) {
-  uint32_t sent_tag = 0;
-
 //fprintf(stderr,"%s: Ssrc=%d\n",__FUNCTION__,sp->ssrc);
   // send a frequency to start with
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
-  *bp++ = CMD; // Command
-  encode_int(&bp,OUTPUT_SSRC,sp->ssrc); // Specific SSRC
+  uint8_t cmdbuffer[CTL_CMD_MAX];
+  uint8_t *bp = ctl_begin(cmdbuffer, sp->ctl_prefix);
   encode_int(&bp,LIFETIME,DEFAULT_CHANNEL_LIFETIME); /* seconds until channel expires */
   encode_double(&bp,RADIO_FREQUENCY,10000000);
-  sent_tag = arc4random();
-  encode_int(&bp,COMMAND_TAG,sent_tag); // Append a command tag
   encode_string(&bp,PRESET,"am",strlen("am"));
-  encode_eol(&bp);
-  int command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if(send(Ctl_fd, cmdbuffer, command_len, 0) != command_len){
-    fprintf(stderr,"command send error: %s\n",strerror(errno));
-  } else {
-    usleep(CONTROL_USLEEP_US);
-  }
-  pthread_mutex_unlock(&ctl_mutex);
-
-  bp = cmdbuffer;
-  *bp++ = CMD; // Command
-
-  encode_int(&bp,OUTPUT_SSRC,sp->ssrc+1); // Specific SSRC
-  encode_int(&bp,LIFETIME,DEFAULT_CHANNEL_LIFETIME); /* seconds until channel expires */
-  encode_double(&bp,RADIO_FREQUENCY,10000000);
-  sent_tag = arc4random();
-  encode_int(&bp,COMMAND_TAG,sent_tag); // Append a command tag
-  encode_eol(&bp);
-  command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if(send(Ctl_fd, cmdbuffer, command_len, 0) != command_len){
-    fprintf(stderr,"command send error: %s\n",strerror(errno));
-  } else {
-    usleep(CONTROL_USLEEP_US);
-  }
-  pthread_mutex_unlock(&ctl_mutex);
+  ctl_finish(cmdbuffer, bp, CTL_KEY_NONE);
+  /* The spectrum channel is created on demand by the session's spectrum
+     view (see spectrum_view_poll()), and may be shared with other sessions */
 
   init_demod(&Channel);
 
@@ -2004,40 +4428,28 @@ command tag into the buffer using `encode_int`. It finalizes the command with an
 `encode_eol`. The total length of the command is calculated as the difference between the current buffer
 pointer and the start of the buffer.
 
-To ensure thread safety, the function locks the `ctl_mutex` mutex before sending the command over the control
-socket (`Ctl_fd`). If the `send` operation fails to transmit the entire command, an error message is printed.
-Finally, the mutex is unlocked, allowing other threads to access the control socket.
+The command is queued with `ctl_finish()` and the function returns at once; the control sender thread
+sends it over the control socket (`Ctl_fd`) and reports any send error. While a tuning burst is being throttled,
+only the newest frequency is kept.
 
 Overall, this function safely constructs and sends a frequency-setting command for a session, handling
 string parsing, buffer management, and thread synchronization.
 */
 void control_set_frequency(struct session *sp,char *str) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
+  uint8_t cmdbuffer[CTL_CMD_MAX];
   double f;
 
   if(strlen(str) > 0){
-    *bp++ = CMD; // Command
+    uint8_t *bp = ctl_begin(cmdbuffer, sp->ctl_prefix);
     f = fabs(strtod(str,0) * 1000.0);    // convert from kHz to Hz
     /* Round to nearest Hz when storing in integer session field */
     sp->frequency = (uint32_t)lround(f);
-    encode_int(&bp,OUTPUT_SSRC,sp->ssrc); // Specific SSRC
     encode_int(&bp,LIFETIME,DEFAULT_CHANNEL_LIFETIME); /* refresh lifetime (seconds) */
-    encode_int(&bp,COMMAND_TAG,arc4random()); // Append a command tag
     encode_double(&bp,RADIO_FREQUENCY,f);
-    encode_eol(&bp);
-    int const command_len = bp - cmdbuffer;
-    pthread_mutex_lock(&ctl_mutex);
-    if(send(Ctl_fd, cmdbuffer, command_len, 0) != command_len){
-      fprintf(stderr,"command send error: %s\n",strerror(errno));
-    } else {
+    if (ctl_finish(cmdbuffer, bp, CTL_KEY_FREQUENCY) == 0) {
       unsigned long elapsed_ms = poll_start_ms ? (now_ms() - poll_start_ms) : 0UL;
       if (verbose && debug_send) fprintf(stderr, "%s: +%lums: sending RADIO_FREQUENCY=%.0f Hz for ssrc=%u\n", __FUNCTION__, elapsed_ms, f, (unsigned)sp->ssrc);
-      /* allow backend a short time to process this command before sending another */
-      usleep(CONTROL_USLEEP_US/2);
-      //if (verbose && debug_send) fprintf(stderr, "%s: +%lums: send OK\n", __FUNCTION__, elapsed_ms);
     }
-    pthread_mutex_unlock(&ctl_mutex);
   }
 }
 
@@ -2048,31 +4460,20 @@ void control_set_frequency(struct session *sp,char *str) {
 
   - `str` is parsed as a floating-point shift in Hz.
   - Command format mirrors other control setters: `{ CMD, OUTPUT_SSRC, COMMAND_TAG, SHIFT_FREQUENCY, EOL }`.
-  - Uses `ctl_mutex` to protect `Ctl_fd` and sleeps `CONTROL_USLEEP_US` after a successful send.
+  - Queued with a coalescing key, so a burst of shifts collapses to the newest value.
   - Note: the session's `sp->shift` is updated by incoming status packets; this function
     does not modify `sp->shift` so the backend remains the authoritative source.
 */
 void control_set_shift(struct session *sp,char *str) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
+  uint8_t cmdbuffer[CTL_CMD_MAX];
   double s;
 
   if(strlen(str) > 0){
-    *bp++ = CMD; // Command
+    uint8_t *bp = ctl_begin(cmdbuffer, sp->ctl_prefix);
     s = strtod(str, NULL); // shift in Hz
-    encode_int(&bp,OUTPUT_SSRC,sp->ssrc); // Specific SSRC
     encode_int(&bp,LIFETIME,DEFAULT_CHANNEL_LIFETIME); /* refresh lifetime (seconds) */
-    encode_int(&bp,COMMAND_TAG,arc4random()); // Append a command tag
     encode_double(&bp,SHIFT_FREQUENCY,s);
-    encode_eol(&bp);
-    int const command_len = bp - cmdbuffer;
-    pthread_mutex_lock(&ctl_mutex);
-    if(send(Ctl_fd, cmdbuffer, command_len, 0) != command_len){
-      fprintf(stderr,"command send error: %s\n",strerror(errno));
-    } else {
-      usleep(CONTROL_USLEEP_US);
-    }
-    pthread_mutex_unlock(&ctl_mutex);
+    ctl_finish(cmdbuffer, bp, CTL_KEY_SHIFT);
   }
 }
 
@@ -2080,8 +4481,7 @@ void control_set_shift(struct session *sp,char *str) {
    low_str and high_str are strings containing values in Hz (or kHz?) - follow same units as client.
 */
 void control_set_filter_edges(struct session *sp, char *low_str, char *high_str) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
+  uint8_t cmdbuffer[CTL_CMD_MAX];
   float lowf = 0.0f;
   float highf = 0.0f;
 
@@ -2090,106 +4490,64 @@ void control_set_filter_edges(struct session *sp, char *low_str, char *high_str)
   if (high_str && strlen(high_str) > 0)
     highf = strtof(high_str, NULL);
 
-  *bp++ = CMD; // Command
-  encode_int(&bp, OUTPUT_SSRC, sp->ssrc);
+  uint8_t *bp = ctl_begin(cmdbuffer, sp->ctl_prefix);
   encode_int(&bp, LIFETIME, DEFAULT_CHANNEL_LIFETIME); /* refresh lifetime (seconds) */
-  encode_int(&bp, COMMAND_TAG, arc4random());
   /* Encode LOW_EDGE then HIGH_EDGE as floats */
   encode_float(&bp, LOW_EDGE, lowf);
   encode_float(&bp, HIGH_EDGE, highf);
-  encode_eol(&bp);
 
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
   if (verbose && debug_send) {
     unsigned long elapsed_ms = poll_start_ms ? (now_ms() - poll_start_ms) : 0UL;
     fprintf(stderr, "%s: +%lums: sending filter edges low=%f high=%f\n", __FUNCTION__, elapsed_ms, lowf, highf);
   }
-    if (send(Ctl_fd, cmdbuffer, command_len, 0) != command_len) {
-    fprintf(stderr, "%s: command send error: %s\n", __FUNCTION__, strerror(errno));
-  } else {
-    //if (verbose) fprintf(stderr, "%s: send OK\n", __FUNCTION__);
-    usleep(CONTROL_USLEEP_US);
-  }
-  pthread_mutex_unlock(&ctl_mutex);
+  ctl_finish(cmdbuffer, bp, CTL_KEY_FILTER);
 }
 
-/* Send spectrum averaging value (integer) to control socket for this session */
+/* Spectrum processing parameters (averaging, overlap, window) belong to the
+   backend spectrum channel, which may be shared with other sessions, so the
+   setters below only record what this session asks for. The session moves
+   to the matching spectrum view at its next poll, and the parameters are
+   sent once, with the first spectrum request on that view's new channel
+   (control_get_powers_with_demod()).
+   With sp == NULL they set the default for new sessions. */
+
+/* Record the spectrum averaging value (integer) for this session */
 void control_set_spectrum_average(struct session *sp, char *val_str) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
   int val = 0;
 
   if (val_str && strlen(val_str) > 0)
     val = atoi(val_str);
-  if (val_str && strlen(val_str) > 0)
-    val = atoi(val_str);
-
-  int target_ssrc = sp ? (sp->ssrc + 1) : 0; /* use ssrc+1 for spectrum stream */
-  /* fprintf(stderr, "%s: control_set_spectrum_average called sp=%p ssrc=%d target_ssrc=%d val=%d\n", __FUNCTION__, sp, sp?sp->ssrc:0, target_ssrc, val); */
-  /* fflush(stderr); */
-
-  *bp++ = CMD; // Command
-  /* Include SSRC for which this setting applies - target the spectrum stream (ssrc+1) */
-  /* Use fixed 32-bit encodings to keep command packet length deterministic */
-  encode_int32(&bp, OUTPUT_SSRC, (uint32_t)target_ssrc);
-  encode_int32(&bp, LIFETIME, (uint32_t)DEFAULT_CHANNEL_LIFETIME);
-  encode_int32(&bp, COMMAND_TAG, (uint32_t)arc4random());
-  /* Encode spectrum average as integer SPECTRUM_AVG */
-  encode_int(&bp, SPECTRUM_AVG, val);
-  encode_eol(&bp);
 
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if (send(Ctl_fd, cmdbuffer, command_len, 0) != command_len) {
-    fprintf(stderr, "command send error: %s\n", strerror(errno));
-  } else {
-    /* fprintf(stderr, "%s: sent SPECTRUM_AVG=%d (len=%d) to control fd=%d\n", __FUNCTION__, val, command_len, Ctl_fd); */
-    /* fflush(stderr); */
-    usleep(CONTROL_USLEEP_US);
+  if (sp == NULL) {
+    spectrum_default_avg = val;
+    return;
   }
-  pthread_mutex_unlock(&ctl_mutex);
+  pthread_mutex_lock(&sp->spectrum_mutex);
+  sp->spectrum_avg = val;
+  pthread_mutex_unlock(&sp->spectrum_mutex);
 }
 
-/* Send spectrum FFT overlap (float 0 <= x < 1) to control socket for this session */
+/* Record the spectrum FFT overlap (float 0 <= x < 1) for this session */
 void control_set_spectrum_overlap(struct session *sp, char *val_str) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
   float val = 0.0f;
 
   if (val_str && strlen(val_str) > 0)
     val = strtof(val_str, NULL);
 
-  int target_ssrc = sp ? (sp->ssrc + 1) : 0; /* use ssrc+1 for spectrum stream */
-
-  *bp++ = CMD; // Command
-  /* Include SSRC for which this setting applies - target the spectrum stream (ssrc+1) */
-  encode_int(&bp, OUTPUT_SSRC, target_ssrc);
-  encode_int(&bp, LIFETIME, DEFAULT_CHANNEL_LIFETIME);
-  encode_int(&bp, COMMAND_TAG, arc4random());
-  /* Encode spectrum overlap as float SPECTRUM_OVERLAP */
-  encode_float(&bp, SPECTRUM_OVERLAP, val);
-  encode_eol(&bp);
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if (verbose && debug_send) {
-    unsigned long elapsed_ms = poll_start_ms ? (now_ms() - poll_start_ms) : 0UL;
-    fprintf(stderr, "%s: +%lums: sending SPECTRUM_OVERLAP=%f\n", __FUNCTION__, elapsed_ms, (double)val);
-  }
-  if (send(Ctl_fd, cmdbuffer, command_len, 0) != command_len) {
-    fprintf(stderr, "%s: command send error: %s\n", __FUNCTION__, strerror(errno));
-  } else {
-    //if (verbose) fprintf(stderr, "%s: send OK\n", __FUNCTION__);
-    usleep(CONTROL_USLEEP_US);
+  if (verbose && debug_send)
+    fprintf(stderr, "%s: ssrc=%u SPECTRUM_OVERLAP=%f\n", __FUNCTION__, sp ? sp->ssrc : 0, (double)val);
+  if (sp == NULL) {
+    spectrum_default_overlap = val;
+    return;
   }
-  pthread_mutex_unlock(&ctl_mutex);
+  pthread_mutex_lock(&sp->spectrum_mutex);
+  sp->spectrum_overlap = val;
+  pthread_mutex_unlock(&sp->spectrum_mutex);
 }
 
-/* Send window type (UINT) to control socket for this session and save spectrum shape locally
+/* Record the window type (UINT) and spectrum shape for this session
    type_str expected to be names like "KAISER_WINDOW", "GAUSSIAN_WINDOW", etc. */
 void control_set_window_type(struct session *sp, char *type_str, char *shape_str) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
   int val = 0; /* default to KAISER_WINDOW */
 
   if (type_str && strlen(type_str) > 0) {
@@ -2204,27 +4562,16 @@ void control_set_window_type(struct session *sp, char *type_str, char *shape_str
     else if (strcmp(type_str, "HP5FT_WINDOW") == 0) val = 8;
     else val = 0;
   }
-  int target_ssrc = sp ? (sp->ssrc + 1) : 0; /* target spectrum stream (ssrc+1) */
-  *bp++ = CMD; // Command
-  /* Include SSRC for which this setting applies - target the spectrum stream (ssrc+1) */
-  encode_int(&bp, OUTPUT_SSRC, target_ssrc);
-  encode_int(&bp, LIFETIME, DEFAULT_CHANNEL_LIFETIME);
-  encode_int(&bp, COMMAND_TAG, arc4random());
-  /* Encode window type as integer using tag WINDOW_TYPE (status.h) */
-  encode_int(&bp, WINDOW_TYPE, val);
-  if (sp && shape_str){
-    double shape = strtod(shape_str,NULL);
-    encode_float(&bp,SPECTRUM_SHAPE,shape);
-  }
-  encode_eol(&bp);
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if (send(Ctl_fd, cmdbuffer, command_len, 0) != command_len) {
-    fprintf(stderr, "command send error: %s\n", strerror(errno));
-  } else {
-    usleep(CONTROL_USLEEP_US);
+  float const shape = shape_str ? (float)strtod(shape_str, NULL) : NAN;
+  if (sp == NULL) {
+    spectrum_default_window = val;
+    spectrum_default_shape = shape;
+    return;
   }
-  pthread_mutex_unlock(&ctl_mutex);
+  pthread_mutex_lock(&sp->spectrum_mutex);
+  sp->spectrum_window = val;
+  sp->spectrum_shape = shape;
+  pthread_mutex_unlock(&sp->spectrum_mutex);
 }
 
 /*
@@ -2239,35 +4586,25 @@ associating it with the `PRESET` field. It also encodes the session's SSRC (Sync
 and a randomly generated command tag into the buffer using `encode_int`. The command is finalized with an
 end-of-line marker via `encode_eol`, and the total length of the command is calculated.
 
-To ensure thread safety, the function locks the `ctl_mutex` mutex before sending the command over the control socket
-(`Ctl_fd`). It also copies the requested preset string into the session's `requested_preset` field for tracking
-purposes. If the `send` operation fails to transmit the entire command, an error message is printed.
-Finally, the mutex is unlocked, allowing other threads to access the control socket.
+The function copies the requested preset string into the session's `requested_preset` field for tracking
+purposes and queues the command with `control_send()` for the control sender thread, which owns the control
+socket (`Ctl_fd`) and reports any send error.
 This approach ensures that mode changes are communicated reliably and safely in a concurrent environment.
 */
 void control_set_mode(struct session *sp,char *str) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
+  uint8_t cmdbuffer[CTL_CMD_MAX];
 
   if(strlen(str) > 0) {
-    *bp++ = CMD; // Command
-    encode_int(&bp,OUTPUT_SSRC,sp->ssrc); // Specific SSRC
+    uint8_t *bp = ctl_begin(cmdbuffer, sp->ctl_prefix);
+    /* Preset names are short; send no more than we track */
+    size_t const len = strnlen(str, sizeof(sp->requested_preset) - 1);
     encode_int(&bp,LIFETIME,DEFAULT_CHANNEL_LIFETIME); /* refresh lifetime (seconds) */
-    encode_int(&bp,COMMAND_TAG,arc4random()); // Append a command tag
-    encode_string(&bp,PRESET,str,strlen(str));
-    encode_eol(&bp);
-    int const command_len = bp - cmdbuffer;
-    pthread_mutex_lock(&ctl_mutex);
+    encode_string(&bp,PRESET,str,len);
     strlcpy(sp->requested_preset,str,sizeof(sp->requested_preset));
-    if(send(Ctl_fd, cmdbuffer, command_len, 0) != command_len){
-      fprintf(stderr,"command send error: %s\n",strerror(errno));
-    } else {
+    if (ctl_finish(cmdbuffer, bp, CTL_KEY_NONE) == 0) {
       unsigned long elapsed_ms = poll_start_ms ? (now_ms() - poll_start_ms) : 0UL;
       if (verbose && debug_send) fprintf(stderr, "%s: +%lums: sending PRESET='%s' for ssrc=%u\n", __FUNCTION__, elapsed_ms, str, (unsigned)sp->ssrc);
-      usleep(CONTROL_USLEEP_US);
-      //if (verbose && debug_send) fprintf(stderr, "%s: +%lums: send OK\n", __FUNCTION__, elapsed_ms);
     }
-    pthread_mutex_unlock(&ctl_mutex);
   }
 }
 
@@ -2280,125 +4617,85 @@ pointer (`bp`) to build the command message. The first byte of the buffer is set
 the type of command.
 
 Next, the function encodes several pieces of information into the buffer: the SSRC (Synchronization Source identifier)
-for the spectrum stream (using `sp->ssrc + 1`), a randomly generated command tag, the demodulator type (set to `SPECT_DEMOD`
+of the spectrum view's channel, a randomly generated command tag, the demodulator type (set to `SPECT2_DEMOD`
 to specify a spectrum demodulator), and a frequency value of 0 Hz (which is used as a signal to stop the stream).
 The command is finalized with an end-of-line marker, and the total length of the command is calculated.
 
-To ensure the command is reliably received, the function sends the command three times in a loop, with a
-short delay (`usleep(100000)`, or 100 milliseconds) between each attempt. Before each send, it locks a
-mutex (`ctl_mutex`) to ensure thread-safe access to the control socket (`Ctl_fd`). If the send operation fails,
-it prints an error message. If the `verbose` flag is set, the function also logs a message to standard error each
-time it sends the command, including the tag and SSRC used. After sending, it unlocks the mutex.
-
-This approach ensures that the command to stop the spectrum stream is sent reliably, even in the presence of
-potential packet loss or network issues. The use of mutex locking ensures that multiple threads do not interfere
-with each other when accessing the control socket. The function is robust and suitable for use in a concurrent,
-networked environment.
+The command is queued with `control_send()`, so the caller (possibly holding `session_mutex`) never waits on the
+control socket (`Ctl_fd`); the control sender thread sends it in turn with other commands.
 */
 void control_set_encoding(struct session *sp, bool use_opus) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
-  *bp++ = CMD;
-  encode_int(&bp, OUTPUT_SSRC, sp->ssrc);
+  uint8_t cmdbuffer[CTL_CMD_MAX];
+  uint8_t *bp = ctl_begin(cmdbuffer, sp->ctl_prefix);
   encode_int(&bp, LIFETIME, DEFAULT_CHANNEL_LIFETIME);
-  encode_int(&bp, COMMAND_TAG, arc4random());
   encode_int(&bp, OUTPUT_ENCODING, use_opus ? OPUS : S16BE);
-  encode_eol(&bp);
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if(send(Ctl_fd, cmdbuffer, command_len, 0) != command_len) {
-    fprintf(stderr, "command send error: %s\n", strerror(errno));
-  } else {
-    if (verbose)
-      fprintf(stderr, "%s: set encoding to %s for ssrc=%u\n", __FUNCTION__,
-              use_opus ? "OPUS" : "PCM", (unsigned)sp->ssrc);
-    usleep(CONTROL_USLEEP_US);
-  }
-  pthread_mutex_unlock(&ctl_mutex);
+  if (ctl_finish(cmdbuffer, bp, CTL_KEY_NONE) == 0 && verbose)
+    fprintf(stderr, "%s: set encoding to %s for ssrc=%u\n", __FUNCTION__,
+            use_opus ? "OPUS" : "PCM", (unsigned)sp->ssrc);
 }
 
+/* The session no longer wants spectrum: leave its spectrum view. The backend
+   channel is stopped when its last subscriber leaves. */
 void stop_spectrum_stream(struct session *sp) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
-  *bp++ = CMD;
-  encode_int(&bp,OUTPUT_SSRC,sp->ssrc+1);
+  spectrum_view_leave(sp);
+}
+
+void control_stop_spectrum(uint8_t const *prefix,int bins,float bin_bw) {
+  uint8_t cmdbuffer[CTL_CMD_MAX];
+  uint8_t *bp = ctl_begin(cmdbuffer, prefix);
   encode_int(&bp,LIFETIME,DEFAULT_CHANNEL_LIFETIME);
-  uint32_t tag = random();
-  encode_int(&bp,COMMAND_TAG,tag);
   encode_int(&bp,DEMOD_TYPE,SPECT2_DEMOD);
-  encode_int(&bp,BIN_COUNT,sp->bins);
-  encode_float(&bp,RESOLUTION_BW,(float)sp->bin_width);
+  encode_int(&bp,BIN_COUNT,bins);
+  encode_float(&bp,RESOLUTION_BW,bin_bw);
   encode_double(&bp,RADIO_FREQUENCY,0);
-  encode_eol(&bp);
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if(send(Ctl_fd,cmdbuffer,command_len,0) != command_len)
-    perror("command send: Spectrum stop");
-  pthread_mutex_unlock(&ctl_mutex);
+  ctl_finish(cmdbuffer, bp, CTL_KEY_NONE);
 }
 
 /*
-The `control_get_powers` function is responsible for sending a command to request spectral power data from a
-remote system, likely in the context of a radio or signal processing application. It takes as arguments a pointer
-to a `session` structure (`sp`), a frequency value (`frequency`), the number of bins (`bins`), and the bandwidth
-per bin (`bin_bw`). These parameters define the spectral region and resolution for which power data is being requested.
+The `control_get_powers_with_demod` function is responsible for sending a command to request spectral power data from a
+remote system, likely in the context of a radio or signal processing application. It takes as arguments the SSRC of
+the backend spectrum channel (`ssrc`, a spectrum view's channel, see spectrum_view_poll()), a frequency value
+(`frequency`), the number of bins (`bins`), the bandwidth per bin (`bin_bw`) and the demodulator type. These parameters
+define the spectral region and resolution for which power data is being requested.
 
 Inside the function, a command buffer (`cmdbuffer`) is prepared to hold the serialized command. The buffer pointer (`bp`)
 is used to sequentially encode each part of the command. The command starts with a command identifier (`CMD`), followed
-by the output SSRC (Synchronization Source identifier) for the session, which is incremented by one to target the correct
-stream. A random tag is generated to uniquely identify this command transaction, aiding in matching responses to requests.
+by the output SSRC (Synchronization Source identifier) of the spectrum channel.
+A random tag is generated to uniquely identify this command transaction, aiding in matching responses to requests.
 
 The function then encodes several parameters into the buffer: the demodulator type (set to `SPECT_DEMOD` to indicate a
 spectrum analysis request), the center frequency, the number of bins, and the bandwidth per bin. Each of these values is
 encoded using helper functions like `encode_int`, `encode_double`, and `encode_float`, which serialize the data into the
 buffer in the required format. The command is finalized with an end-of-line marker using `encode_eol`.
 
-Once the command is fully constructed, its length is calculated, and the function locks a mutex (`ctl_mutex`) to ensure
-thread-safe access to the control socket (`Ctl_fd`). The command is then sent over the socket using the `send` function.
-If the send operation does not transmit the expected number of bytes, an error message is printed. Finally, the mutex is
-unlocked, allowing other threads to use the control socket. This approach ensures that spectral power requests are sent
-safely and reliably in a concurrent, networked environment.
+Once the command is fully constructed, its length is calculated and it is handed to `control_send()`, which queues it
+for the control sender thread and returns immediately; that thread owns the control socket (`Ctl_fd`), paces the sends
+and reports send errors. This approach ensures that spectral power requests are sent safely and reliably in a
+concurrent, networked environment without blocking the caller.
 */
-void control_get_powers(struct session *sp,float frequency,int bins,float bin_bw) {
-  /* Avoid sending a spectrum request with frequency == 0. A 0 Hz tune
-     is interpreted by the backend as a command to close the spectrum
-     demod thread; that can race with startup and leave the spectrum
-     channel permanently closed. If `frequency` is zero, prefer the
-     session's `center_frequency` when available; otherwise skip.
-  */
-  if (frequency <= 0.0) {
-    if (sp && sp->center_frequency != 0) {
-      frequency = (double)sp->center_frequency;
-      if (verbose) fprintf(stderr, "control_get_powers: adjusted zero freq -> center_frequency=%u for ssrc=%u\n", sp->center_frequency, sp->ssrc+1);
-    } else {
-      if (verbose) fprintf(stderr, "control_get_powers: skipping zero-frequency spectrum request for ssrc=%u\n", sp ? sp->ssrc+1 : 0);
-      return;
-    }
-  }
-  control_get_powers_with_demod(sp,frequency,bins,bin_bw,SPECT2_DEMOD);
-}
-
-void control_get_powers_with_demod(struct session *sp,float frequency,int bins,float bin_bw,int demod_type){
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
-  *bp++ = CMD; // Command
-  encode_int(&bp,OUTPUT_SSRC,sp->ssrc+1);
+static void control_get_powers_with_demod(uint8_t const *prefix, struct spectrum_view_key const *key, int demod_type,
+                                          bool with_params){
+  uint8_t cmdbuffer[CTL_CMD_MAX];
+  uint8_t *bp = ctl_begin(cmdbuffer, prefix);
   encode_int(&bp,LIFETIME,DEFAULT_CHANNEL_LIFETIME); /* keep spectrum channel alive */
-  uint32_t tag = random();
-  encode_int(&bp,COMMAND_TAG,tag);
   encode_int(&bp,DEMOD_TYPE,demod_type);
-  encode_double(&bp,RADIO_FREQUENCY,frequency);
-  encode_int(&bp,BIN_COUNT,bins);
-  encode_float(&bp,RESOLUTION_BW,bin_bw);
-  encode_eol(&bp);
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if(send(Ctl_fd, cmdbuffer, command_len, 0) != command_len) {
-    perror("command send: Spectrum");
-  } else {
-    usleep(CONTROL_USLEEP_US);
+  encode_double(&bp,RADIO_FREQUENCY,(float)key->center);
+  encode_int(&bp,BIN_COUNT,key->bins);
+  encode_float(&bp,RESOLUTION_BW,(float)key->bin_width);
+  if (with_params) {
+    /* Processing parameters of a new view; backend defaults are not sent */
+    if (key->averaging >= 0)
+      encode_int(&bp, SPECTRUM_AVG, key->averaging);
+    if (!isnan(key->overlap))
+      encode_float(&bp, SPECTRUM_OVERLAP, key->overlap);
+    /* Encode window type as integer using tag WINDOW_TYPE (status.h) */
+    if (key->window >= 0) {
+      encode_int(&bp, WINDOW_TYPE, key->window);
+      if (!isnan(key->shape))
+        encode_float(&bp, SPECTRUM_SHAPE, key->shape);
+    }
   }
-  pthread_mutex_unlock(&ctl_mutex);
+  ctl_finish(cmdbuffer, bp, CTL_KEY_NONE);
 }
 
 /*
@@ -2407,35 +4704,22 @@ networked application that manages sessions (such as a radio or streaming server
 to a `session` structure as its argument, which contains information about the current session, including its
 SSRC (Synchronization Source identifier).
 
-Inside the function, a buffer (`cmdbuffer`) is allocated to hold the command data. A pointer (`bp`) is used to
-build the command sequentially. The first byte of the buffer is set to `1`, which likely represents the command
-type for polling. The function then encodes a random command tag using `encode_int`, which helps uniquely identify
-this poll request and match it with any response. The session's SSRC is also encoded, allowing the poll to target
-a specific session or, if set to zero, to request a list of available SSRCs. The command is finalized with an
-end-of-line marker using `encode_eol`.
-
-After constructing the command, the function calculates its length and locks a mutex (`ctl_mutex`) to ensure
-thread-safe access to the control socket (`Ctl_fd`). It then sends the command using the `send` function.
-If the number of bytes sent does not match the expected command length, an error message is printed using `perror`.
-Finally, the mutex is unlocked, allowing other threads to use the control socket. This approach ensures that polling
-commands are sent safely and reliably in a concurrent, networked environment.
+A poll is a command with no parameters: just the session's precompiled header (`ctl_begin()`), which holds the
+`CMD` type byte, the session's SSRC and a fresh command tag that helps match the poll with its response. With
+an SSRC of zero it requests the list of available SSRCs instead. radiod answers every command with a status
+packet, so a poll queued behind another command for the same SSRC is folded into that command's datagram by the
+control sender thread.
+
+The poll is queued with `ctl_finish()`; the control sender thread sends it on the control socket (`Ctl_fd`) in
+turn with other sessions' commands.
 */
-static void control_poll_ssrc(uint32_t ssrc) {
+static void control_poll_prefix(uint8_t const *prefix) {
   static int poll_count = 0;
-  uint8_t cmdbuffer[128];
-  uint8_t *bp = cmdbuffer;
-  *bp++ = 1; // Command
-
-  /* sp->last_poll_tag = random(); */
-  encode_int(&bp,OUTPUT_SSRC,ssrc); // poll specific SSRC, or request ssrc list with ssrc = 0
-  encode_int(&bp,COMMAND_TAG,random());
-  /* encode_int(&bp,COMMAND_TAG,sp->last_poll_tag); */
-  encode_eol(&bp);
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if(send(Ctl_fd, cmdbuffer, command_len, 0) != command_len) {
-    perror("command send: Poll");
-  } else {
+  uint8_t cmdbuffer[CTL_PREFIX_LEN + 1];
+  /* A poll is a command with no parameters: OUTPUT_SSRC selects the
+     channel, or requests the ssrc list with ssrc = 0 */
+  uint8_t *bp = ctl_begin(cmdbuffer, prefix);
+  if (ctl_finish(cmdbuffer, bp, CTL_KEY_NONE) == 0) {
     if (++poll_count >= 100) {
       poll_count = 0;
       poll_start_ms = now_ms();
@@ -2444,42 +4728,29 @@ static void control_poll_ssrc(uint32_t ssrc) {
       poll_start_ms = now_ms();
     }
     unsigned long elapsed_ms = poll_start_ms ? (now_ms() - poll_start_ms) : 0UL;
-    if (verbose && debug_send && debug_send_poll) fprintf(stderr, "%s: +%lums: sending poll #%d for ssrc=%u\n", __FUNCTION__, elapsed_ms, poll_count, (unsigned)ssrc);
-    usleep(CONTROL_USLEEP_US);
-    if (verbose && debug_send && debug_send_poll) fprintf(stderr, "%s: +%lums: send OK (poll #%d)\n", __FUNCTION__, elapsed_ms, poll_count);
+    if (verbose && debug_send && debug_send_poll) fprintf(stderr, "%s: +%lums: sending poll #%d for ssrc=%u\n", __FUNCTION__, elapsed_ms, poll_count, (unsigned)ctl_prefix_ssrc(prefix));
   }
-  pthread_mutex_unlock(&ctl_mutex);
 }
 
 void control_poll(struct session *sp) {
   if (sp == NULL) return;
-  control_poll_ssrc(sp->ssrc);
+  control_poll_prefix(sp->ctl_prefix);
 }
 
 /* Refresh channel lifetime for a session without changing other params.
-   Sends a CMD with OUTPUT_SSRC and LIFETIME so radiod keeps the channel alive. */
-static void control_refresh_lifetime_ssrc(uint32_t ssrc) {
-  uint8_t cmdbuffer[PKTSIZE];
-  uint8_t *bp = cmdbuffer;
-  *bp++ = CMD; // Command
-  encode_int(&bp, OUTPUT_SSRC, ssrc);
+   Sends a CMD with OUTPUT_SSRC and LIFETIME so radiod keeps the channel alive;
+   like any command it is answered with a status packet, so it doubles as a poll. */
+static void control_refresh_lifetime_prefix(uint8_t const *prefix) {
+  uint8_t cmdbuffer[CTL_CMD_MAX];
+  uint8_t *bp = ctl_begin(cmdbuffer, prefix);
   encode_int(&bp, LIFETIME, DEFAULT_CHANNEL_LIFETIME);
-  encode_int(&bp, COMMAND_TAG, arc4random());
-  encode_eol(&bp);
-  int const command_len = bp - cmdbuffer;
-  pthread_mutex_lock(&ctl_mutex);
-  if (send(Ctl_fd, cmdbuffer, command_len, 0) != command_len) {
-    perror("command send: RefreshLifetime");
-  } else {
-    if (verbose && debug_send) fprintf(stderr, "%s: refreshed lifetime for ssrc=%u\n", __FUNCTION__, ssrc);
-    usleep(CONTROL_USLEEP_US);
-  }
-  pthread_mutex_unlock(&ctl_mutex);
+  if (ctl_finish(cmdbuffer, bp, CTL_KEY_NONE) == 0 && verbose && debug_send)
+    fprintf(stderr, "%s: refreshed lifetime for ssrc=%u\n", __FUNCTION__, (unsigned)ctl_prefix_ssrc(prefix));
 }
 
 void control_refresh_lifetime(struct session *sp) {
   if (sp == NULL) return;
-  control_refresh_lifetime_ssrc(sp->ssrc);
+  control_refresh_lifetime_prefix(sp->ctl_prefix);
 }
 
 /* Thread: periodically refresh lifetimes for all sessions so radiod does not remove channels
@@ -2492,48 +4763,40 @@ static void *lifetime_refresh_thread(void *arg) {
   const useconds_t loop_sleep_us = 1000000; /* 1s cadence */
   unsigned elapsed_ms = 0;
   for (;;) {
-    uint32_t ssrcs[MAX_SESSIONS];
+    uint8_t prefixes[MAX_SESSIONS][CTL_PREFIX_LEN];
     int nssrc = 0;
     usleep(loop_sleep_us);
     pthread_mutex_lock(&session_mutex);
     struct session *sp = sessions;
     while (sp != NULL) {
-      // Snapshot SSRCs for active websocket sessions; do control sends after unlocking session_mutex.
+      // Snapshot command headers for active websocket sessions; do control sends after unlocking session_mutex.
       if (sp->ws != NULL && nssrc < MAX_SESSIONS) {
-        ssrcs[nssrc++] = sp->ssrc;
+        memcpy(prefixes[nssrc++], sp->ctl_prefix, CTL_PREFIX_LEN);
       }
       sp = sp->next;
     }
     pthread_mutex_unlock(&session_mutex);
 
     for (int i = 0; i < nssrc; i++) {
-      /* Keep status flowing even when spectrum thread is paused/stopped so UI
-         informational fields (A/D, N0, RX rate, uptime, etc) continue to update. */
-      control_poll_ssrc(ssrcs[i]);
-      if (elapsed_ms >= refresh_interval_ms) {
-        /* Also refresh spectrum SSRC lifetime when client has requested spectrum.
-           This keeps the +1 channel from expiring during long-running sessions. */
-        pthread_mutex_lock(&session_mutex);
-        struct session *s = sessions;
-        bool refresh_spectrum = false;
-        while (s != NULL) {
-          if (s->ssrc == ssrcs[i]) {
-            refresh_spectrum = s->spectrum_requested_by_client;
-            break;
-          }
-          s = s->next;
-        }
-        pthread_mutex_unlock(&session_mutex);
-        if (refresh_spectrum) {
-          control_refresh_lifetime_ssrc(ssrcs[i] + 1);
-        }
-      }
-      if (elapsed_ms >= refresh_interval_ms) {
-        control_refresh_lifetime_ssrc(ssrcs[i]);
-      }
+      /* Keep status flowing even when spectrum polling is paused/stopped so UI
+         informational fields (A/D, N0, RX rate, uptime, etc) continue to update.
+         The lifetime refresh is answered with status too, so it replaces the poll. */
+      if (elapsed_ms >= refresh_interval_ms)
+        control_refresh_lifetime_prefix(prefixes[i]);
+      else
+        control_poll_prefix(prefixes[i]);
     }
 
     if (elapsed_ms >= refresh_interval_ms) {
+      /* Also refresh the shared spectrum channels so they do not expire
+         during long-running sessions */
+      uint32_t view_ssrcs[MAX_SESSIONS];
+      int nviews = spectrum_view_ssrcs(view_ssrcs, MAX_SESSIONS);
+      for (int i = 0; i < nviews; i++) {
+        uint8_t prefix[CTL_PREFIX_LEN];
+        ctl_prefix_init(prefix, view_ssrcs[i]);
+        control_refresh_lifetime_prefix(prefix);
+      }
       elapsed_ms = 0;
     } else {
       elapsed_ms += 1000;
@@ -2553,19 +4816,16 @@ is typically used in applications that process spectrum or signal analysis data,
 analyzers.
 
 The function takes several parameters: pointers to arrays and variables where it will store the extracted power
-values, time, frequency, and bin bandwidth; the expected SSRC (stream/source identifier); the input buffer and
-its length; and a pointer to the session structure for storing additional results.
-
-The function iterates through the buffer, reading one TLV field at a time. For each field, it reads the type
-(an enum value), then the length. If the length byte indicates a value of 128 or more, it uses additional bytes
-to determine the actual length, supporting variable-length fields. It then checks that the field does not extend
-beyond the buffer’s end to avoid buffer overflows.
+values, time, frequency, and bin bandwidth; the expected SSRC (stream/source identifier); the packet's TLV index,
+built once by `tlv_index()` in `dispatch_status_packet()`; and a pointer to the session structure for storing
+additional results.
 
-Depending on the type, the function decodes the value using helper functions (like `decode_int64`, `decode_double`,
-or `decode_float`) and stores the result in the appropriate output variable or session field. For example, if the
-type is `BIN_DATA`, it decodes an array of floating-point power values, updates the session’s min/max dB values,
-and checks that the number of bins does not exceed the provided array size. It also handles other types such as
-GPS time, frequency, demodulator type, and IF power.
+The function looks up only the fields it needs in the index, so the packet is not scanned again here; the index
+has already checked that no field extends beyond the buffer's end. Each value is decoded with helper functions
+(like `decode_int64`, `decode_double`, or `decode_float`) and stored in the appropriate output variable or session
+field. For `BIN_DATA` it decodes an array of floating-point power values, updates the session’s min/max dB values,
+and checks that the number of bins does not exceed the provided array size. It also handles GPS time, frequency,
+demodulator type, and IF power.
 
 After parsing, the function checks for consistency between the number of bins reported and the number of bins actually
 decoded, and ensures the count does not exceed a maximum allowed value. If any check fails, it returns an error
@@ -2575,99 +4835,54 @@ Overall, this function is robust against malformed or unexpected data, and is ca
 and to validate all extracted information. It is a good example of defensive programming in a low-level data parsing
 context.
 */
-int extract_powers(float *power,int npower,uint64_t *time,double *freq,double *bin_bw,int32_t const ssrc,uint8_t const * const buffer,int length,struct session *sp){
-#if 0  // use later
-  double l_lo1 = 0,l_lo2 = 0;
-#endif
+int extract_powers(float *power,int npower,uint64_t *time,double *freq,double *bin_bw,int32_t const ssrc,struct tlv_index const *idx,struct session *sp){
   int l_ccount = 0;
-  uint8_t const *cp = buffer;
   int l_count=1234567;
   int64_t N = (Frontend.L + Frontend.M - 1);
-  while(cp - buffer < length){
-    enum status_type const type = *cp++; // increment cp to length field
-    if(type == EOL)
-      break; // End of list
 
-    unsigned int optlen = *cp++;
-    if(optlen & 0x80){
-      // length is >= 128 bytes; fetch actual length from next N bytes, where N is low 7 bits of optlen
-      int length_of_length = optlen & 0x7f;
-      optlen = 0;
-      while(length_of_length > 0){
-        optlen <<= 8;
-        optlen |= *cp++;
-        length_of_length--;
-      }
-    }
-    if(cp - buffer + optlen >= length)
-      break; // Invalid length
-    switch(type){
-    case EOL: // Shouldn't get here
-      goto done;
-    case GPS_TIME:
-      *time = decode_int64(cp,optlen);
-      break;
-    case OUTPUT_SSRC: // Don't really need this, it's already been checked
-      if(decode_int32(cp,optlen) != ssrc)
-        return -1; // Not what we want
-      break;
-    case DEMOD_TYPE:
-     {
-        const int i = decode_int(cp,optlen);
-        if(i != SPECT_DEMOD && i != SPECT2_DEMOD)
-          return -3; // Not what we want
-      }
-      break;
-    case RADIO_FREQUENCY:
-      *freq = decode_double(cp,optlen);
-      break;
-#if 0  // Use this to fine-tweak freq later
-    case FIRST_LO_FREQUENCY:
-      l_lo1 = decode_double(cp,optlen);
-      break;
-    case SECOND_LO_FREQUENCY: // ditto
-      l_lo2 = decode_double(cp,optlen);
-      break;
-#endif
-    case BIN_BYTE_DATA:
-      l_count = optlen / sizeof(uint8_t);
-      if(l_count > npower)
-        return -2; // Not enough room in caller's array
-      if (0 == N)
-        break;
-      if (handle_bin_byte_data(power, npower, cp, optlen) < 0)
+  if(tlv_present(idx,OUTPUT_SSRC) && decode_int32(tlv_value(idx,OUTPUT_SSRC),tlv_length(idx,OUTPUT_SSRC)) != (uint32_t)ssrc)
+    return -1; // Not what we want (already checked by the caller)
+  if(tlv_present(idx,DEMOD_TYPE)){
+    const int i = decode_int(tlv_value(idx,DEMOD_TYPE),tlv_length(idx,DEMOD_TYPE));
+    if(i != SPECT_DEMOD && i != SPECT2_DEMOD)
+      return -3; // Not what we want
+  }
+  if(tlv_present(idx,GPS_TIME))
+    *time = decode_int64(tlv_value(idx,GPS_TIME),tlv_length(idx,GPS_TIME));
+  if(tlv_present(idx,RADIO_FREQUENCY))
+    *freq = decode_double(tlv_value(idx,RADIO_FREQUENCY),tlv_length(idx,RADIO_FREQUENCY));
+  if(tlv_present(idx,RESOLUTION_BW))
+    *bin_bw = decode_float(tlv_value(idx,RESOLUTION_BW),tlv_length(idx,RESOLUTION_BW));
+  if(tlv_present(idx,IF_POWER))
+    sp->if_power = decode_float(tlv_value(idx,IF_POWER),tlv_length(idx,IF_POWER));
+  if(tlv_present(idx,BIN_COUNT)) // Do we check that this equals the length of the BIN_DATA tlv?
+    l_ccount = decode_int(tlv_value(idx,BIN_COUNT),tlv_length(idx,BIN_COUNT));
+
+  if(tlv_present(idx,BIN_DATA)){
+    unsigned int const optlen = tlv_length(idx,BIN_DATA);
+    l_count = optlen/sizeof(float);
+    if(l_count > npower)
+      return -2; // Not enough room in caller's array
+    if (0 != N) {
+      if (handle_bin_data(power, npower, tlv_value(idx,BIN_DATA), optlen, sp) < 0)
         return -2;
       /* record per-session spectrum receive time */
       if (sp)
         sp->last_spectrum_recv_ms = now_ms();
-      break;
-    case BIN_DATA:
-      l_count = optlen/sizeof(float);
-      if(l_count > npower)
-        return -2; // Not enough room in caller's array
-      if (0 == N)
-        break;
-      if (handle_bin_data(power, npower, cp, optlen, sp) < 0)
+    }
+  } else if(tlv_present(idx,BIN_BYTE_DATA)){
+    unsigned int const optlen = tlv_length(idx,BIN_BYTE_DATA);
+    l_count = optlen / sizeof(uint8_t);
+    if(l_count > npower)
+      return -2; // Not enough room in caller's array
+    if (0 != N) {
+      if (handle_bin_byte_data(power, npower, tlv_value(idx,BIN_BYTE_DATA), optlen) < 0)
         return -2;
       /* record per-session spectrum receive time */
       if (sp)
         sp->last_spectrum_recv_ms = now_ms();
-      break;
-    case RESOLUTION_BW:
-      *bin_bw = decode_float(cp,optlen);
-      break;
-    case IF_POWER:
-      sp->if_power = decode_float(cp,optlen);
-      break;
-    case BIN_COUNT: // Do we check that this equals the length of the BIN_DATA tlv?
-      l_ccount = decode_int(cp,optlen);
-      break;
-    default:
-      break;
     }
-    cp += optlen;
   }
- done:
 
   if (l_count != l_ccount) {
     // not the expected number of bins...not sure why, but avoid crashing for now
@@ -2696,89 +4911,187 @@ static int handle_bin_byte_data(float *power, int npower, uint8_t const *cp, uns
   return 0;
 }
 
-static int handle_bin_data(float *power, int npower, uint8_t const *cp, unsigned int optlen, struct session *sp)
-{
-  int l_count = optlen / sizeof(float);
-  if (l_count > npower)
-    return -1;
-  if (l_count == 0)
-    return 0;
-  sp->bins_max_db = -INFINITY;
-  sp->bins_min_db = +INFINITY;
-  int i = l_count / 2; // DC
-  do {
-    float p = decode_float(cp, sizeof(float));
-    p = power2dB(p);
-    if (p == -INFINITY)
-      p = -150;
-    power[i] = p;
-    if (p > sp->bins_max_db)
-      sp->bins_max_db = p;
-    if (p < sp->bins_min_db)
-      sp->bins_min_db = p;
-    cp += sizeof(float);
-    i++;
-    if (i == l_count)
-      i = 0;
-  } while (i != l_count / 2);
-  return 0;
-}
-
 /*
-The `extract_noise` function is designed to parse a binary buffer containing tagged data fields and extract the
-noise density value for a given session. The function takes four parameters: a pointer to a float (`n0`) where
-the extracted noise value will be stored, a pointer to the start of the buffer (`buffer`), the length of the buffer
-(`length`), and a pointer to a session structure (`sp`). The function iterates through the buffer, reading one
-field at a time in a loop.
-
-Each field in the buffer is expected to follow a Type-Length-Value (TLV) format. The function first reads the type
-(an enum value) and then the length of the field. If the length byte indicates a value of 128 or more (the high bit is set),
-the actual length is encoded in the following bytes, allowing for fields longer than 127 bytes. The function decodes this extended length as needed.
-
-For each field, the function checks that the field does not extend beyond the end of the buffer to prevent buffer overruns.
-It then uses a switch statement to handle different field types. If the field type is `NOISE_DENSITY`, it decodes the value
-as a float and stores it in the location pointed to by `n0`. If the type is `EOL` (end of list), the function breaks
-out of the loop. For any other type, it simply skips over the field.
-
-After processing all fields or encountering an end-of-list marker, the function returns 0. This function is robust
-against malformed or unexpected data, as it checks buffer boundaries and handles variable-length fields. It is
-a typical example of defensive programming for parsing binary protocols in C or C++.
+  Spectrum bin conversion kernel
+  ------------------------------
+  Every BIN_DATA field carries one big-endian float power per bin, and each
+  must become dB for the display: 1620 bins per frame, per view, at 10+
+  frames a second. bins_to_db() does the byte swap, the dB conversion and
+  the min/max tracking in one branch-free loop that the compiler vectorizes,
+  and is built with target_clones so that on x86 the AVX2, SSE4.1 or
+  baseline version is picked at load time from the CPU's features. On
+  aarch64 NEON is part of the baseline, so the single build is already the
+  NEON path.
+
+  The logarithm is computed from the float's exponent plus a short series
+  on the mantissa: with m reduced to [sqrt(1/2), sqrt(2)) and
+  z = (m-1)/(m+1), ln(m) = 2(z + z^3/3 + z^5/5 + z^7/7 + ...), whose first
+  omitted term is below 2e-8. Results agree with 10*log10() within 1e-4 dB
+  (float rounding). Zero powers map to SPECTRUM_FLOOR_DB as before; so do
+  denormals, which log10() would put near -400 dB. Infinite (and NaN)
+  powers give +inf dB. The scalar fallback follows the same rules.
+
+  Min and max are tracked on the float bit patterns mapped to ordered
+  integers, which vectorize without -ffinite-math-only.
+
+  At startup spectrum_kernel_check() compares the kernel against the
+  scalar log10() path on synthetic bins, zero, denormals and infinity, and
+  falls back to the scalar path if they disagree. bench-db does the same
+  over every exponent and times both paths.
 */
-int extract_noise(float *n0,uint8_t const * const buffer,int length,struct session *sp){
-  uint8_t const *cp = buffer;
+#define SPECTRUM_FLOOR_DB (-150.0f)
 
-  while(cp - buffer < length){
-    enum status_type const type = *cp++; // increment cp to length field
+#if defined(__x86_64__) || defined(__i386__)
+#define SPECTRUM_KERNEL_CLONES __attribute__((target_clones("avx2", "sse4.1", "default")))
+#else
+#define SPECTRUM_KERNEL_CLONES
+#endif
 
-    if(type == EOL)
-      break; // End of list
+static bool spectrum_kernel_scalar; /* set if the self-check failed */
 
-    unsigned int optlen = *cp++;
-    if(optlen & 0x80){
-      // length is >= 128 bytes; fetch actual length from next N bytes, where N is low 7 bits of optlen
-      int length_of_length = optlen & 0x7f;
-      optlen = 0;
-      while(length_of_length > 0){
-        optlen <<= 8;
-        optlen |= *cp++;
-        length_of_length--;
-      }
-    }
-    if(cp - buffer + optlen >= length)
-      break; // Invalid length
-    switch(type){
-    case EOL: // Shouldn't get here
-      goto done;
-    case NOISE_DENSITY:
-      *n0 = decode_float(cp,optlen);
-      break;
-    default:
-      break;
+/* Map a finite float's bits to an integer with the same ordering, and back */
+static inline int32_t db_order_key(int32_t k)
+{
+  return k ^ ((k >> 31) & 0x7fffffff);
+}
+
+SPECTRUM_KERNEL_CLONES
+static void bins_to_db(float *restrict out, uint8_t const *restrict in, int n, float *minp, float *maxp)
+{
+  int32_t mn = INT32_MAX, mx = INT32_MIN;
+
+  for (int i = 0; i < n; i++) {
+    uint32_t u;
+    memcpy(&u, in + 4 * i, sizeof(u));
+    u = ntohl(u) & 0x7fffffffu; /* powers are never negative */
+    int32_t e = (int32_t)(u >> 23) - 127;
+    uint32_t const mbits = (u & 0x007fffffu) | 0x3f800000u;
+    float m;
+    memcpy(&m, &mbits, sizeof(m));
+    /* Reduce the mantissa to [sqrt(1/2), sqrt(2)) */
+    int32_t const big = m > 1.41421356f;
+    m = big ? m * 0.5f : m;
+    e += big;
+    float const z = (m - 1.0f) / (m + 1.0f);
+    float const z2 = z * z;
+    float const ln_m = z * (2.0f + z2 * (2.0f / 3 + z2 * (2.0f / 5 + z2 * (2.0f / 7))));
+    /* 10*log10(2^e * m) */
+    float db = 3.01029996f * (float)e + 4.34294482f * ln_m;
+    db = (u >> 23) == 0 ? SPECTRUM_FLOOR_DB : db;
+    db = (u >> 23) == 0xff ? INFINITY : db;
+    out[i] = db;
+    int32_t k;
+    memcpy(&k, &db, sizeof(k));
+    k = db_order_key(k);
+    mn = k < mn ? k : mn;
+    mx = k > mx ? k : mx;
+  }
+  if (n > 0) {
+    float fmn, fmx;
+    mn = db_order_key(mn);
+    mx = db_order_key(mx);
+    memcpy(&fmn, &mn, sizeof(fmn));
+    memcpy(&fmx, &mx, sizeof(fmx));
+    if (fmn < *minp)
+      *minp = fmn;
+    if (fmx > *maxp)
+      *maxp = fmx;
+  }
+}
+
+/* Reference path: one decode_float() and power2dB() per bin */
+static void bins_to_db_scalar(float *out, uint8_t const *in, int n, float *minp, float *maxp)
+{
+  for (int i = 0; i < n; i++) {
+    float p = fabsf(decode_float(in + 4 * i, sizeof(float)));
+    if (isnan(p) || isinf(p))
+      p = INFINITY;
+    else if (!isnormal(p))
+      p = SPECTRUM_FLOOR_DB; /* zero or denormal */
+    else
+      p = power2dB(p);
+    out[i] = p;
+    if (p > *maxp)
+      *maxp = p;
+    if (p < *minp)
+      *minp = p;
+  }
+}
+
+static bool spectrum_db_equal(float a, float b)
+{
+  return a == b || fabsf(a - b) <= 1e-3f;
+}
+
+/* Compare the kernel with the scalar path over powers spanning the range
+   radiod produces, plus zero, denormals and infinity */
+static void spectrum_kernel_check(void)
+{
+  enum { N = 1024 };
+  /* Zero and denormals (the first four) must come out as the floor */
+  static float const special[] = { 0.0f, 1e-45f, 1e-40f, 1.1754942e-38f, 1.1754944e-38f, INFINITY };
+  int const nspecial = sizeof(special) / sizeof(special[0]), nfloor = 4;
+  uint8_t in[4 * N];
+  float fast[N], ref[N];
+  float fmin = INFINITY, fmax = -INFINITY, rmin = INFINITY, rmax = -INFINITY;
+
+  for (int i = 0; i < N; i++) {
+    float const p = i < nspecial ? special[i] : powf(10.0f, -20.0f + 30.0f * i / N);
+    uint32_t u;
+    memcpy(&u, &p, sizeof(u));
+    u = htonl(u);
+    memcpy(in + 4 * i, &u, sizeof(u));
+  }
+  bins_to_db(fast, in, N, &fmin, &fmax);
+  bins_to_db_scalar(ref, in, N, &rmin, &rmax);
+  for (int i = 0; i < N; i++) {
+    if (!spectrum_db_equal(fast[i], ref[i]) || (i < nfloor && fast[i] != SPECTRUM_FLOOR_DB)) {
+      fprintf(stderr, "spectrum kernel: bin %d gives %f dB, expected %f; using scalar path\n", i, fast[i], ref[i]);
+      spectrum_kernel_scalar = true;
+      return;
     }
-    cp += optlen;
   }
-  done:
+  if (!spectrum_db_equal(fmin, rmin) || !spectrum_db_equal(fmax, rmax)) {
+    fprintf(stderr, "spectrum kernel: min/max %f/%f, expected %f/%f; using scalar path\n", fmin, fmax, rmin, rmax);
+    spectrum_kernel_scalar = true;
+  }
+}
+
+/* radiod sends the bins starting at DC; the display wants them starting at
+   the lowest frequency, so the upper half of the input goes first */
+static int handle_bin_data(float *power, int npower, uint8_t const *cp, unsigned int optlen, struct session *sp)
+{
+  int l_count = optlen / sizeof(float);
+  if (l_count > npower)
+    return -1;
+  if (l_count == 0)
+    return 0;
+  int const half = l_count / 2;
+  sp->bins_max_db = -INFINITY;
+  sp->bins_min_db = +INFINITY;
+  if (spectrum_kernel_scalar) {
+    bins_to_db_scalar(power + half, cp, l_count - half, &sp->bins_min_db, &sp->bins_max_db);
+    bins_to_db_scalar(power, cp + sizeof(float) * (l_count - half), half, &sp->bins_min_db, &sp->bins_max_db);
+  } else {
+    bins_to_db(power + half, cp, l_count - half, &sp->bins_min_db, &sp->bins_max_db);
+    bins_to_db(power, cp + sizeof(float) * (l_count - half), half, &sp->bins_min_db, &sp->bins_max_db);
+  }
+  return 0;
+}
+
+/*
+The `extract_noise` function extracts the noise density value for a given session from a status packet. It takes
+a pointer to a float (`n0`) where the extracted noise value will be stored, the packet's TLV index (built once by
+`tlv_index()` in `dispatch_status_packet()`), and a pointer to a session structure (`sp`).
 
+If the packet carries a `NOISE_DENSITY` field, the function decodes it as a float and stores it in the location
+pointed to by `n0`; otherwise `n0` is left unchanged. The index has already validated field lengths, so no scan of
+the buffer happens here. The function returns 0.
+*/
+int extract_noise(float *n0,struct tlv_index const *idx,struct session *sp){
+  (void)sp;
+  if(tlv_present(idx,NOISE_DENSITY))
+    *n0 = decode_float(tlv_value(idx,NOISE_DENSITY),tlv_length(idx,NOISE_DENSITY));
   return 0;
 }
 
@@ -2817,37 +5130,238 @@ int init_demod(struct channel *channel){
 }
 
 /*
-The `spectrum_thread` function is a POSIX thread routine designed to periodically request and poll spectrum data
-for a given session in a concurrent C or C++ application. It takes a pointer to a `session` structure as its argument,
-which it casts from a generic `void*` pointer. The function runs in a loop as long as the `spectrum_active` flag in
-the session remains true, allowing the thread to be cleanly stopped from elsewhere in the program.
-
-Within each iteration of the loop, the thread first locks the `spectrum_mutex` associated with the session to ensure
-thread-safe access to shared spectrum-related data. It then calls `control_get_powers`, passing the session pointer and
-relevant parameters such as the center frequency, number of bins, and bin width. This function likely sends a
-command to a remote server or device to request a new set of spectrum power measurements. After the request is sent,
-the mutex is unlocked, allowing other threads to access or modify the session's spectrum data.
-
-Next, the thread calls `control_poll`, which probably sends a poll command to check the status or retrieve results
-from the remote system. To avoid overwhelming the system and to pace the requests, the thread sleeps for 100 milliseconds
-using `usleep(100000)`. If the sleep call fails, an error message is printed. The loop then repeats, continuing to request
-and poll spectrum data as long as the session remains active.
-
-This design allows spectrum data to be requested and processed in the background, independently of the main
-application flow. The use of mutexes ensures that shared data is accessed safely in a multithreaded environment,
-and the periodic polling mechanism provides a balance between responsiveness and resource usage. The function
-returns `NULL` when the thread exits, as required by the POSIX thread API.
+  Spectrum poll scheduler
+  -----------------------
+  One thread issues the periodic spectrum requests (and the status poll that
+  goes with them) for every session, instead of a polling thread per client.
+  Sessions with spectrum running sit on a hashed timer wheel of
+  SPECTRUM_WHEEL_SLOTS slots, SPECTRUM_WHEEL_TICK_MS apart, keyed by the
+  time their next request is due. Each tick the thread takes the due
+  entries off the current slot, polls them without holding the wheel lock,
+  and puts them back at due + the session's own interval (`R:`), so every
+  client keeps its requested rate. Entries further out than one turn of the
+  wheel simply stay in their slot until their time comes.
+
+  To keep requests from arriving at radiod in bursts, a session's first
+  request is placed at a random offset within its interval, and every
+  reschedule adds a small random jitter (up to 1/16 of the interval either
+  way). A session that fell behind is resynchronised to now rather than
+  catching up with a burst.
+
+  The wheel holds a session reference from spectrum_sched_start() until the
+  entry fires after spectrum_active was cleared; the entry then leaves its
+  spectrum view and is dropped.
+
+  The achieved frame interval (a moving average of the gap between frames
+  actually delivered, see process_spectrum_packet()) is shown next to the
+  requested one on the status page.
+
+  The interval actually used adapts to what the client's connection takes
+  (spectrum_rate_adjust()). `R:<fastest_ms>[:<slowest_ms>]` sets the bounds;
+  at every request the session's output is checked for congestion: a
+  spectrum frame replaced in its mailbox before it was written, more than
+  SPECTRUM_RATE_BACKLOG bytes queued, spectrum frames taking longer than an
+  interval from queueing to written, or the socket's send buffer more than
+  half full (or full). Congestion halves the frame rate, at most once per
+  two intervals so the backlog can drain; otherwise the rate grows by
+  SPECTRUM_RATE_STEP frames/s every second. A marginal link so ends up with
+  fewer frames instead of a stalled socket. The rate in use is sent to the
+  client as `RATE:<interval_ms>` when it changes by a tenth or more, at most
+  once a second.
 */
-void *spectrum_thread(void *arg) {
-  struct session *sp = (struct session *)arg;
-  while(sp->spectrum_active) {
-    pthread_mutex_lock(&sp->spectrum_mutex);
-    control_get_powers_with_demod(sp,(float)sp->center_frequency,sp->bins,(float)sp->bin_width, SPECT2_DEMOD);
-    pthread_mutex_unlock(&sp->spectrum_mutex);
-    control_poll(sp);
-    if(usleep(sp->spectrum_poll_us) != 0) {
-      perror("spectrum_thread: usleep(sp->spectrum_poll_us)");
+#define SPECTRUM_WHEEL_SLOTS 256
+#define SPECTRUM_WHEEL_TICK_MS 5
+#define SPECTRUM_RATE_BACKLOG 65536 /* queued bytes that count as congestion */
+#define SPECTRUM_RATE_STEP 2.0f     /* additive increase, frames/s per second */
+#define SPECTRUM_RATE_REPORT_MS 1000
+
+static pthread_mutex_t spectrum_sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t spectrum_sched_cond = PTHREAD_COND_INITIALIZER;
+static struct session *spectrum_wheel[SPECTRUM_WHEEL_SLOTS];
+static unsigned long spectrum_wheel_cursor; /* last tick processed */
+static int spectrum_wheel_count;
+
+/* Add `sp` to the wheel at `due`. Called with spectrum_sched_mutex held. */
+static void spectrum_wheel_insert(struct session *sp, unsigned long due)
+{
+  unsigned long tick = due / SPECTRUM_WHEEL_TICK_MS;
+  if (tick <= spectrum_wheel_cursor)
+    tick = spectrum_wheel_cursor + 1; /* slot already passed this turn */
+  struct session **slot = &spectrum_wheel[tick % SPECTRUM_WHEEL_SLOTS];
+  sp->sched_due_ms = due;
+  sp->sched_next = *slot;
+  *slot = sp;
+}
+
+/* Interval for the current adaptive rate. Called with sp->spectrum_mutex held. */
+static unsigned long spectrum_rate_interval_ms(struct session const *sp)
+{
+  unsigned long interval = (unsigned long)lrintf(1000.0f / sp->spectrum_rate_fps);
+  return interval > 0 ? interval : 1;
+}
+
+static unsigned long spectrum_sched_interval_ms(struct session *sp)
+{
+  pthread_mutex_lock(&sp->spectrum_mutex);
+  unsigned long const interval = spectrum_rate_interval_ms(sp);
+  pthread_mutex_unlock(&sp->spectrum_mutex);
+  return interval;
+}
+
+/* Additive-increase, multiplicative-decrease of the session's spectrum rate
+   from the congestion signals of its output (see above) */
+static void spectrum_rate_adjust(struct session *sp, unsigned long now)
+{
+  pthread_mutex_lock(&sp->out_mutex);
+  uint64_t const drops = sp->out_drops[WS_CLASS_SPECTRUM];
+  long const backlog = sp->out_bytes;
+  float const write_ms = sp->spectrum_write_ms;
+  pthread_mutex_unlock(&sp->out_mutex);
+
+  /* Send buffer occupancy of the client's socket. ws_fd and
+     write_in_progress belong to ws_mutex, which a writer thread holds for
+     the length of a blocking write; if it is busy, skip this signal for
+     one round rather than stall the scheduler (a blocked write shows up in
+     the backlog and write time anyway). */
+  bool sndbuf_full = false;
+  if (pthread_mutex_trylock(&sp->ws_mutex) == 0) {
+    sndbuf_full = sp->write_in_progress;
+    int const fd = sp->ws_fd;
+    if (fd >= 0 && !sndbuf_full) {
+      int queued = 0, sndbuf = 0;
+      socklen_t len = sizeof(sndbuf);
+      if (ioctl(fd, SIOCOUTQ, &queued) == 0 && getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) == 0)
+        sndbuf_full = sndbuf > 0 && queued > sndbuf / 2;
+    }
+    pthread_mutex_unlock(&sp->ws_mutex);
+  }
+
+  pthread_mutex_lock(&sp->spectrum_mutex);
+  float const fastest = 1e6f / (float)(sp->spectrum_poll_us > 0 ? sp->spectrum_poll_us : 1);
+  float const slowest = 1000.0f / (float)(sp->spectrum_slowest_ms > 0 ? sp->spectrum_slowest_ms : 1);
+  unsigned long const interval = spectrum_rate_interval_ms(sp);
+  bool const congested = drops != sp->spectrum_rate_drops
+    || backlog > SPECTRUM_RATE_BACKLOG
+    || write_ms > (float)interval
+    || sndbuf_full;
+  sp->spectrum_rate_drops = drops;
+
+  float rate = sp->spectrum_rate_fps;
+  if (congested) {
+    if ((long)(now - sp->spectrum_rate_hold_ms) >= 0) {
+      rate *= 0.5f;
+      sp->spectrum_rate_hold_ms = now + 2000 / (rate > slowest ? rate : slowest);
+    }
+  } else {
+    rate += SPECTRUM_RATE_STEP * (float)interval / 1000.0f;
+  }
+  rate = rate > fastest ? fastest : rate;
+  rate = rate < slowest ? slowest : rate;
+  sp->spectrum_rate_fps = rate;
+
+  unsigned const now_interval = (unsigned)spectrum_rate_interval_ms(sp);
+  unsigned const reported = sp->spectrum_rate_reported_ms;
+  bool report = false;
+  if ((reported == 0 || now_interval * 10 >= reported * 11 || now_interval * 11 <= reported * 10)
+      && now - sp->spectrum_rate_report_time_ms >= SPECTRUM_RATE_REPORT_MS) {
+    sp->spectrum_rate_reported_ms = now_interval;
+    sp->spectrum_rate_report_time_ms = now;
+    report = true;
+  }
+  pthread_mutex_unlock(&sp->spectrum_mutex);
+
+  if (report) {
+    char msg[32];
+    snprintf(msg, sizeof(msg), "RATE:%u", now_interval);
+    send_ws_text_to_session(sp, msg);
+  }
+}
+
+/* Start periodic spectrum requests for `sp` (spectrum_active already set).
+   A no-op if the session is still on the wheel from an earlier start. */
+static void spectrum_sched_start(struct session *sp)
+{
+  unsigned long const interval = spectrum_sched_interval_ms(sp);
+  pthread_mutex_lock(&spectrum_sched_mutex);
+  if (!sp->spectrum_scheduled) {
+    sp->spectrum_scheduled = true;
+    sp->spectrum_frame_ms = 0;
+    sp->spectrum_achieved_ms = 0;
+    session_get(sp); /* released when the entry is dropped */
+    if (spectrum_wheel_count++ == 0)
+      spectrum_wheel_cursor = now_ms() / SPECTRUM_WHEEL_TICK_MS;
+    spectrum_wheel_insert(sp, now_ms() + arc4random_uniform(interval));
+    pthread_cond_signal(&spectrum_sched_cond);
+  }
+  pthread_mutex_unlock(&spectrum_sched_mutex);
+}
+
+static void *spectrum_scheduler_thread(void *arg)
+{
+  (void)arg;
+  for (;;) {
+    struct session *due = NULL;
+
+    pthread_mutex_lock(&spectrum_sched_mutex);
+    while (spectrum_wheel_count == 0)
+      pthread_cond_wait(&spectrum_sched_cond, &spectrum_sched_mutex);
+    unsigned long now = now_ms();
+    unsigned long const now_tick = now / SPECTRUM_WHEEL_TICK_MS;
+    /* Process every slot passed since the last wakeup (at most one turn) */
+    if (now_tick - spectrum_wheel_cursor > SPECTRUM_WHEEL_SLOTS)
+      spectrum_wheel_cursor = now_tick - SPECTRUM_WHEEL_SLOTS;
+    while (spectrum_wheel_cursor < now_tick) {
+      spectrum_wheel_cursor++;
+      struct session **pp = &spectrum_wheel[spectrum_wheel_cursor % SPECTRUM_WHEEL_SLOTS];
+      while (*pp != NULL) {
+        struct session *sp = *pp;
+        if ((long)(sp->sched_due_ms - now) <= 0) {
+          *pp = sp->sched_next;
+          sp->sched_next = due;
+          due = sp;
+        } else {
+          pp = &sp->sched_next;
+        }
+      }
+    }
+    pthread_mutex_unlock(&spectrum_sched_mutex);
+
+    while (due != NULL) {
+      struct session *sp = due;
+      due = sp->sched_next;
+      if (!sp->spectrum_active || sp->ws == NULL) {
+        spectrum_view_leave(sp);
+        pthread_mutex_lock(&spectrum_sched_mutex);
+        if (sp->spectrum_active && sp->ws != NULL) {
+          /* Restarted meanwhile; spectrum_sched_start() saw us still queued */
+          spectrum_wheel_insert(sp, now_ms());
+          pthread_mutex_unlock(&spectrum_sched_mutex);
+          continue;
+        }
+        sp->spectrum_scheduled = false;
+        spectrum_wheel_count--;
+        pthread_mutex_unlock(&spectrum_sched_mutex);
+        session_put(sp);
+        continue;
+      }
+      spectrum_view_poll(sp, false);
+      control_poll(sp);
+
+      spectrum_rate_adjust(sp, now_ms());
+      unsigned long const interval = spectrum_sched_interval_ms(sp);
+      long const jitter = (long)arc4random_uniform(interval / 8 + 1) - (long)(interval / 16);
+      unsigned long next = sp->sched_due_ms + interval + jitter;
+      now = now_ms();
+      if ((long)(next - now) < 0)
+        next = now; /* fell behind: resync instead of bursting */
+      pthread_mutex_lock(&spectrum_sched_mutex);
+      spectrum_wheel_insert(sp, next);
+      pthread_mutex_unlock(&spectrum_sched_mutex);
     }
+
+    /* Sleep to the start of the next tick */
+    now = now_ms();
+    usleep((useconds_t)((SPECTRUM_WHEEL_TICK_MS - now % SPECTRUM_WHEEL_TICK_MS) * 1000));
   }
   return NULL;
 }
@@ -2914,10 +5428,10 @@ void set_realtime(void){
 }
 
 /* Forward declarations for helpers used by ctrl_thread (helpers defined later) */
-static ssize_t recv_status_packet(uint8_t *buffer, size_t buflen, uint32_t *out_ssrc);
-static void process_spectrum_packet(struct session *sp, uint8_t *buffer, int rx_length);
-static void process_status_packet(struct session *sp, uint8_t *buffer, int rx_length, double *last_sent_backend_frequency);
-static bool tlv_has_type(uint8_t const *buf, int len, enum status_type want);
+#define STATUS_BATCH 16
+static void dispatch_status_packet(uint8_t *buffer, ssize_t rx_length);
+static void process_spectrum_packet(struct session **subs, int nsubs, uint32_t ssrc, struct tlv_index const *idx);
+static void process_status_packet(struct session *sp, struct tlv_index const *idx, double *last_sent_backend_frequency);
 
 /*
 The `ctrl_thread` function is a POSIX thread routine responsible for handling incoming status and spectrum data packets,
@@ -2928,20 +5442,21 @@ At the start, the function sets up several buffers and variables to hold incomin
 metadata. If the application is configured to run with real-time priority, it calls `set_realtime()` to attempt
 to elevate its scheduling priority, which is important for minimizing latency in real-time applications.
 
-The main logic is contained within an infinite loop. In each iteration, the thread waits for a packet to arrive
-on the `Status_fd` socket using `recvfrom`. When a packet is received, it checks if the packet is of type
-`STATUS` and has a valid length. It then extracts the SSRC (synchronization source identifier) from the packet to
-determine which session the data belongs to.
+The main logic is contained within an infinite loop. In each iteration, the thread drains the `Status_fd` socket
+with `mcast_recv_batch()`: one `recvmmsg` call returns up to STATUS_BATCH datagrams, and UDP GRO (when the kernel
+supports it) lets a single buffer carry several of them. Each datagram is passed to `dispatch_status_packet()`,
+which checks that the packet is of type `STATUS` and has a valid length. It then extracts the SSRC
+(synchronization source identifier) from the packet to determine which session the data belongs to.
 
-If the SSRC indicates spectrum data (odd value), the function locates the corresponding session and updates
-status values by calling `decode_radio_status`. It then prepares an RTP (Real-time Transport Protocol)
+If the SSRC indicates spectrum data (odd value), the function locates the spectrum view owning that channel and
+updates status values by calling `decode_radio_status`. It then prepares an RTP (Real-time Transport Protocol)
 header and serializes various session and frontend statistics into an output buffer. The function then extracts
-power values from the received packet (via `extract_powers()` and its helpers), packages the decoded power
-values into the output buffer, and sends the binary payload to the client’s WebSocket.
+power values from the received packet once (via `extract_powers()` and its helpers), packages the decoded power
+values into the output buffer, and sends the binary payload to the WebSocket of every session subscribed to the view.
 
 Note: `extract_powers()` and `handle_bin_data()` compute per-session min/max dB (stored in
-`sp->bins_min_db` / `sp->bins_max_db`) while decoding, but `process_spectrum_packet()` does not apply any
-automatic rescaling/autoranging to the outgoing 8-bit payload in this implementation.
+`sp->bins_min_db` / `sp->bins_max_db`) while decoding; `process_spectrum_packet()` uses them as the per-frame
+scale of the quantized payload, at the code width each session negotiated with `Q:`.
 
 If the SSRC indicates regular status data (even value), the function updates the session’s status, extracts noise density,
 and checks if the current preset and frequency match the requested values. If not, it issues commands to correct them.
@@ -2955,96 +5470,477 @@ multiple clients, supporting features like dynamic scaling, error correction, an
 */
 void *ctrl_thread(void *arg)
 {
-  static double last_sent_backend_frequency = 0.0;
-  uint8_t buffer[PKTSIZE / sizeof(float)];
+  /* Status datagrams drained per recvmmsg() call. Buffers are sized for
+     UDP GRO super-datagrams, which may carry up to 64 segments each. */
+  static uint8_t buffers[STATUS_BATCH][PKTSIZE];
+  static struct mcast_seg segs[MCAST_SEGS(STATUS_BATCH)];
+  uint8_t *bufs[STATUS_BATCH];
+  int gro_fd = -1;
+
+  for (int i = 0; i < STATUS_BATCH; i++)
+    bufs[i] = buffers[i];
 
   if (run_with_realtime)
     set_realtime();
 
   while (1) {
-    uint32_t ssrc = 0;
-    ssize_t rx_length = recv_status_packet(buffer, sizeof(buffer), &ssrc);
-    if (rx_length <= 2)
+    /* Snapshot Status_fd; if there is no active socket wait for one */
+    int fd = Status_fd;
+    if (fd == -1) {
+      usleep(1000);
       continue;
-    if (verbose)
-      fprintf(stderr, "ctrl_thread: recv_status_packet len=%zd ssrc=%u\n", rx_length, ssrc);
-
-    if (ssrc % 2 == 1) { /* spectrum */
-      struct session *sp = find_session_from_ssrc(ssrc - 1);
-      if (sp) {
-        if (sp->ws == NULL) {
-          /* Stale session: no websocket associated. Remove it so a reconnect
-             can take its SSRC slot. `delete_session` unlocks the session_mutex. */
-          if (debugSSRC) fprintf(stderr, "ctrl_thread: removing stale spectrum session ssrc=%u sp=%p\n", sp->ssrc, (void *)sp);
-          delete_session(sp);
-        } else {
-          if (debugSSRC)
-            fprintf(stderr, "ctrl_thread: spectrum packet ssrc=%u -> session ssrc=%u sp=%p\n", ssrc, sp->ssrc, (void *)sp);
-          process_spectrum_packet(sp, buffer, (int)rx_length);
-          pthread_mutex_unlock(&session_mutex);
-        }
+    }
+    if (fd != gro_fd) {
+      if (mcast_enable_gro(fd) == 0 && verbose)
+        fprintf(stderr, "ctrl_thread: UDP GRO enabled on status socket\n");
+      gro_fd = fd;
+    }
+    int n = mcast_recv_batch(fd, bufs, sizeof(buffers[0]), STATUS_BATCH,
+                             segs, sizeof(segs) / sizeof(segs[0]), &Status_ingest);
+    if (n == -1) {
+      if (errno != EBADF) /* EBADF: socket was closed by monitor thread */
+        perror("recvmmsg(status)");
+      continue;
+    }
+    if (n > 0) {
+      /* Record last successful status receive time (monotonic ms) */
+      ingest_recv_ns = mono_ns();
+      last_status_recv_ms = (unsigned long)(ingest_recv_ns / 1000000ULL);
+      memcpy(&Metadata_source_socket, &segs[n - 1].source, sizeof(Metadata_source_socket));
+    }
+    if (capture_fp != NULL)
+      for (int i = 0; i < n; i++)
+        capture_write(CAPTURE_STATUS, segs[i].data, segs[i].len, ingest_recv_ns);
+    for (int i = 0; i < n; i++)
+      dispatch_status_packet(segs[i].data, (ssize_t)segs[i].len);
+  }
+  return NULL;
+}
+
+/* Route one status datagram from radiod to the session(s) it belongs to:
+   spectrum replies (odd SSRC) go to process_spectrum_packet() for every
+   subscriber of that spectrum view, channel status (even SSRC) to
+   process_status_packet().
+   Called only from ctrl_thread, which keeps Frontend/Channel decoding
+   single-threaded. */
+static void dispatch_status_packet(uint8_t *buffer, ssize_t rx_length)
+{
+  static double last_sent_backend_frequency = 0.0;
+  static struct tlv_index idx; /* ctrl_thread only */
+  uint32_t ssrc = 0;
+
+  if (rx_length <= 2)
+    return;
+  /* Index the TLVs once; every consumer below looks its fields up here */
+  if ((enum pkt_type)buffer[0] == STATUS) {
+    tlv_index(&idx, buffer + 1, rx_length - 1);
+    if (tlv_present(&idx, OUTPUT_SSRC))
+      ssrc = decode_int32(tlv_value(&idx, OUTPUT_SSRC), tlv_length(&idx, OUTPUT_SSRC));
+  }
+  if (debugSSRC && ssrc)
+    fprintf(stderr, "monitor: status recv ssrc=%u at %lu\n", ssrc, last_status_recv_ms);
+  if (verbose)
+    fprintf(stderr, "ctrl_thread: status packet len=%zd ssrc=%u\n", rx_length, ssrc);
+
+  if (ssrc % 2 == 1) { /* spectrum */
+    struct session *subs[MAX_SESSIONS];
+    int nsubs = 0;
+    int const n = spectrum_view_subscribers(ssrc, subs);
+    for (int i = 0; i < n; i++) {
+      struct session *sp = subs[i];
+      if (sp->ws == NULL) {
+        /* Stale session: no websocket associated. Remove it so a reconnect
+           can take its SSRC slot. `delete_session` unlocks the session_mutex. */
+        if (debugSSRC) fprintf(stderr, "ctrl_thread: removing stale spectrum session ssrc=%u sp=%p\n", sp->ssrc, (void *)sp);
+        pthread_mutex_lock(&session_mutex);
+        delete_session(sp);
+        session_put(sp);
       } else {
         if (debugSSRC)
-          fprintf(stderr, "ctrl_thread: spectrum packet ssrc=%u -> no session found for lookup ssrc=%u\n", ssrc, ssrc - 1);
+          fprintf(stderr, "ctrl_thread: spectrum packet ssrc=%u -> session ssrc=%u sp=%p\n", ssrc, sp->ssrc, (void *)sp);
+        subs[nsubs++] = sp;
       }
-    } else { /* regular status */
-      struct session *sp = find_session_from_ssrc(ssrc);
-      if (sp) {
-        if (sp->ws == NULL) {
-          if (debugSSRC) fprintf(stderr, "ctrl_thread: removing stale status session ssrc=%u sp=%p\n", sp->ssrc, (void *)sp);
-          delete_session(sp);
-        } else {
-          if (debugSSRC)
-            fprintf(stderr, "ctrl_thread: status packet ssrc=%u -> session ssrc=%u sp=%p\n", ssrc, sp->ssrc, (void *)sp);
-          process_status_packet(sp, buffer, (int)rx_length, &last_sent_backend_frequency);
-          pthread_mutex_unlock(&session_mutex);
-        }
+    }
+    if (nsubs > 0) {
+      /* Spectrum forwarding only reads session state; no lock needed */
+      process_spectrum_packet(subs, nsubs, ssrc, &idx);
+    } else if (debugSSRC) {
+      fprintf(stderr, "ctrl_thread: spectrum packet ssrc=%u -> no spectrum view subscribers\n", ssrc);
+    }
+    for (int i = 0; i < nsubs; i++)
+      session_put(subs[i]);
+  } else { /* regular status */
+    struct session *sp = find_session_from_ssrc(ssrc);
+    if (sp) {
+      if (sp->ws == NULL) {
+        if (debugSSRC) fprintf(stderr, "ctrl_thread: removing stale status session ssrc=%u sp=%p\n", sp->ssrc, (void *)sp);
+        pthread_mutex_lock(&session_mutex);
+        delete_session(sp);
       } else {
         if (debugSSRC)
-          fprintf(stderr, "ctrl_thread: status packet ssrc=%u -> no session found\n", ssrc);
+          fprintf(stderr, "ctrl_thread: status packet ssrc=%u -> session ssrc=%u sp=%p\n", ssrc, sp->ssrc, (void *)sp);
+        sp->status_packets++;
+        pthread_mutex_lock(&sp->state_mutex);
+        process_status_packet(sp, &idx, &last_sent_backend_frequency);
+        pthread_mutex_unlock(&sp->state_mutex);
       }
+      session_put(sp);
+    } else {
+      if (debugSSRC)
+        fprintf(stderr, "ctrl_thread: status packet ssrc=%u -> no session found\n", ssrc);
+    }
+  }
+}
+
+/*
+  Capture and replay
+  ------------------
+  `-w file` appends every datagram the ingest threads receive on Status_fd
+  and Input_fd to `file`, stamped with its receive time; `-R file` feeds
+  such a capture back through dispatch_status_packet()/dispatch_audio_packet()
+  instead of listening to radiod, so performance work needs neither radiod
+  nor an SDR. A replay runs on one thread in place of ctrl_thread and
+  audio_thread, which keeps the single-thread assumptions of the dispatch
+  paths, and starts over when it reaches the end of the file.
+
+  File format (integers little-endian):
+    header  "KA9QCAP\0", u32 version (1), u32 reserved, u64 capture start (Unix ns)
+    record  u64 ns since the capture was opened, u32 length, u8 socket (0 status,
+            1 audio), 3 reserved bytes, then the datagram
+
+  `-R file[:speed[:map]]`: speed 1 keeps the original timing, N plays N
+  times as fast, 0 as fast as possible. With map 1 (the default) the
+  captured SSRCs are rewritten onto whatever is live: the i-th session
+  receives the (i mod n)-th of the n audio/status channels in the capture
+  and the i-th spectrum view the (i mod m)-th of its m spectrum channels,
+  so a capture of one listener can drive any number of simulated sessions.
+  With map 0 datagrams are replayed with the SSRCs they were captured with.
+
+  The ingest threads only copy records into one of two CAPTURE_BUFFER byte
+  buffers under capture_mutex; capture_thread swaps them and writes the
+  full one to the file without the lock, at least once a second (the
+  process is normally killed, not stopped, so the file is kept current)
+  and as soon as a buffer is half full. If the disk falls so far behind
+  that both buffers fill, records are dropped and counted rather than
+  stalling ingest.
+*/
+#define CAPTURE_MAGIC "KA9QCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER 24
+#define CAPTURE_RECORD 16
+#define CAPTURE_BUFFER (1 << 20)
+#define REPLAY_MAX_STREAMS 64
+
+static pthread_mutex_t capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t capture_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t capture_start_ns; /* mono_ns() at capture_open() */
+static uint64_t capture_dropped;
+static uint8_t *capture_buf[2];
+static size_t capture_len;  /* bytes in capture_buf[capture_cur] */
+static int capture_cur;     /* buffer the ingest threads fill */
+static bool capture_failed; /* write error: stop recording */
+static void *capture_thread(void *arg);
+
+static void put_le(uint8_t *p, uint64_t x, int n)
+{
+  for (int i = 0; i < n; i++, x >>= 8)
+    p[i] = (uint8_t)x;
+}
+
+static uint64_t get_le(uint8_t const *p, int n)
+{
+  uint64_t x = 0;
+  for (int i = n - 1; i >= 0; i--)
+    x = x << 8 | p[i];
+  return x;
+}
+
+/* Open `path` for -w and write its header */
+int capture_open(char const *path)
+{
+  capture_start_ns = mono_ns();
+  capture_fp = fopen(path, "wb");
+  if (capture_fp == NULL) {
+    perror(path);
+    return -1;
+  }
+  uint8_t hdr[CAPTURE_HEADER] = CAPTURE_MAGIC;
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  put_le(hdr + 8, CAPTURE_VERSION, 4);
+  put_le(hdr + 16, (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec, 8);
+  capture_buf[0] = malloc(CAPTURE_BUFFER);
+  capture_buf[1] = malloc(CAPTURE_BUFFER);
+  pthread_t task;
+  if (fwrite(hdr, sizeof(hdr), 1, capture_fp) != 1 || fflush(capture_fp) != 0) {
+    perror(path);
+    fclose(capture_fp);
+    capture_fp = NULL;
+    return -1;
+  }
+  if (capture_buf[0] == NULL || capture_buf[1] == NULL || pthread_create(&task, NULL, capture_thread, NULL) != 0) {
+    perror("capture");
+    fclose(capture_fp);
+    capture_fp = NULL;
+    return -1;
+  }
+  pthread_setname_np(task, "capture");
+  pthread_detach(task);
+  return 0;
+}
+
+/* Write out the buffer the ingest threads filled, outside capture_mutex */
+static void *capture_thread(void *arg)
+{
+  (void)arg;
+  uint64_t dropped_reported = 0;
+  for (;;) {
+    pthread_mutex_lock(&capture_mutex);
+    if (capture_len < CAPTURE_BUFFER / 2) {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += 1;
+      pthread_cond_timedwait(&capture_cond, &capture_mutex, &ts);
+    }
+    uint8_t const *buf = capture_buf[capture_cur];
+    size_t const len = capture_len;
+    capture_cur ^= 1;
+    capture_len = 0;
+    uint64_t const dropped = capture_dropped;
+    pthread_mutex_unlock(&capture_mutex);
+
+    if (dropped != dropped_reported) {
+      fprintf(stderr, "capture: %llu records dropped, disk too slow\n", (unsigned long long)dropped);
+      dropped_reported = dropped;
+    }
+    if (len == 0)
+      continue;
+    if (fwrite(buf, len, 1, capture_fp) != 1 || fflush(capture_fp) != 0) {
+      perror("capture write");
+      pthread_mutex_lock(&capture_mutex);
+      capture_failed = true;
+      pthread_mutex_unlock(&capture_mutex);
+      return NULL;
     }
   }
   return NULL;
 }
 
-/* Helper: receive a status packet and extract ssrc (keeps simple recvfrom handling centralized) */
-static ssize_t recv_status_packet(uint8_t *buffer, size_t buflen, uint32_t *out_ssrc)
+/* Append one received datagram; called by the ingest threads */
+static void capture_write(int sock, uint8_t const *data, size_t len, uint64_t recv_ns)
+{
+  uint8_t rec[CAPTURE_RECORD] = { 0 };
+  pthread_mutex_lock(&capture_mutex);
+  if (capture_fp == NULL || capture_failed) {
+    pthread_mutex_unlock(&capture_mutex);
+    return;
+  }
+  if (capture_len + sizeof(rec) + len > CAPTURE_BUFFER) {
+    capture_dropped++;
+    pthread_mutex_unlock(&capture_mutex);
+    return;
+  }
+  /* A datagram received just before capture_open() is stamped 0 */
+  put_le(rec, recv_ns < capture_start_ns ? 0 : recv_ns - capture_start_ns, 8);
+  put_le(rec + 8, len, 4);
+  rec[12] = (uint8_t)sock;
+  uint8_t *const bp = capture_buf[capture_cur] + capture_len;
+  memcpy(bp, rec, sizeof(rec));
+  memcpy(bp + sizeof(rec), data, len);
+  capture_len += sizeof(rec) + len;
+  if (capture_len >= CAPTURE_BUFFER / 2 && capture_len - sizeof(rec) - len < CAPTURE_BUFFER / 2)
+    pthread_cond_signal(&capture_cond);
+  pthread_mutex_unlock(&capture_mutex);
+}
+
+/* Replay parameters from -R */
+char const *replay_path;
+double replay_speed = 1.0;
+bool replay_map = true;
+
+struct replay_streams {
+  uint32_t ssrc[REPLAY_MAX_STREAMS];
+  int n;
+};
+
+/* Position of `ssrc` among the capture's streams, adding it if new */
+static int replay_stream_index(struct replay_streams *s, uint32_t ssrc)
 {
-  socklen_t ssize = sizeof(Metadata_source_socket);
-  /* Snapshot Status_fd to avoid a null/closed fd obvious cases; callers
-     should handle non-positive returns. If Status_fd is -1 return -1 so
-     callers know there's no active socket. */
-  if (Status_fd == -1)
+  for (int i = 0; i < s->n; i++)
+    if (s->ssrc[i] == ssrc)
+      return i;
+  if (s->n == REPLAY_MAX_STREAMS)
     return -1;
-  ssize_t rx_length = recvfrom(Status_fd, buffer, buflen, 0,
-                               (struct sockaddr *)&Metadata_source_socket, &ssize);
-  if (rx_length <= 0) {
-    if (rx_length == -1) {
-      if (errno == EINTR)
-        return -1;
-      if (errno == EAGAIN || errno == EWOULDBLOCK)
-        return -1;
-      if (errno == EBADF) {
-        /* Socket was closed by monitor thread; return so caller can continue */
-        return -1;
+  s->ssrc[s->n] = ssrc;
+  return s->n++;
+}
+
+/* SSRC of a captured status datagram, 0 if none */
+static uint32_t replay_status_ssrc(uint8_t const *data, size_t len, struct tlv_index *idx)
+{
+  if (len <= 2 || (enum pkt_type)data[0] != STATUS)
+    return 0;
+  tlv_index(idx, data + 1, len - 1);
+  if (!tlv_present(idx, OUTPUT_SSRC))
+    return 0;
+  return decode_int32(tlv_value(idx, OUTPUT_SSRC), tlv_length(idx, OUTPUT_SSRC));
+}
+
+/* Copy a status datagram into `out` with its OUTPUT_SSRC re-encoded as `ssrc` */
+static size_t replay_rewrite_status(uint8_t *out, uint8_t const *data, size_t len, struct tlv_index const *idx,
+                                   uint32_t ssrc)
+{
+  uint8_t const *tlv = tlv_value(idx, OUTPUT_SSRC) - 2; /* type and a one-byte length */
+  uint8_t const *rest = tlv_value(idx, OUTPUT_SSRC) + tlv_length(idx, OUTPUT_SSRC);
+  size_t const head = (size_t)(tlv - data);
+  memcpy(out, data, head);
+  uint8_t *bp = out + head;
+  encode_int32(&bp, OUTPUT_SSRC, ssrc);
+  size_t const tail = (size_t)(data + len - rest);
+  memcpy(bp, rest, tail);
+  return (size_t)(bp - out) + tail;
+}
+
+/* Live targets for the `k`-th of `n` captured streams: sessions (channels)
+   or spectrum views, every n-th one starting at k */
+static int replay_targets(bool spectrum, int k, int n, uint32_t *out)
+{
+  int count = 0, i = 0;
+  if (spectrum) {
+    pthread_mutex_lock(&spectrum_view_mutex);
+    for (struct spectrum_view *v = spectrum_views; v != NULL && count < MAX_SESSIONS; v = v->next, i++)
+      if (i % n == k)
+        out[count++] = v->ssrc;
+    pthread_mutex_unlock(&spectrum_view_mutex);
+  } else {
+    pthread_mutex_lock(&session_mutex);
+    for (struct session *sp = sessions; sp != NULL && count < MAX_SESSIONS; sp = sp->next, i++)
+      if (i % n == k)
+        out[count++] = sp->ssrc;
+    pthread_mutex_unlock(&session_mutex);
+  }
+  return count;
+}
+
+/* Hand one captured datagram to the dispatcher, once per mapped target */
+static void replay_dispatch(int sock, uint8_t const *data, size_t len, struct replay_streams *streams)
+{
+  static uint8_t buf[PKTSIZE + 16]; /* status rewrite may grow OUTPUT_SSRC */
+  static struct tlv_index idx;
+  uint32_t targets[MAX_SESSIONS];
+  int ntargets = 1;
+
+  if (len > PKTSIZE || (sock == CAPTURE_AUDIO && len > (size_t)PKTBUF_CAP))
+    return;
+  if (sock == CAPTURE_AUDIO) {
+    uint32_t const ssrc = len >= 12 ? (uint32_t)(data[8] << 24 | data[9] << 16 | data[10] << 8 | data[11]) : 0;
+    targets[0] = ssrc;
+    if (replay_map) {
+      int const k = replay_stream_index(&streams[0], ssrc);
+      ntargets = k < 0 ? 0 : replay_targets(false, k, streams[0].n, targets);
+    }
+    for (int i = 0; i < ntargets; i++) {
+      struct pktbuf *pb = pktbuf_alloc();
+      if (pb == NULL)
+        return;
+      memcpy(pb->data, data, len);
+      if (len >= 12) {
+        pb->data[8] = (uint8_t)(targets[i] >> 24);
+        pb->data[9] = (uint8_t)(targets[i] >> 16);
+        pb->data[10] = (uint8_t)(targets[i] >> 8);
+        pb->data[11] = (uint8_t)targets[i];
       }
-      /* Unexpected recv error: log and return */
-      perror("recvfrom(status)");
-      return -1;
+      pb->recv_ns = ingest_recv_ns;
+      dispatch_audio_packet(pb, (ssize_t)len);
+      pktbuf_put(pb);
     }
-    return rx_length;
+    return;
   }
-  /* Record last successful status receive time (monotonic ms) */
-  last_status_recv_ms = now_ms();
-  if (rx_length > 2 && (enum pkt_type)buffer[0] == STATUS) {
-    *out_ssrc = get_ssrc(buffer + 1, rx_length - 1);
-  } else {
-    *out_ssrc = 0;
+  uint32_t const ssrc = replay_status_ssrc(data, len, &idx);
+  if (!replay_map || ssrc == 0) {
+    memcpy(buf, data, len);
+    dispatch_status_packet(buf, (ssize_t)len);
+    return;
+  }
+  bool const spectrum = ssrc % 2 == 1;
+  struct replay_streams *s = &streams[spectrum ? 2 : 0];
+  int const k = replay_stream_index(s, ssrc);
+  ntargets = k < 0 ? 0 : replay_targets(spectrum, k, s->n, targets);
+  for (int i = 0; i < ntargets; i++) {
+    size_t const n = replay_rewrite_status(buf, data, len, &idx, targets[i]);
+    dispatch_status_packet(buf, (ssize_t)n);
+  }
+}
+
+/* Replays the -R capture forever; stands in for ctrl_thread and audio_thread */
+static void *replay_thread(void *arg)
+{
+  (void)arg;
+  int fd = open(replay_path, O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    perror(replay_path);
+    return NULL;
+  }
+  uint8_t const *map = st.st_size > 0 ? mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (map == MAP_FAILED || st.st_size < CAPTURE_HEADER || memcmp(map, CAPTURE_MAGIC, 8) != 0
+      || get_le(map + 8, 4) != CAPTURE_VERSION) {
+    fprintf(stderr, "%s: not a ka9q-web capture\n", replay_path);
+    return NULL;
+  }
+  size_t const size = (size_t)st.st_size;
+  /* Audio/status channels share index space [0]; spectrum channels use [2]
+     ([1] unused) so the i-th session and the i-th view line up separately */
+  struct replay_streams streams[3];
+  memset(streams, 0, sizeof(streams));
+
+  for (unsigned long pass = 1;; pass++) {
+    uint64_t const start = mono_ns();
+    unsigned long records = 0;
+    uint64_t last_t = 0;
+    size_t off = CAPTURE_HEADER;
+    while (off + CAPTURE_RECORD <= size) {
+      uint8_t const *rec = map + off;
+      uint64_t t = get_le(rec, 8);
+      size_t const len = (size_t)get_le(rec + 8, 4);
+      if (off + CAPTURE_RECORD + len > size)
+        break;
+      /* Ingest threads take capture_mutex in any order, so a record can be
+         stamped before the one ahead of it, and older captures hold such
+         negative deltas wrapped to near 2^64: both play with the record
+         before them */
+      if (t < last_t || t > INT64_MAX)
+        t = last_t;
+      last_t = t;
+      if (replay_speed > 0) {
+        /* Keep the conversion in range for very small speeds */
+        double const delay = (double)t / replay_speed;
+        uint64_t const due = start + (delay < 1e18 ? (uint64_t)delay : 1000000000000000000ULL);
+        struct timespec ts = { .tv_sec = (time_t)(due / 1000000000ULL), .tv_nsec = (long)(due % 1000000000ULL) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+          ;
+      }
+      ingest_recv_ns = mono_ns();
+      if (rec[12] == CAPTURE_STATUS) {
+        Status_ingest.datagrams++;
+        last_status_recv_ms = (unsigned long)(ingest_recv_ns / 1000000ULL);
+      } else {
+        Audio_ingest.datagrams++;
+      }
+      replay_dispatch(rec[12], rec + CAPTURE_RECORD, len, streams);
+      if (audio_rx_npending > 0)
+        audio_rx_expire(ingest_recv_ns);
+      off += CAPTURE_RECORD + len;
+      records++;
+    }
+    if (verbose || pass == 1)
+      fprintf(stderr, "replay: pass %lu of %s: %lu datagrams in %.3f s\n", pass, replay_path, records,
+              (double)(mono_ns() - start) / 1e9);
+    if (records == 0)
+      return NULL;
   }
-  if (debugSSRC && *out_ssrc)
-    fprintf(stderr, "monitor: status recv ssrc=%u at %lu\n", *out_ssrc, last_status_recv_ms);
-  return rx_length;
+  return NULL;
 }
 
 /*
@@ -3055,15 +5951,32 @@ static ssize_t recv_status_packet(uint8_t *buffer, size_t buflen, uint32_t *out_
   - Recipient: the web browser client connected on `sp->ws`.
   - Locks `sp->ws_mutex` to serialize websocket access for the session.
   - Sets the websocket opcode to binary and writes `size` bytes from `buf`.
+  - `cls` selects the outgoing queue and its drop policy (see enum ws_class).
   - Logs an error to stderr when the write fails (return value <= 0).
   - Always unlocks `sp->ws_mutex` before returning.
 */
-static void send_ws_binary_to_session(struct session *sp, uint8_t *buf, int size)
+static void send_ws_binary_to_session(struct session *sp, uint8_t *buf, int size, enum ws_class cls)
 {
   /* Enqueue binary payload for the per-session writer thread. */
   if (sp == NULL) return;
   if (size <= 0 || buf == NULL) return;
-  enqueue_ws_message(sp, buf, size, 0);
+  enqueue_ws_message(sp, buf, size, 0, cls);
+}
+
+/* Like send_ws_binary_to_session() for the first `size` bytes of a shared
+   packet buffer: the session takes a reference instead of copying. */
+static void send_ws_pktbuf_to_session(struct session *sp, struct pktbuf *pb, int size, enum ws_class cls)
+{
+  if (sp == NULL || pb == NULL || size <= 0) return;
+  struct ws_msg *m = ws_msg_alloc(0);
+  if (!m) return;
+  atomic_fetch_add_explicit(&pb->refs, 1, memory_order_relaxed);
+  m->pb = pb;
+  m->data = pb->data;
+  m->size = size;
+  m->is_text = 0;
+  m->cls = cls;
+  ws_msg_queue(sp, m);
 }
 
 /*
@@ -3080,63 +5993,946 @@ static void send_ws_binary_to_session(struct session *sp, uint8_t *buf, int size
 static void send_ws_text_to_session(struct session *sp, const char *msg)
 {
   if (sp == NULL || msg == NULL) return;
-  enqueue_ws_message(sp, (const uint8_t *)msg, (int)strlen(msg), 1);
+  enqueue_ws_message(sp, (const uint8_t *)msg, (int)strlen(msg), 1, WS_CLASS_CONTROL);
 }
 
-/* Enqueue a message onto the session outgoing queue. Caller may be any thread. */
-static void enqueue_ws_message(struct session *sp, const uint8_t *buf, int size, int is_text)
+/* Account for a queued message that will never be sent. Called with
+   out_mutex held; the caller frees the message after unlocking. */
+static void ws_out_drop_locked(struct session *sp, struct ws_msg *m)
 {
-  struct ws_msg *m = calloc(1, sizeof(*m));
-  if (!m) return;
-  m->data = malloc(size);
-  if (!m->data) { free(m); return; }
-  memcpy(m->data, buf, size);
-  m->size = size;
-  m->is_text = is_text;
-  m->next = NULL;
+  sp->out_drops[m->cls]++;
+  sp->out_frames--;
+  sp->out_bytes -= m->size;
+}
 
-  pthread_mutex_lock(&sp->out_mutex);
-  if (sp->out_tail == NULL) {
-    sp->out_head = sp->out_tail = m;
-  } else {
-    sp->out_tail->next = m;
-    sp->out_tail = m;
+/*
+  Outgoing frame allocator
+  ------------------------
+  Every audio packet, spectrum frame, status frame and text reply is copied
+  into a ws_msg before it is queued, and freed by an output engine once it
+  is written. To keep malloc out of that path, messages come from a small
+  slab allocator with the payload stored inline after the header:
+
+  - Three size classes cover the real traffic: text and status frames,
+    spectrum frames (header plus up to MAX_BINS bytes) and RTP audio
+    payloads. Anything larger falls back to the heap.
+  - Each thread keeps a cache of free objects per class. Producers (audio,
+    status and spectrum threads) drain their caches and the engine threads
+    fill theirs, so objects travel through a per-class depot in batches of
+    WS_MSG_BATCH under a mutex taken once per batch.
+  - When the depot is empty a new slab of WS_MSG_BATCH objects is carved
+    out. Slabs are never returned, so resident memory is bounded by the
+    peak backlog.
+
+  Counters are kept per thread and folded into the globals once per batch,
+  so the status page numbers lag by at most a batch per thread.
+*/
+#define WS_MSG_NCLASSES 4
+#define WS_MSG_BATCH 32
+#define WS_MSG_CACHE_MAX (2 * WS_MSG_BATCH)
+/* class 0 is header only, for messages that reference a pktbuf */
+static int const ws_msg_class_size[WS_MSG_NCLASSES] = { 0, 256, 2048, 8192 };
+
+static struct {
+  pthread_mutex_t mutex;
+  struct ws_msg *free;
+  int count;
+} ws_msg_depot[WS_MSG_NCLASSES] = {
+  { PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+  { PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+  { PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+  { PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+};
+
+struct ws_msg_cache {
+  struct ws_msg *free[WS_MSG_NCLASSES];
+  int count[WS_MSG_NCLASSES];
+  unsigned long allocs;         /* not yet folded into ws_msg_allocs */
+  unsigned long hits;           /* allocations that did not call malloc */
+  bool registered;
+};
+static __thread struct ws_msg_cache ws_msg_cache;
+static pthread_key_t ws_msg_cache_key;
+static pthread_once_t ws_msg_cache_once = PTHREAD_ONCE_INIT;
+
+static atomic_ulong ws_msg_allocs;
+static atomic_ulong ws_msg_hits;
+static atomic_ulong ws_msg_resident;
+
+static size_t ws_msg_obj_size(int cls)
+{
+  /* keep objects cache line aligned within a slab */
+  return (sizeof(struct ws_msg) + ws_msg_class_size[cls] + 63) & ~(size_t)63;
+}
+
+static void ws_msg_cache_fold(struct ws_msg_cache *c)
+{
+  atomic_fetch_add_explicit(&ws_msg_allocs, c->allocs, memory_order_relaxed);
+  atomic_fetch_add_explicit(&ws_msg_hits, c->hits, memory_order_relaxed);
+  c->allocs = c->hits = 0;
+}
+
+/* Move up to n objects from the cache back to the depot */
+static void ws_msg_cache_spill(struct ws_msg_cache *c, int cls, int n)
+{
+  struct ws_msg *head = c->free[cls];
+  struct ws_msg *tail = head;
+  int moved = 1;
+  if (head == NULL)
+    return;
+  while (moved < n && tail->next) {
+    tail = tail->next;
+    moved++;
   }
-  pthread_cond_signal(&sp->out_cond);
-  pthread_mutex_unlock(&sp->out_mutex);
+  c->free[cls] = tail->next;
+  c->count[cls] -= moved;
+  pthread_mutex_lock(&ws_msg_depot[cls].mutex);
+  tail->next = ws_msg_depot[cls].free;
+  ws_msg_depot[cls].free = head;
+  ws_msg_depot[cls].count += moved;
+  pthread_mutex_unlock(&ws_msg_depot[cls].mutex);
 }
 
-/* Free any queued outgoing messages (caller must ensure writer not running). */
-static void free_out_queue(struct session *sp)
+/* pthread key destructor: hand a dying thread's cache back to the depot */
+static void ws_msg_cache_release(void *arg)
 {
-  pthread_mutex_lock(&sp->out_mutex);
-  struct ws_msg *m = sp->out_head;
-  sp->out_head = sp->out_tail = NULL;
-  pthread_mutex_unlock(&sp->out_mutex);
-  while (m) {
-    struct ws_msg *n = m->next;
-    if (m->data) free(m->data);
-    free(m);
-    m = n;
+  struct ws_msg_cache *c = arg;
+  for (int cls = 0; cls < WS_MSG_NCLASSES; cls++)
+    ws_msg_cache_spill(c, cls, c->count[cls]);
+  ws_msg_cache_fold(c);
+}
+
+static void ws_msg_cache_key_init(void)
+{
+  pthread_key_create(&ws_msg_cache_key, ws_msg_cache_release);
+}
+
+static struct ws_msg_cache *ws_msg_cache_self(void)
+{
+  struct ws_msg_cache *c = &ws_msg_cache;
+  if (!c->registered) {
+    pthread_once(&ws_msg_cache_once, ws_msg_cache_key_init);
+    pthread_setspecific(ws_msg_cache_key, c);
+    c->registered = true;
   }
+  return c;
 }
 
-/* Writer thread: pop messages and perform websocket writes. */
-static void *session_writer_thread(void *arg)
+/* Refill an empty cache from the depot, growing a slab when it is empty too.
+   Returns false when memory is exhausted. */
+static bool ws_msg_cache_refill(struct ws_msg_cache *c, int cls)
 {
-  struct session *sp = (struct session *)arg;
-  while (1) {
-    pthread_mutex_lock(&sp->out_mutex);
-    while (sp->out_head == NULL && sp->writer_running) {
-      pthread_cond_wait(&sp->out_cond, &sp->out_mutex);
-    }
-    struct ws_msg *m = sp->out_head;
-    if (m) {
-      sp->out_head = m->next;
-      if (sp->out_head == NULL) sp->out_tail = NULL;
+  pthread_mutex_lock(&ws_msg_depot[cls].mutex);
+  struct ws_msg *head = ws_msg_depot[cls].free;
+  if (head != NULL) {
+    struct ws_msg *tail = head;
+    int moved = 1;
+    while (moved < WS_MSG_BATCH && tail->next) {
+      tail = tail->next;
+      moved++;
+    }
+    ws_msg_depot[cls].free = tail->next;
+    ws_msg_depot[cls].count -= moved;
+    pthread_mutex_unlock(&ws_msg_depot[cls].mutex);
+    tail->next = NULL;
+    c->free[cls] = head;
+    c->count[cls] = moved;
+    return true;
+  }
+  pthread_mutex_unlock(&ws_msg_depot[cls].mutex);
+
+  size_t const obj = ws_msg_obj_size(cls);
+  uint8_t *slab = malloc(obj * WS_MSG_BATCH);
+  if (slab == NULL)
+    return false;
+  atomic_fetch_add_explicit(&ws_msg_resident, obj * WS_MSG_BATCH, memory_order_relaxed);
+  for (int i = WS_MSG_BATCH - 1; i >= 0; i--) {
+    struct ws_msg *m = (struct ws_msg *)(slab + i * obj);
+    m->pool = cls;
+    m->data = (uint8_t *)(m + 1);
+    m->pb = NULL;
+    m->next = c->free[cls];
+    c->free[cls] = m;
+  }
+  c->count[cls] = WS_MSG_BATCH;
+  c->hits--; /* this allocation paid for a malloc */
+  return true;
+}
+
+/* Allocate a message with room for `size` payload bytes at m->data */
+static struct ws_msg *ws_msg_alloc(int size)
+{
+  struct ws_msg_cache *c = ws_msg_cache_self();
+  int cls = 0;
+  while (cls < WS_MSG_NCLASSES && size > ws_msg_class_size[cls])
+    cls++;
+
+  c->allocs++;
+  if (cls == WS_MSG_NCLASSES) {
+    /* oversize: plain heap allocation */
+    struct ws_msg *m = calloc(1, sizeof(*m));
+    if (m == NULL)
+      return NULL;
+    m->data = malloc(size);
+    if (m->data == NULL) {
+      free(m);
+      return NULL;
+    }
+    m->pool = -1;
+    return m;
+  }
+  c->hits++;
+  if (c->free[cls] == NULL) {
+    if (!ws_msg_cache_refill(c, cls))
+      return NULL;
+    ws_msg_cache_fold(c);
+  }
+  struct ws_msg *m = c->free[cls];
+  c->free[cls] = m->next;
+  c->count[cls]--;
+  m->next = NULL;
+  return m;
+}
+
+static void ws_msg_free(struct ws_msg *m)
+{
+  if (m->pb) {
+    pktbuf_put(m->pb);
+    m->pb = NULL;
+    m->data = (uint8_t *)(m + 1);
+  }
+  if (m->pool < 0) {
+    free(m->data);
+    free(m);
+    return;
+  }
+  struct ws_msg_cache *c = ws_msg_cache_self();
+  int cls = m->pool;
+  m->next = c->free[cls];
+  c->free[cls] = m;
+  if (++c->count[cls] > WS_MSG_CACHE_MAX) {
+    ws_msg_cache_spill(c, cls, WS_MSG_BATCH);
+    ws_msg_cache_fold(c);
+  }
+}
+
+static void ws_msg_pool_stats(unsigned long *allocs, unsigned long *hits, unsigned long *resident)
+{
+  *allocs = atomic_load_explicit(&ws_msg_allocs, memory_order_relaxed);
+  *hits = atomic_load_explicit(&ws_msg_hits, memory_order_relaxed);
+  *resident = atomic_load_explicit(&ws_msg_resident, memory_order_relaxed);
+}
+
+/*
+  Shared packet buffers
+  ---------------------
+  Audio datagrams are received directly into a pktbuf and spectrum frames
+  are built in one, and the very same memory is later handed to sendmsg()
+  by the output engine, with the websocket frame header supplied as a
+  separate iovec. Fanning a packet out to N sessions costs N reference
+  increments and N header-only ws_msg allocations, never a payload copy.
+
+  Buffers are PKTBUF_SIZE bytes, enough for an MTU-sized RTP packet or a
+  spectrum frame of MAX_BINS bins. They are carved from 2 MiB chunks that
+  are backed by huge pages when the system has them reserved (transparent
+  huge pages are requested otherwise), and recycled through a free list.
+  Chunks are never released, so resident memory tracks peak backlog.
+*/
+#define PKTBUF_CHUNK (2UL * 1024 * 1024)
+
+static pthread_mutex_t pktbuf_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pktbuf *pktbuf_free;
+static unsigned long pktbuf_in_use;
+static unsigned long pktbuf_resident;
+
+/* Add a chunk of buffers to the free list. Called with pktbuf_mutex held. */
+static bool pktbuf_grow(void)
+{
+  void *chunk = mmap(NULL, PKTBUF_CHUNK, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (chunk == MAP_FAILED) {
+    chunk = mmap(NULL, PKTBUF_CHUNK, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk == MAP_FAILED) {
+      perror("pktbuf mmap");
+      return false;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(chunk, PKTBUF_CHUNK, MADV_HUGEPAGE);
+#endif
+  }
+  for (size_t off = 0; off + PKTBUF_SIZE <= PKTBUF_CHUNK; off += PKTBUF_SIZE) {
+    struct pktbuf *pb = (struct pktbuf *)((uint8_t *)chunk + off);
+    pb->next = pktbuf_free;
+    pktbuf_free = pb;
+  }
+  pktbuf_resident += PKTBUF_CHUNK;
+  return true;
+}
+
+/* Get an empty buffer holding one reference, or NULL */
+static struct pktbuf *pktbuf_alloc(void)
+{
+  pthread_mutex_lock(&pktbuf_mutex);
+  if (pktbuf_free == NULL && !pktbuf_grow()) {
+    pthread_mutex_unlock(&pktbuf_mutex);
+    return NULL;
+  }
+  struct pktbuf *pb = pktbuf_free;
+  pktbuf_free = pb->next;
+  pktbuf_in_use++;
+  pthread_mutex_unlock(&pktbuf_mutex);
+  pb->next = NULL;
+  pb->recv_ns = 0;
+  atomic_store_explicit(&pb->refs, 1, memory_order_relaxed);
+  return pb;
+}
+
+static void pktbuf_put(struct pktbuf *pb)
+{
+  if (atomic_fetch_sub_explicit(&pb->refs, 1, memory_order_acq_rel) != 1)
+    return;
+  pthread_mutex_lock(&pktbuf_mutex);
+  pb->next = pktbuf_free;
+  pktbuf_free = pb;
+  pktbuf_in_use--;
+  pthread_mutex_unlock(&pktbuf_mutex);
+}
+
+static void pktbuf_stats(unsigned long *in_use, unsigned long *resident)
+{
+  pthread_mutex_lock(&pktbuf_mutex);
+  *in_use = pktbuf_in_use;
+  *resident = pktbuf_resident;
+  pthread_mutex_unlock(&pktbuf_mutex);
+}
+
+static void ws_msg_free_list(struct ws_msg *m)
+{
+  while (m) {
+    struct ws_msg *n = m->next;
+    ws_msg_free(m);
+    m = n;
+  }
+}
+
+/*
+  enqueue_ws_message
+  ------------------
+  Queue a message for the session's writer (output engine or writer thread).
+  Caller may be any thread.
+
+  Each message class has a bounded queue with its own policy, so a client
+  that cannot keep up loses stale frames rather than accumulating seconds
+  of backlog until the watchdog disconnects it:
+    - CONTROL goes on an unbounded FIFO and is never dropped; it only
+      carries short, infrequent text replies.
+    - STATUS and SPECTRUM replace whatever frame is still waiting in their
+      one-slot mailbox; only the newest frame is worth drawing.
+    - AUDIO goes into a fixed ring; when the ring is full the oldest packet
+      is dropped. Packets that exceed the latency budget are dropped when
+      the writer reaches them (see ws_out_pop()).
+  Every replaced or discarded message is counted in sp->out_drops[class].
+*/
+static void enqueue_ws_message(struct session *sp, const uint8_t *buf, int size, int is_text, enum ws_class cls)
+{
+  struct ws_msg *m = ws_msg_alloc(size);
+  if (!m) return;
+  memcpy(m->data, buf, size);
+  m->size = size;
+  m->is_text = is_text;
+  m->cls = is_text ? WS_CLASS_CONTROL : cls;
+  ws_msg_queue(sp, m);
+}
+
+/*
+  Frame latency histograms
+  ------------------------
+  Every outgoing frame carries the time its source datagram came off the
+  multicast socket (stamped once per recvmmsg() batch, kept in the pktbuf),
+  the time it was queued and the time the writer took it. When the last
+  byte is handed to the socket ws_out_done() records the ingest, queue,
+  write and total stages for the frame's class in two places: the session's
+  own histograms, which only the thread writing that session updates, and
+  one of LAT_SHARDS global copies picked per recording thread, so writers
+  never share a cache line on the hot path. Readers sum the shards.
+
+  Buckets are HDR-style: exact below 8 us, then 8 per power of two, so a
+  percentile is reported within 12.5% with 240 counters per histogram.
+*/
+static struct lat_hist Latency[LAT_SHARDS][WS_NCLASSES][LAT_NSTAGES];
+static atomic_int latency_nshards;
+static __thread int latency_shard = -1;
+static char const *const lat_stage_names[LAT_NSTAGES] = { "ingest", "queue", "write", "total" };
+static char const *const lat_class_names[WS_NCLASSES] = { "control", "status", "audio", "spectrum" };
+
+static int latency_bucket(uint64_t us)
+{
+  if (us < LAT_SUB)
+    return (int)us;
+  if (us >> (LAT_MAX_EXP + 1))
+    return LAT_BUCKETS - 1;
+  int const e = 63 - __builtin_clzll(us);
+  return (e - LAT_SUB_BITS + 1) * LAT_SUB + (int)((us >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1));
+}
+
+/* Highest value (us) that falls into bucket `b` */
+static uint64_t latency_bucket_top(int b)
+{
+  if (b < LAT_SUB)
+    return (uint64_t)b;
+  int const e = b / LAT_SUB + LAT_SUB_BITS - 1;
+  uint64_t const sub = (uint64_t)(b % LAT_SUB);
+  return ((LAT_SUB + sub + 1) << (e - LAT_SUB_BITS)) - 1;
+}
+
+/* Record a sent frame's stages; called by the thread that wrote it */
+static void latency_record(struct session *sp, struct ws_msg const *m, uint64_t done_ns)
+{
+  if (m->cls == WS_CLASS_CONTROL)
+    return;
+  if (latency_shard < 0)
+    latency_shard = atomic_fetch_add_explicit(&latency_nshards, 1, memory_order_relaxed) % LAT_SHARDS;
+  uint64_t const stage_ns[LAT_NSTAGES] = {
+    m->enq_ns - m->recv_ns, m->pop_ns - m->enq_ns, done_ns - m->pop_ns, done_ns - m->recv_ns,
+  };
+  for (int s = 0; s < LAT_NSTAGES; s++) {
+    int const b = latency_bucket(stage_ns[s] / 1000);
+    /* Shards may be shared once there are more threads than shards */
+    atomic_fetch_add_explicit(&Latency[latency_shard][m->cls][s].count[b], 1, memory_order_relaxed);
+    /* Single writer: no read-modify-write needed */
+    atomic_uint *c = &sp->latency[m->cls][s].count[b];
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1, memory_order_relaxed);
+  }
+}
+
+/* p50/p99/p999 in ms of `nh` summed histograms; false when empty */
+static bool latency_percentiles(struct lat_hist const *h, int nh, int stride, double pct_ms[3])
+{
+  static double const q[3] = { 0.5, 0.99, 0.999 };
+  uint64_t sum[LAT_BUCKETS] = { 0 };
+  uint64_t total = 0;
+  for (int i = 0; i < nh; i++) {
+    struct lat_hist const *hi = h + (size_t)i * stride;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+      uint64_t const c = atomic_load_explicit(&hi->count[b], memory_order_relaxed);
+      sum[b] += c;
+      total += c;
+    }
+  }
+  if (total == 0)
+    return false;
+  int k = 0;
+  uint64_t seen = 0;
+  for (int b = 0; b < LAT_BUCKETS && k < 3; b++) {
+    seen += sum[b];
+    while (k < 3 && (double)seen >= q[k] * (double)total)
+      pct_ms[k++] = (double)latency_bucket_top(b) / 1000.0;
+  }
+  return true;
+}
+
+/* Global percentiles for one class and stage */
+static bool latency_global(enum ws_class cls, enum lat_stage stage, double pct_ms[3])
+{
+  return latency_percentiles(&Latency[0][cls][stage], LAT_SHARDS, WS_NCLASSES * LAT_NSTAGES, pct_ms);
+}
+
+/* Queue a filled-in message according to its class (see enqueue_ws_message) */
+static void ws_msg_queue(struct session *sp, struct ws_msg *m)
+{
+  m->enq_ns = mono_ns();
+  m->enq_ms = (unsigned long)(m->enq_ns / 1000000ULL);
+  /* Frames built by an ingest thread date from the batch it is dispatching */
+  m->recv_ns = m->pb != NULL && m->pb->recv_ns != 0 ? m->pb->recv_ns : ingest_recv_ns != 0 ? ingest_recv_ns : m->enq_ns;
+  m->pop_ns = m->enq_ns;
+  m->next = NULL;
+
+  struct ws_msg *victim = NULL;
+  pthread_mutex_lock(&sp->out_mutex);
+  sp->out_frames++;
+  sp->out_bytes += m->size;
+  switch (m->cls) {
+  case WS_CLASS_STATUS:
+    victim = sp->status_slot;
+    sp->status_slot = m;
+    break;
+  case WS_CLASS_SPECTRUM:
+    victim = sp->spectrum_slot;
+    sp->spectrum_slot = m;
+    break;
+  case WS_CLASS_AUDIO:
+    if (sp->audio_count == WS_AUDIO_RING) {
+      victim = sp->audio_ring[sp->audio_head];
+      sp->audio_head = (sp->audio_head + 1) % WS_AUDIO_RING;
+      sp->audio_count--;
+    }
+    sp->audio_ring[(sp->audio_head + sp->audio_count) % WS_AUDIO_RING] = m;
+    sp->audio_count++;
+    break;
+  default:
+    if (sp->out_tail == NULL) {
+      sp->out_head = sp->out_tail = m;
+    } else {
+      sp->out_tail->next = m;
+      sp->out_tail = m;
+    }
+    break;
+  }
+  if (victim)
+    ws_out_drop_locked(sp, victim);
+  pthread_cond_signal(&sp->out_cond);
+  pthread_mutex_unlock(&sp->out_mutex);
+  ws_msg_free_list(victim);
+
+  if (sp->engine != NULL)
+    ws_engine_kick(sp);
+}
+
+/* True when nothing is queued in any class. Caller holds out_mutex. */
+static bool ws_out_empty(struct session const *sp)
+{
+  return sp->out_head == NULL && sp->audio_count == 0 &&
+    sp->status_slot == NULL && sp->spectrum_slot == NULL;
+}
+
+/* Take the next queued message, or NULL. Control text goes first, then
+   audio (whose value decays fastest), then status and spectrum. Audio that
+   has outlived the latency budget is discarded here. Backlog counters keep
+   counting the returned message until ws_out_done() so partially written
+   frames show up as backlog. */
+static struct ws_msg *ws_out_pop(struct session *sp)
+{
+  struct ws_msg *stale = NULL;
+  pthread_mutex_lock(&sp->out_mutex);
+  struct ws_msg *m = sp->out_head;
+  if (m) {
+    sp->out_head = m->next;
+    if (sp->out_head == NULL) sp->out_tail = NULL;
+  } else {
+    unsigned long now = audio_latency_budget_ms > 0 ? now_ms() : 0;
+    while (sp->audio_count > 0) {
+      m = sp->audio_ring[sp->audio_head];
+      sp->audio_ring[sp->audio_head] = NULL;
+      sp->audio_head = (sp->audio_head + 1) % WS_AUDIO_RING;
+      sp->audio_count--;
+      if (audio_latency_budget_ms == 0 || now - m->enq_ms <= (unsigned long)audio_latency_budget_ms)
+        break;
+      ws_out_drop_locked(sp, m);
+      m->next = stale;
+      stale = m;
+      m = NULL;
+    }
+    if (m == NULL && sp->status_slot) {
+      m = sp->status_slot;
+      sp->status_slot = NULL;
+    }
+    if (m == NULL && sp->spectrum_slot) {
+      m = sp->spectrum_slot;
+      sp->spectrum_slot = NULL;
+    }
+  }
+  if (m) {
+    m->next = NULL;
+    m->pop_ns = mono_ns();
+  }
+  pthread_mutex_unlock(&sp->out_mutex);
+  ws_msg_free_list(stale);
+  return m;
+}
+
+/* Retire a popped message; `sent` is false when it was discarded */
+static void ws_out_done(struct session *sp, struct ws_msg *m, bool sent)
+{
+  if (sent)
+    latency_record(sp, m, mono_ns());
+  pthread_mutex_lock(&sp->out_mutex);
+  sp->out_frames--;
+  sp->out_bytes -= m->size;
+  if (sent) {
+    sp->sent_frames++;
+    sp->sent_bytes += m->size;
+    if (m->cls == WS_CLASS_SPECTRUM) {
+      float const ms = (float)(now_ms() - m->enq_ms);
+      sp->spectrum_write_ms += (ms - sp->spectrum_write_ms) / 4;
+    }
+  }
+  pthread_mutex_unlock(&sp->out_mutex);
+  ws_msg_free(m);
+}
+
+/* Free any queued outgoing messages (caller must ensure no writer is running). */
+static void free_out_queue(struct session *sp)
+{
+  pthread_mutex_lock(&sp->out_mutex);
+  struct ws_msg *m = sp->out_head;
+  sp->out_head = sp->out_tail = NULL;
+  while (sp->audio_count > 0) {
+    struct ws_msg *a = sp->audio_ring[sp->audio_head];
+    sp->audio_ring[sp->audio_head] = NULL;
+    sp->audio_head = (sp->audio_head + 1) % WS_AUDIO_RING;
+    sp->audio_count--;
+    a->next = m;
+    m = a;
+  }
+  struct ws_msg *slots[] = { sp->status_slot, sp->spectrum_slot, sp->out_cur };
+  for (size_t i = 0; i < sizeof(slots) / sizeof(slots[0]); i++) {
+    if (slots[i]) {
+      slots[i]->next = m;
+      m = slots[i];
+    }
+  }
+  sp->status_slot = sp->spectrum_slot = sp->out_cur = NULL;
+  sp->out_frames = 0;
+  sp->out_bytes = 0;
+  pthread_mutex_unlock(&sp->out_mutex);
+  ws_msg_free_list(m);
+}
+
+/* The websocket went away under a write: stop streaming to this session and
+   detach the websocket so ctrl_thread reaps the session on its next status
+   packet. Called with sp->ws_mutex held. The spectrum scheduler drops the
+   session at its next due time. Avoids sending RADIO_FREQUENCY=0, which
+   affects global backend state. */
+static void session_ws_failed(struct session *sp)
+{
+  sp->audio_active = false;
+  if (sp->spectrum_active) {
+    pthread_mutex_lock(&sp->spectrum_mutex);
+    sp->spectrum_active = false;
+    pthread_mutex_unlock(&sp->spectrum_mutex);
+    stop_spectrum_stream(sp);
+  }
+  sp->spectrum_requested_by_client = false;
+  sp->spectrum_restart_attempts = 0;
+  sp->last_spectrum_restart_ms = 0;
+  sp->write_in_progress = false;
+  sp->ws = NULL;
+  sp->ws_fd = -1;
+}
+
+/*
+  Websocket output engine
+  -----------------------
+  A small pool of threads (sized to the core count) owns the non-blocking
+  client sockets of every session whose fd libonion exposes. Each engine runs
+  one epoll loop:
+
+  - enqueue_ws_message() appends to the session queue and puts the session on
+    its engine's ready list (waking the engine through an eventfd).
+  - The engine writes queued frames itself: it builds the websocket frame
+    header (server frames are unmasked) and sends header and payload with one
+    gather write. A short write or EAGAIN leaves the frame in `out_cur` with
+    its offset; the fd is registered edge-triggered for EPOLLOUT and the frame
+    is resumed when the socket drains. No thread ever blocks on a client.
+  - While a session is stalled on EAGAIN `write_in_progress` and
+    `last_write_start_ms` are set, so ws_watchdog_thread still recognizes a
+    dead client.
+  - delete_session() only flags the session and kicks the engine, which
+    unregisters the fd and drops its references from its own thread.
+
+  Writing frames straight to the fd assumes a plain (non-TLS) listener, which
+  is how ka9q-web runs libonion.
+*/
+struct ws_engine {
+  pthread_t task;
+  int epfd;
+  int wakefd;
+  pthread_mutex_t mutex;
+  struct session *ready_head;  /* sessions with queued output; each holds a reference */
+  struct session *ready_tail;
+  int nsessions;
+};
+
+#define WS_ENGINE_MAX 8
+static struct ws_engine ws_engines[WS_ENGINE_MAX];
+static int ws_nengines = 0;
+
+static int ws_frame_header(uint8_t *h, int is_text, size_t len)
+{
+  h[0] = 0x80 | (is_text ? 0x1 : 0x2); /* FIN + opcode */
+  if (len < 126) {
+    h[1] = (uint8_t)len;
+    return 2;
+  }
+  if (len < 65536) {
+    h[1] = 126;
+    h[2] = (uint8_t)(len >> 8);
+    h[3] = (uint8_t)len;
+    return 4;
+  }
+  h[1] = 127;
+  for (int i = 0; i < 8; i++)
+    h[2 + i] = (uint8_t)(len >> (56 - 8 * i));
+  return 10;
+}
+
+/* Queue `sp` for service by its engine; any thread */
+static void ws_engine_kick(struct session *sp)
+{
+  struct ws_engine *e = sp->engine;
+  bool wake = false;
+  pthread_mutex_lock(&e->mutex);
+  if (!sp->ready_queued) {
+    session_get(sp);
+    sp->ready_queued = true;
+    sp->ready_next = NULL;
+    if (e->ready_tail)
+      e->ready_tail->ready_next = sp;
+    else
+      e->ready_head = sp;
+    e->ready_tail = sp;
+    wake = true;
+  }
+  pthread_mutex_unlock(&e->mutex);
+  if (wake) {
+    uint64_t one = 1;
+    if (write(e->wakefd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+      perror("ws_engine: eventfd write");
+  }
+}
+
+static void ws_engine_attach(struct session *sp)
+{
+  struct ws_engine *e = &ws_engines[0];
+  for (int i = 1; i < ws_nengines; i++) {
+    if (ws_engines[i].nsessions < e->nsessions)
+      e = &ws_engines[i];
+  }
+  pthread_mutex_lock(&e->mutex);
+  e->nsessions++;
+  pthread_mutex_unlock(&e->mutex);
+  sp->engine_fd = -1;
+  sp->engine = e;
+}
+
+static void ws_engine_detach(struct session *sp)
+{
+  struct ws_engine *e = sp->engine;
+  pthread_mutex_lock(&e->mutex);
+  sp->engine_detach = true;
+  e->nsessions--;
+  pthread_mutex_unlock(&e->mutex);
+  ws_engine_kick(sp);
+}
+
+/* Stop watching sp's fd and drop the reference epoll held (engine thread) */
+static void ws_engine_unregister(struct ws_engine *e, struct session *sp)
+{
+  if (sp->engine_fd < 0)
+    return;
+  /* The fd may already be closed (and removed from the set) by libonion */
+  epoll_ctl(e->epfd, EPOLL_CTL_DEL, sp->engine_fd, NULL);
+  sp->engine_fd = -1;
+  session_put(sp);
+}
+
+/* Write as much queued output for `sp` as the socket accepts (engine thread) */
+static void ws_engine_flush(struct ws_engine *e, struct session *sp)
+{
+  if (sp->engine_detach) {
+    if (sp->out_cur) {
+      ws_out_done(sp, sp->out_cur, false);
+      sp->out_cur = NULL;
+    }
+    ws_engine_unregister(e, sp);
+    return;
+  }
+
+  pthread_mutex_lock(&sp->ws_mutex);
+  int const fd = (sp->ws != NULL) ? sp->ws_fd : -1;
+  if (fd != sp->engine_fd) {
+    /* New socket (reattach) or websocket gone: a partially written frame
+       cannot be continued on another connection. */
+    if (sp->out_cur) {
+      ws_out_done(sp, sp->out_cur, false);
+      sp->out_cur = NULL;
+    }
+    bool had_ref = sp->engine_fd >= 0;
+    if (had_ref) {
+      epoll_ctl(e->epfd, EPOLL_CTL_DEL, sp->engine_fd, NULL);
+      sp->engine_fd = -1;
+    }
+    if (fd >= 0) {
+      struct epoll_event ev;
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLOUT | EPOLLET;
+      ev.data.ptr = sp;
+      if (epoll_ctl(e->epfd, EPOLL_CTL_ADD, fd, &ev) == -1 && errno != EEXIST) {
+        perror("ws_engine: epoll_ctl ADD");
+      } else {
+        sp->engine_fd = fd;
+        if (!had_ref)
+          session_get(sp);
+      }
+    }
+    if (had_ref && sp->engine_fd < 0)
+      session_put(sp); /* sp stays alive: the caller holds a reference */
+  }
+  if (fd < 0) {
+    /* Nowhere to write: discard what was queued */
+    struct ws_msg *m;
+    while ((m = ws_out_pop(sp)) != NULL)
+      ws_out_done(sp, m, false);
+    pthread_mutex_unlock(&sp->ws_mutex);
+    return;
+  }
+
+  for (;;) {
+    if (sp->out_cur == NULL) {
+      sp->out_cur = ws_out_pop(sp);
+      if (sp->out_cur == NULL)
+        break;
+      sp->out_cur_hdr_len = ws_frame_header(sp->out_cur_hdr, sp->out_cur->is_text, sp->out_cur->size);
+      sp->out_cur_off = 0;
+    }
+    struct ws_msg *m = sp->out_cur;
+    size_t const hlen = sp->out_cur_hdr_len;
+    struct iovec iov[2];
+    int iovcnt = 0;
+    if (sp->out_cur_off < hlen) {
+      iov[iovcnt].iov_base = sp->out_cur_hdr + sp->out_cur_off;
+      iov[iovcnt].iov_len = hlen - sp->out_cur_off;
+      iovcnt++;
+      iov[iovcnt].iov_base = m->data;
+      iov[iovcnt].iov_len = m->size;
+      iovcnt++;
+    } else {
+      iov[iovcnt].iov_base = m->data + (sp->out_cur_off - hlen);
+      iov[iovcnt].iov_len = m->size - (sp->out_cur_off - hlen);
+      iovcnt++;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        /* Socket full: resume on EPOLLOUT. Mark the stall for the watchdog. */
+        if (!sp->write_in_progress) {
+          sp->last_write_start_ms = now_ms();
+          sp->write_in_progress = true;
+        }
+        pthread_mutex_unlock(&sp->ws_mutex);
+        return;
+      }
+      fprintf(stderr, "%s: send failed on ssrc=%u: %s, cleaning session\n", __FUNCTION__, sp->ssrc, strerror(errno));
+      ws_out_done(sp, m, false);
+      sp->out_cur = NULL;
+      session_ws_failed(sp);
+      pthread_mutex_unlock(&sp->ws_mutex);
+      ws_engine_unregister(e, sp);
+      return;
+    }
+    sp->out_cur_off += n;
+    /* A slow client that is still draining is not stuck: the watchdog
+       measures time without progress, the spectrum rate adapts instead */
+    if (sp->write_in_progress)
+      sp->last_write_start_ms = now_ms();
+    if (sp->out_cur_off == hlen + m->size) {
+      ws_out_done(sp, m, true);
+      sp->out_cur = NULL;
+    }
+  }
+  sp->write_in_progress = false;
+  pthread_mutex_unlock(&sp->ws_mutex);
+}
+
+static void *ws_engine_thread(void *arg)
+{
+  struct ws_engine *e = (struct ws_engine *)arg;
+  struct epoll_event events[64];
+  for (;;) {
+    int n = epoll_wait(e->epfd, events, sizeof(events) / sizeof(events[0]), -1);
+    if (n < 0) {
+      if (errno != EINTR)
+        perror("ws_engine: epoll_wait");
+      continue;
+    }
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.ptr == NULL) {
+        uint64_t v;
+        if (read(e->wakefd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+          perror("ws_engine: eventfd read");
+        continue;
+      }
+      /* Registered sessions are kept alive by the reference epoll holds;
+         only this thread drops it, so the pointer is valid here. Pin it
+         while flushing since the flush may unregister it. */
+      struct session *sp = (struct session *)events[i].data.ptr;
+      session_get(sp);
+      ws_engine_flush(e, sp);
+      session_put(sp);
+    }
+    pthread_mutex_lock(&e->mutex);
+    struct session *sp = e->ready_head;
+    e->ready_head = e->ready_tail = NULL;
+    for (struct session *r = sp; r != NULL; r = r->ready_next)
+      r->ready_queued = false;
+    pthread_mutex_unlock(&e->mutex);
+    while (sp != NULL) {
+      struct session *next = sp->ready_next;
+      ws_engine_flush(e, sp);
+      session_put(sp);
+      sp = next;
+    }
+  }
+  return NULL;
+}
+
+/* Start the output engines; one per core, at most WS_ENGINE_MAX */
+static int ws_engine_start(void)
+{
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int n = ncpu > 0 ? (int)ncpu : 1;
+  if (n > WS_ENGINE_MAX)
+    n = WS_ENGINE_MAX;
+  for (int i = 0; i < n; i++) {
+    struct ws_engine *e = &ws_engines[i];
+    memset(e, 0, sizeof(*e));
+    pthread_mutex_init(&e->mutex, NULL);
+    e->epfd = epoll_create1(EPOLL_CLOEXEC);
+    e->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (e->epfd == -1 || e->wakefd == -1) {
+      perror("ws_engine: epoll/eventfd");
+      break;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(e->epfd, EPOLL_CTL_ADD, e->wakefd, &ev) == -1) {
+      perror("ws_engine: epoll_ctl wakefd");
+      break;
+    }
+    if (pthread_create(&e->task, NULL, ws_engine_thread, e) != 0) {
+      perror("pthread_create: ws_engine_thread");
+      break;
+    }
+    char buff[16];
+    snprintf(buff, sizeof(buff), "ws_out%d", i);
+    pthread_setname_np(e->task, buff);
+    ws_nengines++;
+  }
+  return ws_nengines > 0 ? 0 : -1;
+}
+
+/* Writer thread for sessions whose socket fd libonion does not expose:
+   pop messages and perform blocking websocket writes. */
+static void *session_writer_thread(void *arg)
+{
+  struct session *sp = (struct session *)arg;
+  while (1) {
+    pthread_mutex_lock(&sp->out_mutex);
+    while (ws_out_empty(sp) && sp->writer_running) {
+      pthread_cond_wait(&sp->out_cond, &sp->out_mutex);
     }
     int running = sp->writer_running;
     pthread_mutex_unlock(&sp->out_mutex);
+    struct ws_msg *m = ws_out_pop(sp);
 
     if (!m) {
       if (!running) break;
@@ -3147,7 +6943,7 @@ static void *session_writer_thread(void *arg)
     pthread_mutex_lock(&sp->ws_mutex);
     if (sp->ws == NULL) {
       pthread_mutex_unlock(&sp->ws_mutex);
-      free(m->data); free(m);
+      ws_out_done(sp, m, false);
       continue;
     }
     if (m->is_text)
@@ -3155,151 +6951,420 @@ static void *session_writer_thread(void *arg)
     else
       onion_websocket_set_opcode(sp->ws, OWS_BINARY);
 
-    /* Before performing a blocking write, poll the underlying socket for
-       writability with a short timeout. This avoids blocking indefinitely
-       inside `onion_websocket_write()` when the network is stalled. If we
-       cannot obtain the fd or poll reports an error/timeout, treat as a
-       write failure and clean up the session. */
-    if (sp->ws_fd >= 0) {
-      struct pollfd pfd;
-      pfd.fd = sp->ws_fd;
-      pfd.events = POLLOUT;
-      int const timeout_ms = 500; /* match watchdog threshold */
-      int pres = poll(&pfd, 1, timeout_ms);
-      if (pres <= 0) {
-        /* timeout or error: consider write stuck and clean session */
-        fprintf(stderr, "%s: poll timeout/error (%d) on ssrc=%u, cleaning session\n", __FUNCTION__, pres, sp->ssrc);
-        /* Do not tell the backend to tune to 0 here; that causes other
-           clients to receive BFREQ=0 and lose audio. */
-        // control_set_frequency(sp, "0");
-        sp->audio_active = false;
-        pthread_t spectrum_join = 0;
-        if (sp->spectrum_active) {
-          pthread_mutex_lock(&sp->spectrum_mutex);
-          sp->spectrum_active = false;
-          stop_spectrum_stream(sp);
-          spectrum_join = sp->spectrum_task;
-          pthread_mutex_unlock(&sp->spectrum_mutex);
-        }
-        sp->spectrum_requested_by_client = false;
-        sp->spectrum_restart_attempts = 0;
-        sp->last_spectrum_restart_ms = 0;
-        sp->ws = NULL;
-        sp->ws_fd = -1;
-        pthread_mutex_unlock(&sp->ws_mutex);
-        if (spectrum_join) pthread_join(spectrum_join, NULL);
-        free(m->data); free(m);
-        break;
-      }
-    }
-
     sp->write_in_progress = true;
     sp->last_write_start_ms = now_ms();
     int r = onion_websocket_write(sp->ws, (char *)m->data, m->size);
     sp->write_in_progress = false;
     if (r <= 0) {
       fprintf(stderr, "%s: onion_websocket_write returned %d for ssrc=%u, cleaning session\n", __FUNCTION__, r, sp->ssrc);
-      /* On failure, perform cleanup similar to prior helpers. Avoid sending
-         RADIO_FREQUENCY=0 which affects global backend state. */
-      // control_set_frequency(sp, "0");
-      sp->audio_active = false;
-      pthread_t spectrum_join = 0;
-      if (sp->spectrum_active) {
-        pthread_mutex_lock(&sp->spectrum_mutex);
-        sp->spectrum_active = false;
-        stop_spectrum_stream(sp);
-        spectrum_join = sp->spectrum_task;
-        pthread_mutex_unlock(&sp->spectrum_mutex);
-      }
-      sp->spectrum_requested_by_client = false;
-      sp->spectrum_restart_attempts = 0;
-      sp->last_spectrum_restart_ms = 0;
-      sp->ws = NULL;
-      sp->ws_fd = -1;
+      session_ws_failed(sp);
       pthread_mutex_unlock(&sp->ws_mutex);
-      if (spectrum_join) pthread_join(spectrum_join, NULL);
-      free(m->data); free(m);
+      ws_out_done(sp, m, false);
       /* After a failed write we break out and allow deletion to proceed */
       break;
     }
     pthread_mutex_unlock(&sp->ws_mutex);
-    free(m->data); free(m);
+    ws_out_done(sp, m, true);
   }
   return NULL;
 }
 
-/* Helper: scan TLV buffer for presence of a type without fully decoding */
-static bool tlv_has_type(uint8_t const *buf, int len, enum status_type want)
+/*
+  process_spectrum_packet
+  ------------------------
+  Handle an incoming spectrum STATUS packet for a spectrum view and forward a packed
+  spectrum RTP payload to the web browser client of every subscriber.
+
+  - Inputs: `subs`/`nsubs` are the referenced subscribers of the view whose backend
+    channel is `ssrc`; `idx` indexes the TLVs of the received STATUS payload.
+  - Steps performed:
+      1) Decode the `Frontend`/`Channel` fields the frame header needs
+         (`spectrum_status_fields`) with `decode_radio_status_index()`.
+      2) Call `extract_powers()` once (with `ssrc` and the first subscriber) to decode
+         BIN_DATA/BIN_BYTE_DATA into a float `powers[]` array.
+      3) Copy the decoded per-channel values (min/max dB, IF power) to the other
+         subscribers.
+      4) Quantize the bins once for each code width the subscribers negotiated
+         (`spectrum_quantize()`), then give every subscriber a frame in a shared
+         packet buffer (`struct pktbuf`) with its own header and a copy of the codes.
+      5) Queue every frame by reference via `send_ws_pktbuf_to_session()`.
+*/
+
+/*
+  Spectrum frame formats
+  ----------------------
+  Both formats start with the RTP header and the same metadata block (see
+  spectrum_frame_header()), whose last two floats are the base and step of
+  the bin codes that follow: a bin's level is base + step * code dB.
+
+  v1 (payload type 0x7F) is what every client gets unless it asks otherwise:
+  one byte per bin. v2 (payload type 0x7D) is negotiated per session with
+  `Q:<bits>`, bits being 4, 8 or 16 (`Q:0` goes back to v1). Its metadata is
+  followed by a version byte (SPECTRUM_FRAME_VERSION), the code width in bits
+  and the number of codes (16-bit little-endian; fewer than `bins` when the
+  client asked for bin reduction), then the codes: 4-bit codes packed two to
+  a byte, high nibble first; 16-bit codes little-endian.
+
+  The scale is chosen per frame. BIN_BYTE_DATA codes already come with
+  radiod's SPECTRUM_BASE/SPECTRUM_STEP and go out unchanged at 8 and 16 bits;
+  for 4 bits the codes actually present are divided into 16 levels. BIN_DATA
+  powers are floats, and their measured min/max (bins_min_db/bins_max_db)
+  are spread over the full code range, so the browser recovers dB to within
+  half a step. At 4 bits a frame is about half the size of a v1 frame.
+*/
+#define SPECTRUM_FRAME_VERSION 2
+#define SPECTRUM_CODE_CACHE 8 /* distinct encodings made per frame */
+
+/*
+  Bin reduction
+  -------------
+  A client that draws the spectrum on fewer pixels than there are bins can
+  send `D:<px>[:max|mean|min]` (`D:0` for full resolution), and its frames
+  then carry `px` codes instead of `bins`, so the resolution it would throw
+  away is not sent. It resends the width whenever its canvas is resized.
+  Output pixel j covers input bins lo[j] .. lo[j+1]-1, lo[j] = j*n/px;
+  each covers g = n/px bins, some one more. Max-pooling (the default) keeps
+  narrow carriers visible; mean and min give a smoother or a noise-floor
+  view. The kernel walks all pixels once per bin offset so the loops over
+  pixels vectorize (gathers on AVX2), then folds in the extra bins.
+*/
+static SPECTRUM_KERNEL_CLONES void spectrum_reduce(float *restrict out, float const *restrict in, int n, int px, enum spectrum_reduce mode)
 {
-  uint8_t const *cp = buf;
-  uint8_t const *end = buf + len;
-  while(cp < end){
-    enum status_type type = *cp++;
-    if(type == EOL)
-      break;
-    if(cp >= end)
-      break;
-    unsigned int optlen = *cp++;
-    if(optlen & 0x80){
-      int length_of_length = optlen & 0x7f;
-      optlen = 0;
-      if(cp + length_of_length > end)
-        break;
-      while(length_of_length > 0){
-        optlen <<= 8;
-        optlen |= *cp++;
-        length_of_length--;
+  int lo[MAX_BINS + 1];
+  int const g = n / px;
+
+  for (int j = 0; j <= px; j++)
+    lo[j] = (int)((int64_t)j * n / px);
+  for (int j = 0; j < px; j++)
+    out[j] = in[lo[j]];
+
+  switch (mode) {
+  case SPECTRUM_REDUCE_MIN:
+    for (int k = 1; k < g; k++)
+      for (int j = 0; j < px; j++)
+        out[j] = in[lo[j] + k] < out[j] ? in[lo[j] + k] : out[j];
+    for (int j = 0; j < px; j++)
+      if (lo[j + 1] - lo[j] > g)
+        out[j] = in[lo[j] + g] < out[j] ? in[lo[j] + g] : out[j];
+    break;
+  case SPECTRUM_REDUCE_MEAN:
+    for (int k = 1; k < g; k++)
+      for (int j = 0; j < px; j++)
+        out[j] += in[lo[j] + k];
+    for (int j = 0; j < px; j++) {
+      if (lo[j + 1] - lo[j] > g)
+        out[j] += in[lo[j] + g];
+      out[j] /= (float)(lo[j + 1] - lo[j]);
+    }
+    break;
+  default:
+    for (int k = 1; k < g; k++)
+      for (int j = 0; j < px; j++)
+        out[j] = in[lo[j] + k] > out[j] ? in[lo[j] + k] : out[j];
+    for (int j = 0; j < px; j++)
+      if (lo[j + 1] - lo[j] > g)
+        out[j] = in[lo[j] + g] > out[j] ? in[lo[j] + g] : out[j];
+    break;
+  }
+}
+
+struct spectrum_codes {
+  int bits;             /* code width; 0 until encoded */
+  int px;               /* bin reduction width, 0 = none */
+  enum spectrum_reduce reduce;
+  int count;            /* codes in data[] */
+  int len;              /* bytes in data[] */
+  float base;           /* dB of code 0 */
+  float step;           /* dB per code */
+  uint8_t data[2 * MAX_BINS];
+};
+
+/* Quantize `n` bins to `bits`-wide codes. With `byte_codes` the bins are
+   radiod codes on the scale `in_base`/`in_step`, otherwise dB values that lie
+   between `min_db` and `max_db`. */
+static void spectrum_quantize(struct spectrum_codes *q, int bits, float const *powers, int n,
+                              bool byte_codes, float in_base, float in_step, float min_db, float max_db)
+{
+  int const top = (1 << bits) - 1;
+  float scale;  /* codes per input unit */
+  float origin; /* input value of code 0 */
+
+  if (byte_codes) {
+    int cmin = 255, cmax = 0;
+    int div = 1;
+    if (bits < 8) {
+      for (int i = 0; i < n; i++) {
+        int const c = (int)powers[i];
+        cmin = c < cmin ? c : cmin;
+        cmax = c > cmax ? c : cmax;
       }
+      if (cmin > cmax)
+        cmin = cmax = 0;
+      div = (cmax - cmin + top - 1) / top;
+      if (div < 1)
+        div = 1;
+    } else {
+      cmin = 0;
     }
-    if(cp + optlen > end)
+    origin = cmin;
+    scale = 1.0f / div;
+    q->base = in_base + in_step * cmin;
+    q->step = in_step * div;
+  } else {
+    if (!isfinite(min_db) || !isfinite(max_db) || max_db < min_db)
+      min_db = max_db = SPECTRUM_FLOOR_DB;
+    float const range = max_db - min_db;
+    origin = min_db;
+    q->base = min_db;
+    q->step = range > 0 ? range / top : 1.0f;
+    scale = 1.0f / q->step;
+  }
+
+  uint8_t *bp = q->data;
+  for (int i = 0; i < n; i++) {
+    int c = (int)lrintf((powers[i] - origin) * scale);
+    c = c < 0 ? 0 : c > top ? top : c;
+    switch (bits) {
+    case 4:
+      if (i & 1)
+        *bp++ |= (uint8_t)c;
+      else
+        *bp = (uint8_t)(c << 4);
       break;
-    if(type == want)
-      return true;
-    cp += optlen;
+    case 16:
+      *bp++ = (uint8_t)c;
+      *bp++ = (uint8_t)(c >> 8);
+      break;
+    default:
+      *bp++ = (uint8_t)c;
+      break;
+    }
   }
-  return false;
+  if (bits == 4 && (n & 1))
+    bp++;
+  q->count = n;
+  q->bits = bits;
+  q->len = (int)(bp - q->data);
 }
 
 /*
-  process_spectrum_packet
-  ------------------------
-  Handle an incoming spectrum STATUS packet for a given session and forward a packed
-  spectrum RTP payload to the web browser client.
-
-  - Inputs: `sp` is the session (even SSRC); `buffer`/`rx_length` contain the received
-    STATUS TLV payload (the incoming packet carries the spectrum SSRC = `sp->ssrc+1`).
-  - Steps performed:
-      1) Call `decode_radio_status()` to refresh `Frontend`/`Channel` state.
-      2) Build an RTP header and serialize session/frontend metadata into `output_buffer`.
-      3) Call `extract_powers()` (using `sp->ssrc + 1`) to decode BIN_DATA/BIN_BYTE_DATA
-         into a float `powers[]` array.
-      4) Pack the decoded power values into the output buffer and send them to the web
-         browser client via `send_ws_binary_to_session()`.
-  - Notes:
-      * `extract_powers()` / `handle_bin_data()` compute `sp->bins_min_db` and
-        `sp->bins_max_db`, but this function does not perform any automatic
-        rescaling/autoranging of the outgoing payload.
+  Compressed spectrum frames
+  --------------------------
+  A session that sends `X:1` gets its spectrum as compressed frames
+  (payload type 0x7C) instead; `X:0` turns them off and `X:K` asks for a
+  keyframe. Most bins move by a code or two from one frame to the next, so
+  a delta frame carries each code minus the code of the same bin in the
+  previous frame (modulo the code width), and those bytes, being mostly a
+  handful of small values, are then entropy coded with rANS (range
+  asymmetric numeral systems) using a frequency table sent with the frame.
+  If coding does not make the frame smaller it is sent stored.
+
+  A keyframe carries the codes themselves. One is sent on the first frame,
+  every SPECTRUM_KEYFRAME_FRAMES frames, whenever the code width, bin count,
+  center frequency or bin width (zoom) changes, when the client asks for one,
+  and after a frame was dropped from the session's latest-wins spectrum
+  slot, since the browser's reference then differs from ours. Frames are
+  numbered; the browser drops a delta frame that does not follow the frame
+  it decoded last and waits for the next keyframe.
+
+  Layout after the v2 header (all 16-bit fields little-endian):
+    u8 flags (SPECTRUM_DELTA_KEY, SPECTRUM_DELTA_RANS), u8 reserved,
+    u16 frame number, u16 length of the uncoded codes, u16 encode time in µs;
+  then either the uncoded bytes or the rANS stream: u8 symbol count - 1,
+  (u8 symbol, u16 frequency) for each symbol, frequencies summing to
+  1 << SPECTRUM_RANS_BITS, then the 32-bit coder state and its bytes.
 */
-/* Outgoing spectrum RTP packets must carry the spectrum SSRC (sp->ssrc + 1).
-  Using sp->ssrc+1 for spectrum ensures the browser can disambiguate spectrum
-  frames from the audio/status stream when multiple clients are connected. */
-static void process_spectrum_packet(struct session *sp, uint8_t *buffer, int rx_length)
+#define SPECTRUM_KEYFRAME_FRAMES 50
+#define SPECTRUM_DELTA_KEY 1
+#define SPECTRUM_DELTA_RANS 2
+#define SPECTRUM_DELTA_HEADER 8
+#define SPECTRUM_RANS_BITS 12
+#define SPECTRUM_RANS_L (1u << 23)
+
+/* rANS-code `n` bytes of `in` into `out` (at most `cap` bytes); returns the
+   coded length, or -1 when it would not be shorter than `cap` */
+static int spectrum_rans_encode(uint8_t *out, int cap, uint8_t const *in, int n)
 {
-  struct rtp_header rtp;
-  uint8_t output_buffer[PKTSIZE];
-  float powers[PKTSIZE / sizeof(float)];
-  uint64_t time;
-  double r_freq, r_bin_bw;
+  uint32_t const total = 1u << SPECTRUM_RANS_BITS;
+  uint32_t count[256] = {0};
+  uint32_t freq[256], start[256];
+  int nsym = 0;
 
-  /* Update status values early (keeps some fields fresh) */
-  decode_radio_status(&Frontend, &Channel, buffer + 1, rx_length - 1);
-  /* Record that we received a spectrum TLV for this session */
-  sp->last_spectrum_recv_ms = now_ms();
+  if (n <= 0)
+    return -1;
+  for (int i = 0; i < n; i++)
+    count[in[i]]++;
+
+  /* Scale the counts to `total`, keeping every symbol present */
+  uint32_t sum = 0;
+  for (int s = 0; s < 256; s++) {
+    freq[s] = 0;
+    if (count[s] != 0) {
+      freq[s] = (uint32_t)((uint64_t)count[s] * total / (uint32_t)n);
+      if (freq[s] == 0)
+        freq[s] = 1;
+      sum += freq[s];
+      nsym++;
+    }
+  }
+  while (sum != total) {
+    int best = -1;
+    for (int s = 0; s < 256; s++)
+      if (freq[s] != 0 && (best < 0 || freq[s] > freq[best]))
+        best = s;
+    if (sum < total) {
+      freq[best] += total - sum;
+      sum = total;
+    } else {
+      if (freq[best] <= 1)
+        return -1;
+      uint32_t const take = sum - total < freq[best] - 1 ? sum - total : freq[best] - 1;
+      freq[best] -= take;
+      sum -= take;
+    }
+  }
+
+  int const table = 1 + 3 * nsym;
+  if (table + 4 >= cap)
+    return -1;
+  uint8_t *tp = out;
+  *tp++ = (uint8_t)(nsym - 1);
+  uint32_t cum = 0;
+  for (int s = 0; s < 256; s++) {
+    start[s] = cum;
+    if (freq[s] != 0) {
+      *tp++ = (uint8_t)s;
+      *tp++ = (uint8_t)freq[s];
+      *tp++ = (uint8_t)(freq[s] >> 8);
+      cum += freq[s];
+    }
+  }
+
+  /* The coder runs backwards, so the stream is built from the end of
+     `out` towards the table and moved down afterwards */
+  uint8_t *const limit = out + table + 4;
+  uint8_t *ptr = out + cap;
+  uint32_t x = SPECTRUM_RANS_L;
+  for (int i = n - 1; i >= 0; i--) {
+    uint32_t const f = freq[in[i]];
+    uint32_t const x_max = ((SPECTRUM_RANS_L >> SPECTRUM_RANS_BITS) << 8) * f;
+    while (x >= x_max) {
+      if (ptr <= limit)
+        return -1;
+      *--ptr = (uint8_t)x;
+      x >>= 8;
+    }
+    x = ((x / f) << SPECTRUM_RANS_BITS) + (x % f) + start[in[i]];
+  }
+  int const stream = (int)(out + cap - ptr);
+  tp[0] = (uint8_t)x;
+  tp[1] = (uint8_t)(x >> 8);
+  tp[2] = (uint8_t)(x >> 16);
+  tp[3] = (uint8_t)(x >> 24);
+  memmove(tp + 4, ptr, stream);
+  return table + 4 + stream;
+}
+
+/* Build the compressed body of a spectrum frame for `sp` from the codes in
+   `q` at `out` (at most `cap` bytes) and update the session's reference
+   frame; returns the body length */
+static int spectrum_delta_encode(struct session *sp, struct spectrum_codes const *q, uint8_t *out, int cap)
+{
+  struct timespec t0, t1;
+  uint8_t sym[2 * MAX_BINS];
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  pthread_mutex_lock(&sp->out_mutex);
+  uint64_t const drops = sp->out_drops[WS_CLASS_SPECTRUM];
+  pthread_mutex_unlock(&sp->out_mutex);
+
+  /* Taken even when another reason already forces a keyframe, so a
+     request that arrives now is not lost with the flag */
+  bool const key_req = atomic_exchange(&sp->spectrum_key_req, false);
+  bool const key = key_req
+    || sp->spectrum_since_key >= SPECTRUM_KEYFRAME_FRAMES
+    || sp->spectrum_ref_len != q->len
+    || sp->spectrum_ref_bits != q->bits
+    || sp->spectrum_ref_center != sp->center_frequency
+    || sp->spectrum_ref_bin_width != sp->bin_width
+    || sp->spectrum_ref_drops != drops;
+
+  if (key) {
+    memcpy(sym, q->data, q->len);
+    sp->spectrum_since_key = 0;
+    sp->spectrum_keyframes++;
+  } else {
+    uint8_t const *cur = q->data, *ref = sp->spectrum_ref;
+    switch (q->bits) {
+    case 4:
+      for (int i = 0; i < q->len; i++)
+        sym[i] = (uint8_t)((((cur[i] >> 4) - (ref[i] >> 4)) & 0x0f) << 4 | ((cur[i] - ref[i]) & 0x0f));
+      break;
+    case 16:
+      for (int i = 0; i + 1 < q->len; i += 2) {
+        uint16_t const d = (uint16_t)((cur[i] | cur[i + 1] << 8) - (ref[i] | ref[i + 1] << 8));
+        sym[i] = (uint8_t)d;
+        sym[i + 1] = (uint8_t)(d >> 8);
+      }
+      break;
+    default:
+      for (int i = 0; i < q->len; i++)
+        sym[i] = (uint8_t)(cur[i] - ref[i]);
+      break;
+    }
+    sp->spectrum_since_key++;
+  }
+  memcpy(sp->spectrum_ref, q->data, q->len);
+  sp->spectrum_ref_len = q->len;
+  sp->spectrum_ref_bits = q->bits;
+  sp->spectrum_ref_center = sp->center_frequency;
+  sp->spectrum_ref_bin_width = sp->bin_width;
+  sp->spectrum_ref_drops = drops;
+
+  uint8_t *bp = out + SPECTRUM_DELTA_HEADER;
+  int coded = spectrum_rans_encode(bp, q->len < cap - SPECTRUM_DELTA_HEADER ? q->len : cap - SPECTRUM_DELTA_HEADER, sym, q->len);
+  uint8_t flags = key ? SPECTRUM_DELTA_KEY : 0;
+  if (coded > 0) {
+    flags |= SPECTRUM_DELTA_RANS;
+  } else {
+    coded = q->len;
+    memcpy(bp, sym, coded);
+  }
+
+  uint16_t const seq = ++sp->spectrum_seq;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  long const ns = (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec);
+  long const us = ns / 1000 > 0xffff ? 0xffff : ns / 1000;
+  out[0] = flags;
+  out[1] = 0;
+  out[2] = (uint8_t)seq;
+  out[3] = (uint8_t)(seq >> 8);
+  out[4] = (uint8_t)q->len;
+  out[5] = (uint8_t)(q->len >> 8);
+  out[6] = (uint8_t)us;
+  out[7] = (uint8_t)(us >> 8);
+
+  sp->spectrum_raw_bytes += q->len;
+  sp->spectrum_coded_bytes += SPECTRUM_DELTA_HEADER + coded;
+  sp->spectrum_encode_ns += ns;
+  sp->spectrum_coded_frames++;
+  return SPECTRUM_DELTA_HEADER + coded;
+}
+
+/* Write the spectrum RTP header and per-session metadata at the start of `output_buffer`;
+   returns the end of the header. Outgoing spectrum RTP packets carry the session's
+   spectrum SSRC (sp->ssrc + 1) whatever view channel they came from, so the browser
+   can disambiguate spectrum frames from the audio/status stream when multiple
+   clients are connected. `q` supplies the scale of the codes that follow; `type`
+   is the frame format: 0x7F (v1), 0x7D (v2) or 0x7C (compressed v2). */
+static uint8_t *spectrum_frame_header(struct session *sp, uint8_t *output_buffer,
+                                      struct spectrum_codes const *q, uint8_t type)
+{
+  struct rtp_header rtp;
 
   memset(&rtp, 0, sizeof(rtp));
-  rtp.type = 0x7F; /* spectrum data */
+  rtp.type = type; /* spectrum data */
   rtp.version = RTP_VERS;
-  /* Use the spectrum SSRC (sp->ssrc + 1) for outgoing spectrum RTP packets */
   rtp.ssrc = sp->ssrc + 1;
   rtp.marker = true;
   rtp.seq = rtp_seq++;
@@ -3325,71 +7390,151 @@ static void process_spectrum_packet(struct session *sp, uint8_t *buffer, int rx_
   *(float *)ip++ = (float)power2dB(Frontend.if_power);
   *(float *)ip++ = (float)sp->noise_density_audio;
   *ip++ = (uint32_t)sp->zoom_index;
-  /* Use radiod's init_chan defaults if no SPECT2 packet has arrived yet (step==0).
-     This makes placeholder frames visible even before the first real spectrum response. */
-  float const spec_base = (Channel.spectrum.step != 0.0) ? (float)Channel.spectrum.base : -150.0f;
-  float const spec_step = (Channel.spectrum.step != 0.0) ? (float)Channel.spectrum.step :   0.5f;
-  *(float *)ip++ = spec_base;
-  *(float *)ip++ = spec_step;
-
-  int header_size = (uint8_t *)ip - &output_buffer[0];
-  int length = (PKTSIZE - header_size) / sizeof(float);
-
-  /* Scan TLVs to find demod type and bin data presence before attempting decode */
-  uint8_t const *scan = buffer + 1;
-  uint8_t const *end = buffer + rx_length;
-  int found_demod = -1;
-  int found_bin_byte_len = 0;
-  int found_bin_data_len = 0;
-  while (scan < end) {
-    uint8_t t = *scan++;
-    if (t == EOL) break;
-    if (scan >= end) break;
-    unsigned int optlen = *scan++;
-    if (optlen & 0x80) {
-      int length_of_length = optlen & 0x7f;
-      optlen = 0;
-      while (length_of_length > 0 && scan < end) {
-        optlen <<= 8;
-        optlen |= *scan++;
-        length_of_length--;
-      }
-    }
-    if (t == DEMOD_TYPE && scan + optlen <= end) {
-      found_demod = decode_int(scan, optlen);
-    } else if (t == BIN_BYTE_DATA) {
-      found_bin_byte_len = optlen;
-    } else if (t == BIN_DATA) {
-      found_bin_data_len = optlen;
+  *(float *)ip++ = q->base;
+  *(float *)ip++ = q->step;
+
+  bp = (uint8_t *)ip;
+  if (type != 0x7F) {
+    *bp++ = SPECTRUM_FRAME_VERSION;
+    *bp++ = (uint8_t)q->bits;
+    *bp++ = (uint8_t)q->count;
+    *bp++ = (uint8_t)(q->count >> 8);
+  }
+  return bp;
+}
+
+/* Frontend/Channel fields read by spectrum_frame_header() and extract_powers();
+   the rest of a spectrum reply describes the spectrum channel and is not used */
+static enum status_type const spectrum_status_fields[] = {
+  INPUT_SAMPRATE, INPUT_SAMPLES, AD_OVER, SAMPLES_SINCE_OVER, GPS_TIME,
+  RF_AGC, RF_ATTEN, RF_GAIN, RF_LEVEL_CAL, IF_POWER,
+  NOISE_BW, SPECTRUM_BASE, SPECTRUM_STEP, FILTER_BLOCKSIZE, FILTER_FIR_LENGTH,
+};
+
+static void process_spectrum_packet(struct session **subs, int nsubs, uint32_t ssrc, struct tlv_index const *idx)
+{
+  struct session *sp = subs[0];
+  float powers[PKTSIZE / sizeof(float)];
+  uint64_t time;
+  double r_freq, r_bin_bw;
+
+  /* Update status values early (keeps some fields fresh) */
+  decode_radio_status_index(&Frontend, &Channel, idx, spectrum_status_fields,
+                            sizeof(spectrum_status_fields) / sizeof(spectrum_status_fields[0]));
+  /* Record that we received a spectrum TLV for these sessions. A view
+     shared with faster clients produces frames more often than a session's
+     own (adaptive) rate; such a session only gets the frames that are due. */
+  unsigned long const now = now_ms();
+  bool due[MAX_SESSIONS];
+  for (int i = 0; i < nsubs; i++) {
+    struct session *s = subs[i];
+    s->last_spectrum_recv_ms = now;
+    pthread_mutex_lock(&s->spectrum_mutex);
+    unsigned long const interval = spectrum_rate_interval_ms(s);
+    pthread_mutex_unlock(&s->spectrum_mutex);
+    due[i] = s->spectrum_frame_ms == 0 || now - s->spectrum_frame_ms >= interval * 3 / 4;
+    if (!due[i])
+      continue;
+    /* Achieved frame interval, averaged over ~8 frames */
+    if (s->spectrum_frame_ms != 0) {
+      float const gap = (float)(now - s->spectrum_frame_ms);
+      s->spectrum_achieved_ms = s->spectrum_achieved_ms == 0 ? gap : s->spectrum_achieved_ms + (gap - s->spectrum_achieved_ms) / 8;
     }
-    scan += optlen;
+    s->spectrum_frame_ms = now;
   }
 
+  /* Check demod type and bin data presence before attempting decode */
+  int const found_demod = tlv_present(idx, DEMOD_TYPE) ? decode_int(tlv_value(idx, DEMOD_TYPE), tlv_length(idx, DEMOD_TYPE)) : -1;
+  bool const found_bins = (tlv_present(idx, BIN_BYTE_DATA) && tlv_length(idx, BIN_BYTE_DATA) > 0)
+    || (tlv_present(idx, BIN_DATA) && tlv_length(idx, BIN_DATA) > 0);
+
   int npower = -1;
-  if ((found_demod == SPECT_DEMOD || found_demod == SPECT2_DEMOD) && (found_bin_byte_len > 0 || found_bin_data_len > 0)) {
-    npower = extract_powers(powers, length, &time, &r_freq, &r_bin_bw,
-                            sp->ssrc + 1, buffer + 1, rx_length - 1, sp);
+  if ((found_demod == SPECT_DEMOD || found_demod == SPECT2_DEMOD) && found_bins) {
+    npower = extract_powers(powers, MAX_BINS, &time, &r_freq, &r_bin_bw, ssrc, idx, sp);
   }
+  /* extract_powers() prefers BIN_DATA (dB) when both are present */
+  bool byte_codes = !tlv_present(idx, BIN_DATA);
 
+  atomic_fetch_add_explicit(npower < 0 ? &Metrics.spectrum_placeholder : &Metrics.spectrum_decoded, 1,
+                            memory_order_relaxed);
   if (npower < 0) {
     /* Synthesize a placeholder spectrum to keep the UI painting. Use last-known bin count
-       or session `sp->bins`, but limit to `length` (space available in packet). */
-    int use_bins = sp->bins > 0 ? sp->bins : (int)length;
-    if (use_bins > length) use_bins = length;
-    if (use_bins <= 0) return; /* nothing we can do */
+       or session `sp->bins`, but no more than MAX_BINS. */
+    int use_bins = sp->bins > 0 ? sp->bins : MAX_BINS;
+    if (use_bins > MAX_BINS) use_bins = MAX_BINS;
+    if (use_bins <= 0) /* nothing we can do */
+      return;
     /* fill with mid-gray (128) so browser paints a neutral spectrum */
     for (int i = 0; i < use_bins; ++i) powers[i] = 128.0f;
     npower = use_bins;
+    byte_codes = true;
     /* don't overwrite last_spectrum_recv_ms; leave it as-is for diagnostics */
   }
 
-  uint8_t *fp = (uint8_t *)ip;
-  for (int i = 0; i < npower; i++) {
-    *fp++ = powers[i];
+  /* Use radiod's init_chan defaults if no SPECT2 packet has arrived yet (step==0).
+     This makes placeholder frames visible even before the first real spectrum response. */
+  float const spec_base = (Channel.spectrum.step != 0.0) ? (float)Channel.spectrum.base : -150.0f;
+  float const spec_step = (Channel.spectrum.step != 0.0) ? (float)Channel.spectrum.step :   0.5f;
+
+  /* The other subscribers share the decode; only the header and code width differ */
+  for (int i = 1; i < nsubs; i++) {
+    struct session *other = subs[i];
+    other->bins_min_db = sp->bins_min_db;
+    other->bins_max_db = sp->bins_max_db;
+    other->if_power = sp->if_power;
   }
-  int size = (uint8_t *)fp - &output_buffer[0];
 
-  send_ws_binary_to_session(sp, output_buffer, size);
+  /* Each encoding (code width, reduction) is made once and shared by the
+     subscribers that want it; v1 frames use the 8-bit codes. The status
+     thread is the only caller, so the cache can be static. */
+  static struct spectrum_codes codes[SPECTRUM_CODE_CACHE];
+  int ncodes = 0;
+  for (int i = 0; i < nsubs; i++) {
+    struct session *s = subs[i];
+    if (!due[i])
+      continue;
+    int const bits = s->spectrum_bits != 0 ? s->spectrum_bits : 8;
+    /* X: may flip the flag meanwhile; this frame's type and body follow one reading */
+    bool const delta = atomic_load(&s->spectrum_delta);
+    uint8_t const type = delta ? 0x7C : s->spectrum_bits != 0 ? 0x7D : 0x7F;
+    int const px = s->spectrum_px > 0 && s->spectrum_px < npower ? s->spectrum_px : 0;
+    enum spectrum_reduce const reduce = px != 0 ? s->spectrum_reduce : SPECTRUM_REDUCE_MAX;
+    struct spectrum_codes *q = NULL;
+    for (int c = 0; c < ncodes && q == NULL; c++)
+      if (codes[c].bits == bits && codes[c].px == px && codes[c].reduce == reduce)
+        q = &codes[c];
+    if (q == NULL) {
+      /* When the cache is full the last entry is reused */
+      q = &codes[ncodes < SPECTRUM_CODE_CACHE ? ncodes++ : SPECTRUM_CODE_CACHE - 1];
+      q->px = px;
+      q->reduce = reduce;
+      if (px != 0) {
+        float reduced[MAX_BINS];
+        spectrum_reduce(reduced, powers, npower, px, reduce);
+        spectrum_quantize(q, bits, reduced, px, byte_codes, spec_base, spec_step, sp->bins_min_db, sp->bins_max_db);
+      } else {
+        spectrum_quantize(q, bits, powers, npower, byte_codes, spec_base, spec_step, sp->bins_min_db, sp->bins_max_db);
+      }
+    }
+    if (px != 0) {
+      s->spectrum_reduced_bytes += (uint64_t)(npower - px) * bits / 8;
+      s->spectrum_reduced_frames++;
+    }
+
+    /* The frame is built in a shared packet buffer that is queued by reference */
+    struct pktbuf *pb = pktbuf_alloc();
+    if (pb == NULL)
+      continue;
+    uint8_t *bp = spectrum_frame_header(s, pb->data, q, type);
+    int const room = PKTBUF_CAP - (int)(bp - pb->data);
+    if (delta) {
+      send_ws_pktbuf_to_session(s, pb, (int)(bp - pb->data) + spectrum_delta_encode(s, q, bp, room), WS_CLASS_SPECTRUM);
+    } else if (q->len <= room) {
+      memcpy(bp, q->data, q->len);
+      send_ws_pktbuf_to_session(s, pb, (int)(bp - pb->data) + q->len, WS_CLASS_SPECTRUM);
+    }
+    pktbuf_put(pb);
+  }
 }
 
 /*
@@ -3398,11 +7543,11 @@ static void process_spectrum_packet(struct session *sp, uint8_t *buffer, int rx_
   Handle an incoming regular STATUS packet for a session and forward radio/status
   metadata (and notifications) to the web browser client.
 
-  - Inputs: `sp` is the session (even SSRC); `buffer`/`rx_length` contain the received
-   STATUS TLV payload for that session.
+  - Inputs: `sp` is the session (even SSRC); `idx` indexes the TLVs of the received
+   STATUS payload for that session.
   - Actions performed:
-    1) Optionally detect explicit TLVs (e.g., SHIFT_FREQUENCY) using `tlv_has_type()` and
-      call `decode_radio_status()` to update `Frontend`/`Channel`.
+    1) Detect explicit TLVs (e.g., SHIFT_FREQUENCY) with `tlv_present()` and decode all
+      indexed fields into `Frontend`/`Channel` with `decode_radio_status_index()`.
     2) Extract noise density via `extract_noise()` and update `sp->noise_density_audio`.
     3) Perform preset and frequency mismatch detection/adoption logic and send
       textual notifications to the client (e.g., `M:<preset>`, `BFREQ:<freq>`)
@@ -3415,13 +7560,13 @@ static void process_spectrum_packet(struct session *sp, uint8_t *buffer, int rx_
     * The function relies on helper wrappers (send_ws_*) to perform websocket I/O
       with proper locking.
 */
-static void process_status_packet(struct session *sp, uint8_t *buffer, int rx_length,
+static void process_status_packet(struct session *sp, struct tlv_index const *idx,
                        double *last_sent_backend_frequency)
 {
   uint8_t output_buffer[PKTSIZE];
   /* Detect whether this status packet contains an explicit SHIFT_FREQUENCY TLV */
-  bool have_shift = tlv_has_type(buffer + 1, rx_length - 1, SHIFT_FREQUENCY);
-  decode_radio_status(&Frontend, &Channel, buffer + 1, rx_length - 1);
+  bool have_shift = tlv_present(idx, SHIFT_FREQUENCY);
+  decode_radio_status_index(&Frontend, &Channel, idx, NULL, 0);
 
   if (have_shift) {
     double new_shift = Channel.tune.shift;
@@ -3500,7 +7645,7 @@ static void process_status_packet(struct session *sp, uint8_t *buffer, int rx_le
   }
 
   float n0 = 0.0f;
-  if (0 == extract_noise(&n0, buffer + 1, rx_length - 1, sp))
+  if (0 == extract_noise(&n0, idx, sp))
     sp->noise_density_audio = n0;
 
   /* Handle preset mismatch / adoption */
@@ -3681,8 +7826,11 @@ static void process_status_packet(struct session *sp, uint8_t *buffer, int rx_le
   encode_float(&bp, BASEBAND_POWER, Channel.sig.bb_power);
   encode_float(&bp, LOW_EDGE, Channel.filter.min_IF);
   encode_float(&bp, HIGH_EDGE, Channel.filter.max_IF);
+  /* The first frame carries the description, so it must not be coalesced away */
+  enum ws_class cls = WS_CLASS_STATUS;
   if (!sp->once) {
     sp->once = true;
+    cls = WS_CLASS_CONTROL;
     if (description_override)
       encode_string(&bp, DESCRIPTION, description_override, strlen(description_override));
     else
@@ -3702,7 +7850,7 @@ static void process_status_packet(struct session *sp, uint8_t *buffer, int rx_le
   encode_float(&bp, RF_LEVEL_CAL, Frontend.rf_level_cal);
   encode_float(&bp, NOISE_BW, Channel.spectrum.noise_bw);
   int size = (uint8_t *)bp - output_buffer;
-  send_ws_binary_to_session(sp, output_buffer, size);
+  send_ws_binary_to_session(sp, output_buffer, size, cls);
 }
 
 
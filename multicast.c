@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <sysexits.h>
 
 #if defined(linux)
@@ -937,3 +938,101 @@ bool is_multicast(struct sockaddr const *group){
   }
   return false;
 }
+
+// Batched datagram receive
+// Drain up to 'nbufs' datagrams from fd with a single recvmmsg() call,
+// blocking (subject to SO_RCVTIMEO) only until the first one arrives.
+// Each datagram lands in bufs[i] (buflen bytes each) and is described by
+// an entry in segs[] giving its buffer index, start and length.
+// If UDP GRO was enabled on the socket with mcast_enable_gro(), the kernel may
+// hand back several same-sized datagrams coalesced in one buffer; they are
+// split back into separate segs[] entries here, so callers never see GRO.
+// With GRO on, segs[] should hold MCAST_SEGS(nbufs) entries; segments that
+// do not fit in maxsegs are dropped and counted in stats->overflow.
+// Datagrams truncated by a short buffer are dropped and counted.
+// Returns the number of segments, 0 on timeout/EINTR, or -1 on other errors (errno set)
+int mcast_recv_batch(int fd,uint8_t * const *bufs,size_t buflen,int nbufs,struct mcast_seg *segs,int maxsegs,struct mcast_ingest_stats *stats){
+  if(nbufs > MCAST_BATCH_MAX)
+    nbufs = MCAST_BATCH_MAX;
+
+  struct mmsghdr msgs[MCAST_BATCH_MAX];
+  struct iovec iov[MCAST_BATCH_MAX];
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control[MCAST_BATCH_MAX];
+  // Every datagram gets its own source slot; segs[] may be shorter than the
+  // batch and GRO splitting moves entries around, so don't receive into it
+  struct sockaddr_storage sources[MCAST_BATCH_MAX];
+
+  memset(msgs,0,nbufs * sizeof(msgs[0]));
+  for(int i=0; i < nbufs; i++){
+    iov[i].iov_base = bufs[i];
+    iov[i].iov_len = buflen;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = &sources[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+    msgs[i].msg_hdr.msg_control = control[i].buf;
+    msgs[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+  }
+  int const n = recvmmsg(fd,msgs,nbufs,MSG_WAITFORONE,NULL);
+  if(n <= 0){
+    if(n == 0 || errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    return -1;
+  }
+  if(stats != NULL)
+    stats->syscalls++;
+
+  int nsegs = 0;
+  for(int i=0; i < n; i++){
+    if(msgs[i].msg_hdr.msg_flags & MSG_TRUNC){
+      if(stats != NULL)
+	stats->truncated++;
+      continue;
+    }
+    size_t const len = msgs[i].msg_len;
+    size_t segsize = len;
+#ifdef UDP_GRO
+    for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cm != NULL; cm = CMSG_NXTHDR(&msgs[i].msg_hdr,cm)){
+      if(cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO){
+	int gso_size;
+	memcpy(&gso_size,CMSG_DATA(cm),sizeof(gso_size));
+	if(gso_size > 0)
+	  segsize = gso_size;
+      }
+    }
+#endif
+    for(size_t off = 0; off < len; off += segsize){
+      if(nsegs == maxsegs){
+	if(stats != NULL)
+	  stats->overflow++;
+	continue;
+      }
+      struct mcast_seg *s = &segs[nsegs++];
+      s->buf = i;
+      s->data = bufs[i] + off;
+      s->len = len - off < segsize ? len - off : segsize;
+      s->source = sources[i];
+      if(stats != NULL)
+	stats->datagrams++;
+    }
+  }
+  return nsegs;
+}
+
+// Ask the kernel to coalesce same-flow datagrams (UDP GRO, Linux 5.0+)
+// Only worthwhile when the receive buffers passed to mcast_recv_batch() are large
+// enough for a coalesced super-datagram (up to 64 KiB); otherwise data is truncated
+// Returns 0 when enabled, -1 if unsupported
+int mcast_enable_gro(int fd){
+#if defined(UDP_GRO)
+  int const on = 1;
+  if(setsockopt(fd,SOL_UDP,UDP_GRO,&on,sizeof(on)) == 0)
+    return 0;
+#else
+  (void)fd;
+#endif
+  return -1;
+}
@@ -29,6 +29,25 @@ int address_match(void const *arg1, void const *arg2);
 
 void dump_interfaces(void);
 
+// Batched datagram ingest (recvmmsg, with optional UDP GRO)
+#define MCAST_BATCH_MAX 32
+#define MCAST_GRO_MAX_SEGS 64    // most datagrams the kernel coalesces into one GRO buffer
+#define MCAST_SEGS(nbufs) ((nbufs) * MCAST_GRO_MAX_SEGS) // segs[] that can never overflow with GRO on
+struct mcast_seg {
+  int buf;                 // index of the caller buffer holding this datagram
+  uint8_t *data;           // start of the datagram within that buffer
+  size_t len;
+  struct sockaddr_storage source;
+};
+struct mcast_ingest_stats {
+  uint64_t syscalls;       // recvmmsg() calls that returned data
+  uint64_t datagrams;      // datagrams delivered, after GRO splitting
+  uint64_t truncated;      // datagrams dropped because they did not fit
+  uint64_t overflow;       // GRO segments dropped because segs[] was full
+};
+int mcast_recv_batch(int fd,uint8_t * const *bufs,size_t buflen,int nbufs,struct mcast_seg *segs,int maxsegs,struct mcast_ingest_stats *stats);
+int mcast_enable_gro(int fd);
+
 // Utility routines for reading from, and writing integers to, network format in char buffers
 static inline uint8_t get8(uint8_t const *dp){
   assert(dp != NULL);
@@ -386,6 +386,8 @@ int send_radio_status(struct sockaddr const *,struct frontend const *, struct ch
 int reset_radio_status(struct channel *chan);
 bool decode_radio_commands(struct channel *chan,uint8_t const *buffer,unsigned long length);
 int decode_radio_status(struct frontend *frontend,struct channel *channel,uint8_t const *buffer,unsigned long length);
+int decode_radio_status_index(struct frontend *frontend,struct channel *channel,struct tlv_index const *idx,
+			      enum status_type const *types,int ntypes);
 int flush_output(struct channel *chan,bool marker,bool complete);
 
 
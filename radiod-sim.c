@@ -0,0 +1,601 @@
+//
+// radiod-sim: a stand-in for ka9q-radio's radiod, for testing ka9q-web
+// without an SDR or a network
+//
+// Speaks the part of the TLV control protocol ka9q-web uses: it answers CMD
+// packets on the status/control group with STATUS packets and sends RTP
+// audio on the data group, all over multicast loopback (TTL 0).
+//
+
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sysexits.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <bsd/string.h>
+#include <opus/opus.h>
+
+#include "misc.h"
+#include "multicast.h"
+#include "rtp.h"
+#include "status.h"
+#include "radio.h"
+
+/*
+  What is simulated
+  -----------------
+  A channel springs into existence the first time a command names its SSRC
+  and goes away when its LIFETIME (in 20 ms ticks, as radiod counts it)
+  runs out without a refresh. Even SSRCs are audio channels, odd ones the
+  spectrum channels ka9q-web opens for its views:
+
+  - Audio channels keep frequency, preset, filter edges, shift, sample
+    rate and encoding. A PRESET command loads the preset's edges and CW
+    shift and, like radiod, moves the carrier frequency by the change in
+    shift. Every 20 ms each channel sends a packet of S16BE (or Opus, when
+    OUTPUT_ENCODING asks for it) holding a tone in noise.
+  - Spectrum channels answer each poll with BIN_DATA floats (SPECT_DEMOD)
+    or BIN_BYTE_DATA codes with SPECTRUM_BASE/STEP (SPECT2_DEMOD) of a
+    noise floor with a carrier every 5 kHz.
+
+  Every command gets one STATUS reply echoing its COMMAND_TAG. Replies are
+  held for the response latency (-l, plus up to -j of random jitter) and
+  then, like the audio, pass through the impairments: -x drops the given
+  percentage of datagrams, -o holds the given percentage back until the
+  next datagram on the same socket has gone out.
+*/
+
+#define SIM_MAX_CHANS 1024
+#define SIM_MAX_BINS 4096
+#define SIM_FRAME_MS 20
+#define SIM_QUEUE 4096          /* replies waiting out their latency */
+#define SIM_INPUT_SAMPRATE 64800000
+#define SIM_L 3240              /* FILTER_BLOCKSIZE, as for an RX888 at 64.8 MHz */
+#define SIM_M 3241              /* FILTER_FIR_LENGTH */
+
+struct sim_preset {
+  char const *name;
+  enum demod_type demod;
+  float low, high;
+  float shift;
+};
+
+static struct sim_preset const Presets[] = {
+  { "usb", LINEAR_DEMOD,    50, 3000,    0 },
+  { "lsb", LINEAR_DEMOD, -3000,  -50,    0 },
+  { "cwu", LINEAR_DEMOD,  -200,  200,  500 },
+  { "cwl", LINEAR_DEMOD,  -200,  200, -500 },
+  { "am",  LINEAR_DEMOD, -5000, 5000,    0 },
+  { "sam", LINEAR_DEMOD, -5000, 5000,    0 },
+  { "iq",  LINEAR_DEMOD, -5000, 5000,    0 },
+  { "fm",  FM_DEMOD,     -8000, 8000,    0 },
+};
+
+struct sim_chan {
+  bool in_use;
+  uint32_t ssrc;
+  unsigned long expires_ms;
+  uint32_t cmd_cnt;
+  /* audio */
+  double freq;
+  double shift;
+  char preset[32];
+  enum demod_type demod;
+  float low, high;
+  int samprate;
+  enum encoding encoding;
+  uint16_t seq;
+  uint32_t timestamp;
+  double phase;
+  OpusEncoder *opus;
+  int opus_samprate;
+  /* spectrum */
+  int bins;
+  float bin_bw;
+  int avg;
+  int window;
+};
+
+struct sim_reply {
+  uint64_t due_ns;
+  int len;
+  uint8_t data[];         /* len bytes; allocated to fit */
+};
+
+/* A datagram held back to be sent after the next one (-o) */
+struct sim_impair {
+  pthread_mutex_t mutex;
+  int fd;
+  bool held;
+  int len;
+  uint8_t data[PKTSIZE];
+};
+
+static struct sim_chan Chans[SIM_MAX_CHANS];
+static pthread_mutex_t Chan_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct sim_reply *Queue[SIM_QUEUE];
+static int Queue_len;
+static pthread_mutex_t Queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Queue_cond = PTHREAD_COND_INITIALIZER;
+
+static struct sim_impair Status_out = { .mutex = PTHREAD_MUTEX_INITIALIZER, .fd = -1 };
+static struct sim_impair Data_out = { .mutex = PTHREAD_MUTEX_INITIALIZER, .fd = -1 };
+
+static struct sockaddr_storage Status_sock;
+static struct sockaddr_storage Data_sock;
+static int Status_in_fd = -1;
+
+int Verbose;
+static int Default_samprate = 12000;
+static double Latency_ms = 5;
+static double Jitter_ms = 0;
+static double Loss_pct = 0;
+static double Reorder_pct = 0;
+static unsigned long long Sent[2], Dropped[2], Reordered[2]; /* [0] status, [1] data */
+
+static uint64_t mono_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static double uniform(void)
+{
+  return (double)random() / ((double)RAND_MAX + 1.0);
+}
+
+/* Gaussian noise, Box-Muller */
+static double gaussian(void)
+{
+  double const u = uniform() + 1e-12;
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * uniform());
+}
+
+/* Send through the loss and reordering impairments */
+static void sim_send(struct sim_impair *out, uint8_t const *data, int len)
+{
+  int const which = out == &Data_out;
+  pthread_mutex_lock(&out->mutex);
+  if (Loss_pct > 0 && uniform() * 100 < Loss_pct) {
+    Dropped[which]++;
+    pthread_mutex_unlock(&out->mutex);
+    return;
+  }
+  if (!out->held && Reorder_pct > 0 && uniform() * 100 < Reorder_pct) {
+    memcpy(out->data, data, len);
+    out->len = len;
+    out->held = true;
+    Reordered[which]++;
+    pthread_mutex_unlock(&out->mutex);
+    return;
+  }
+  if (send(out->fd, data, len, 0) < 0 && errno != EAGAIN)
+    perror("send");
+  Sent[which]++;
+  if (out->held) {
+    if (send(out->fd, out->data, out->len, 0) < 0 && errno != EAGAIN)
+      perror("send");
+    Sent[which]++;
+    out->held = false;
+  }
+  pthread_mutex_unlock(&out->mutex);
+}
+
+static void sim_apply_preset(struct sim_chan *c, char const *name)
+{
+  for (size_t i = 0; i < sizeof(Presets) / sizeof(Presets[0]); i++) {
+    if (strcasecmp(Presets[i].name, name) != 0)
+      continue;
+    /* radiod keeps the carrier where it was: the dial moves with the shift */
+    c->freq += c->shift - Presets[i].shift;
+    c->shift = Presets[i].shift;
+    c->demod = Presets[i].demod;
+    c->low = Presets[i].low;
+    c->high = Presets[i].high;
+    break;
+  }
+  strlcpy(c->preset, name, sizeof(c->preset));
+}
+
+/* Find or create the channel for `ssrc`; caller holds Chan_mutex */
+static struct sim_chan *sim_chan(uint32_t ssrc)
+{
+  struct sim_chan *free_slot = NULL;
+  for (int i = 0; i < SIM_MAX_CHANS; i++) {
+    if (Chans[i].in_use && Chans[i].ssrc == ssrc)
+      return &Chans[i];
+    if (!Chans[i].in_use && free_slot == NULL)
+      free_slot = &Chans[i];
+  }
+  if (free_slot == NULL)
+    return NULL;
+  struct sim_chan *c = free_slot;
+  memset(c, 0, sizeof(*c));
+  c->in_use = true;
+  c->ssrc = ssrc;
+  c->freq = 14074000;
+  c->samprate = Default_samprate;
+  c->encoding = S16BE;
+  c->bins = 1620;
+  c->bin_bw = 100;
+  c->demod = ssrc % 2 ? SPECT_DEMOD : LINEAR_DEMOD;
+  c->seq = (uint16_t)random();
+  c->timestamp = (uint32_t)random();
+  c->expires_ms = mono_ns() / 1000000 + 1000 * SIM_FRAME_MS;
+  sim_apply_preset(c, "usb");
+  if (Verbose)
+    fprintf(stderr, "new %s channel ssrc %u\n", ssrc % 2 ? "spectrum" : "audio", ssrc);
+  return c;
+}
+
+/* Apply one CMD packet's parameters to its channel */
+static void sim_command(struct sim_chan *c, struct tlv_index const *idx)
+{
+#define HAVE(t) tlv_present(idx, t)
+#define VAL(t) tlv_value(idx, t), tlv_length(idx, t)
+  c->cmd_cnt++;
+  if (HAVE(PRESET)) {
+    char *p = decode_string(VAL(PRESET));
+    if (p != NULL) {
+      sim_apply_preset(c, p);
+      free(p);
+    }
+  }
+  if (HAVE(RADIO_FREQUENCY))
+    c->freq = decode_double(VAL(RADIO_FREQUENCY));
+  if (HAVE(SHIFT_FREQUENCY))
+    c->shift = decode_double(VAL(SHIFT_FREQUENCY));
+  if (HAVE(LOW_EDGE))
+    c->low = decode_float(VAL(LOW_EDGE));
+  if (HAVE(HIGH_EDGE))
+    c->high = decode_float(VAL(HIGH_EDGE));
+  if (HAVE(OUTPUT_SAMPRATE))
+    c->samprate = decode_int(VAL(OUTPUT_SAMPRATE));
+  if (HAVE(OUTPUT_ENCODING))
+    c->encoding = decode_int(VAL(OUTPUT_ENCODING));
+  if (HAVE(DEMOD_TYPE))
+    c->demod = decode_int(VAL(DEMOD_TYPE));
+  if (HAVE(BIN_COUNT)) {
+    int const bins = decode_int(VAL(BIN_COUNT));
+    if (bins > 0 && bins <= SIM_MAX_BINS)
+      c->bins = bins;
+  }
+  if (HAVE(RESOLUTION_BW))
+    c->bin_bw = decode_float(VAL(RESOLUTION_BW));
+  if (HAVE(SPECTRUM_AVG))
+    c->avg = decode_int(VAL(SPECTRUM_AVG));
+  if (HAVE(WINDOW_TYPE))
+    c->window = decode_int(VAL(WINDOW_TYPE));
+  int lifetime = 1000;
+  if (HAVE(LIFETIME))
+    lifetime = decode_int(VAL(LIFETIME));
+  c->expires_ms = mono_ns() / 1000000 + (unsigned long)lifetime * SIM_FRAME_MS;
+  if (c->samprate <= 0)
+    c->samprate = Default_samprate;
+#undef HAVE
+#undef VAL
+}
+
+/* Power in bin `i` of a spectrum channel: noise floor and a carrier every 5 kHz */
+static float sim_bin_power(struct sim_chan const *c, int i)
+{
+  double const f = c->freq + (i - c->bins / 2) * (double)c->bin_bw;
+  double const noise = 1e-13 * c->bin_bw * (0.5 + uniform());
+  double const off = fabs(remainder(f, 5000.0));
+  double const carrier = off < c->bin_bw ? 1e-7 * (1 - off / c->bin_bw) : 0;
+  return (float)(noise + carrier);
+}
+
+/* Build the STATUS reply for `c` answering command `tag` */
+static int sim_status(struct sim_chan const *c, uint32_t tag, uint8_t *buf)
+{
+  uint8_t *bp = buf;
+  *bp++ = STATUS;
+  encode_int32(&bp, OUTPUT_SSRC, c->ssrc);
+  encode_int32(&bp, COMMAND_TAG, tag);
+  encode_int32(&bp, CMD_CNT, c->cmd_cnt);
+  encode_int64(&bp, GPS_TIME, (uint64_t)time(NULL) * 1000000000ULL);
+  encode_string(&bp, DESCRIPTION, "radiod-sim", strlen("radiod-sim"));
+  encode_int32(&bp, INPUT_SAMPRATE, SIM_INPUT_SAMPRATE);
+  encode_int(&bp, FILTER_BLOCKSIZE, SIM_L);
+  encode_int(&bp, FILTER_FIR_LENGTH, SIM_M);
+  encode_float(&bp, IF_POWER, -40.0);
+  encode_int(&bp, DEMOD_TYPE, c->demod);
+  encode_double(&bp, RADIO_FREQUENCY, c->freq);
+
+  if (c->ssrc % 2 == 1) {
+    float power[SIM_MAX_BINS];
+    for (int i = 0; i < c->bins; i++)
+      power[i] = sim_bin_power(c, i);
+    encode_int(&bp, BIN_COUNT, c->bins);
+    encode_float(&bp, RESOLUTION_BW, c->bin_bw);
+    encode_int(&bp, SPECTRUM_AVG, c->avg);
+    encode_int(&bp, WINDOW_TYPE, c->window);
+    if (c->demod == SPECT2_DEMOD) {
+      /* 8-bit codes: base + step * code dB */
+      float const base = -150, step = 0.5;
+      uint8_t codes[SIM_MAX_BINS];
+      for (int i = 0; i < c->bins; i++) {
+        float const code = (10 * log10f(power[i]) - base) / step;
+        codes[i] = code < 0 ? 0 : code > 255 ? 255 : (uint8_t)code;
+      }
+      encode_float(&bp, SPECTRUM_BASE, base);
+      encode_float(&bp, SPECTRUM_STEP, step);
+      encode_string(&bp, BIN_BYTE_DATA, codes, c->bins);
+    } else {
+      /* BIN_DATA is in FFT order: the centre bin and up, then the bottom half */
+      float fft[SIM_MAX_BINS];
+      int const half = c->bins / 2;
+      for (int i = 0; i < c->bins; i++)
+        fft[i] = power[(i + half) % c->bins];
+      encode_vector(&bp, BIN_DATA, fft, c->bins);
+    }
+  } else {
+    encode_string(&bp, PRESET, c->preset, strlen(c->preset));
+    encode_double(&bp, SHIFT_FREQUENCY, c->shift);
+    encode_float(&bp, LOW_EDGE, c->low);
+    encode_float(&bp, HIGH_EDGE, c->high);
+    encode_int32(&bp, OUTPUT_SAMPRATE, c->samprate);
+    encode_int(&bp, OUTPUT_ENCODING, c->encoding);
+    encode_int(&bp, OUTPUT_CHANNELS, 1);
+    encode_socket(&bp, OUTPUT_DATA_DEST_SOCKET, &Data_sock);
+    encode_float(&bp, BASEBAND_POWER, -60.0 + gaussian());
+    encode_float(&bp, NOISE_DENSITY, -150.0 + gaussian());
+  }
+  encode_eol(&bp);
+  return (int)(bp - buf);
+}
+
+/* Queue a reply to go out after the response latency */
+static void sim_queue_reply(uint8_t const *data, int len)
+{
+  struct sim_reply *r = malloc(sizeof(*r) + (size_t)len);
+  if (r == NULL)
+    return;
+  r->due_ns = mono_ns() + (uint64_t)((Latency_ms + Jitter_ms * uniform()) * 1e6);
+  r->len = len;
+  memcpy(r->data, data, len);
+  pthread_mutex_lock(&Queue_mutex);
+  if (Queue_len == SIM_QUEUE) {
+    pthread_mutex_unlock(&Queue_mutex);
+    free(r);
+    return;
+  }
+  /* Sorted by due time; jitter can overtake earlier replies */
+  int i = Queue_len++;
+  while (i > 0 && Queue[i - 1]->due_ns > r->due_ns) {
+    Queue[i] = Queue[i - 1];
+    i--;
+  }
+  Queue[i] = r;
+  pthread_cond_signal(&Queue_cond);
+  pthread_mutex_unlock(&Queue_mutex);
+}
+
+/* Sends replies as they come due */
+static void *reply_thread(void *arg)
+{
+  (void)arg;
+  pthread_mutex_lock(&Queue_mutex);
+  for (;;) {
+    while (Queue_len == 0)
+      pthread_cond_wait(&Queue_cond, &Queue_mutex);
+    uint64_t const now = mono_ns();
+    if (Queue[0]->due_ns > now) {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      uint64_t const wait = Queue[0]->due_ns - now;
+      ts.tv_sec += (time_t)(wait / 1000000000ULL);
+      ts.tv_nsec += (long)(wait % 1000000000ULL);
+      if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&Queue_cond, &Queue_mutex, &ts);
+      continue;
+    }
+    struct sim_reply *r = Queue[0];
+    memmove(Queue, Queue + 1, (size_t)(Queue_len - 1) * sizeof(Queue[0]));
+    Queue_len--;
+    pthread_mutex_unlock(&Queue_mutex);
+    sim_send(&Status_out, r->data, r->len);
+    free(r);
+    pthread_mutex_lock(&Queue_mutex);
+  }
+  return NULL;
+}
+
+/* Receives commands; our own STATUS packets come back on the group and are skipped */
+static void *command_thread(void *arg)
+{
+  (void)arg;
+  static uint8_t buf[PKTSIZE];
+  static uint8_t reply[PKTSIZE];
+  struct tlv_index idx;
+  for (;;) {
+    ssize_t const len = recv(Status_in_fd, buf, sizeof(buf), 0);
+    if (len <= 0) {
+      if (len < 0 && errno != EINTR && errno != EAGAIN)
+        perror("recv");
+      continue;
+    }
+    if ((enum pkt_type)buf[0] != CMD)
+      continue;
+    tlv_index(&idx, buf + 1, (size_t)len - 1);
+    if (!tlv_present(&idx, OUTPUT_SSRC))
+      continue;
+    uint32_t const ssrc = decode_int32(tlv_value(&idx, OUTPUT_SSRC), tlv_length(&idx, OUTPUT_SSRC));
+    uint32_t const tag = tlv_present(&idx, COMMAND_TAG) ? decode_int32(tlv_value(&idx, COMMAND_TAG), tlv_length(&idx, COMMAND_TAG)) : 0;
+    pthread_mutex_lock(&Chan_mutex);
+    struct sim_chan *c = sim_chan(ssrc);
+    int n = 0;
+    if (c != NULL) {
+      sim_command(c, &idx);
+      n = sim_status(c, tag, reply);
+    }
+    pthread_mutex_unlock(&Chan_mutex);
+    if (n > 0)
+      sim_queue_reply(reply, n);
+  }
+  return NULL;
+}
+
+/* One 20 ms RTP packet of a tone in noise for audio channel `c`; caller holds Chan_mutex */
+static int sim_audio_packet(struct sim_chan *c, uint8_t *buf)
+{
+  bool const opus = c->encoding == OPUS || c->encoding == OPUS_VOIP;
+  int samprate = c->samprate;
+  if (opus && samprate != 8000 && samprate != 12000 && samprate != 16000 && samprate != 24000 && samprate != 48000)
+    samprate = 48000;
+  int const n = samprate * SIM_FRAME_MS / 1000;
+  int16_t pcm[48000 * SIM_FRAME_MS / 1000];
+  if (n > (int)(sizeof(pcm) / sizeof(pcm[0])))
+    return 0;
+  double const tone = c->shift != 0 ? 700 : 1000;
+  for (int i = 0; i < n; i++) {
+    double const s = 0.2 * sin(c->phase) + 0.02 * gaussian();
+    c->phase = remainder(c->phase + 2 * M_PI * tone / samprate, 2 * M_PI);
+    pcm[i] = (int16_t)lrint(fmax(-1.0, fmin(1.0, s)) * 32767);
+  }
+
+  struct rtp_header rtp;
+  memset(&rtp, 0, sizeof(rtp));
+  rtp.version = RTP_VERS;
+  rtp.ssrc = c->ssrc;
+  rtp.seq = c->seq++;
+  rtp.timestamp = c->timestamp;
+  uint8_t *dp;
+  if (opus) {
+    if (c->opus == NULL || c->opus_samprate != samprate) {
+      int error = OPUS_OK;
+      if (c->opus != NULL)
+        opus_encoder_destroy(c->opus);
+      c->opus = opus_encoder_create(samprate, 1, OPUS_APPLICATION_AUDIO, &error);
+      if (c->opus == NULL) {
+        fprintf(stderr, "opus_encoder_create: %s\n", opus_strerror(error));
+        return 0;
+      }
+      c->opus_samprate = samprate;
+    }
+    rtp.type = Opus_pt;
+    c->timestamp += 48 * SIM_FRAME_MS; /* Opus RTP clock is always 48 kHz */
+    dp = (uint8_t *)hton_rtp((char *)buf, &rtp);
+    int const len = opus_encode(c->opus, pcm, n, dp, PKTSIZE - (int)(dp - buf));
+    return len > 0 ? (int)(dp - buf) + len : 0;
+  }
+  int const pt = pt_from_info(samprate, 1, S16BE);
+  if (pt < 0)
+    return 0;
+  rtp.type = (uint8_t)pt;
+  c->timestamp += n;
+  dp = (uint8_t *)hton_rtp((char *)buf, &rtp);
+  for (int i = 0; i < n; i++) {
+    *dp++ = (uint8_t)(pcm[i] >> 8);
+    *dp++ = (uint8_t)pcm[i];
+  }
+  return (int)(dp - buf);
+}
+
+/* Every 20 ms: expire idle channels and send each audio channel's packet */
+static void *audio_thread(void *arg)
+{
+  (void)arg;
+  static uint8_t buf[PKTSIZE];
+  uint64_t next = mono_ns();
+  unsigned long ticks = 0;
+  for (;;) {
+    next += SIM_FRAME_MS * 1000000ULL;
+    struct timespec ts = { .tv_sec = (time_t)(next / 1000000000ULL), .tv_nsec = (long)(next % 1000000000ULL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+      ;
+    unsigned long const now_ms = (unsigned long)(mono_ns() / 1000000);
+    for (int i = 0; i < SIM_MAX_CHANS; i++) {
+      pthread_mutex_lock(&Chan_mutex);
+      struct sim_chan *c = &Chans[i];
+      int len = 0;
+      if (c->in_use && now_ms > c->expires_ms) {
+        if (Verbose)
+          fprintf(stderr, "channel ssrc %u expired\n", c->ssrc);
+        if (c->opus != NULL)
+          opus_encoder_destroy(c->opus);
+        c->opus = NULL;
+        c->in_use = false;
+      } else if (c->in_use && c->ssrc % 2 == 0) {
+        len = sim_audio_packet(c, buf);
+      }
+      pthread_mutex_unlock(&Chan_mutex);
+      if (len > 0)
+        sim_send(&Data_out, buf, len);
+    }
+    if (Verbose && ++ticks % (10000 / SIM_FRAME_MS) == 0)
+      fprintf(stderr, "status: %llu sent %llu dropped %llu reordered; data: %llu sent %llu dropped %llu reordered\n",
+              Sent[0], Dropped[0], Reordered[0], Sent[1], Dropped[1], Reordered[1]);
+  }
+  return NULL;
+}
+
+static void usage(char const *name)
+{
+  fprintf(stderr, "Usage: %s [-m status_group] [-D data_group] [-s samprate] [-l latency_ms] [-j jitter_ms] "
+          "[-x loss_pct] [-o reorder_pct] [-v]\n", name);
+  exit(EX_USAGE);
+}
+
+int main(int argc, char *argv[])
+{
+  char const *status_group = "239.192.0.1";
+  char const *data_group = "239.192.0.2";
+  int c;
+  while ((c = getopt(argc, argv, "m:D:s:l:j:x:o:vh")) != -1) {
+    switch (c) {
+    case 'm': status_group = optarg; break;
+    case 'D': data_group = optarg; break;
+    case 's': Default_samprate = atoi(optarg); break;
+    case 'l': Latency_ms = fmax(0, strtod(optarg, NULL)); break;
+    case 'j': Jitter_ms = fmax(0, strtod(optarg, NULL)); break;
+    case 'x': Loss_pct = fmax(0, strtod(optarg, NULL)); break;
+    case 'o': Reorder_pct = fmax(0, strtod(optarg, NULL)); break;
+    case 'v': Verbose++; break;
+    default: usage(argv[0]);
+    }
+  }
+  srandom((unsigned)mono_ns());
+
+  if (resolve_mcast(status_group, &Status_sock, DEFAULT_STAT_PORT, NULL, 0, 0) != 0
+      || resolve_mcast(data_group, &Data_sock, DEFAULT_RTP_PORT, NULL, 0, 0) != 0) {
+    fprintf(stderr, "can't resolve %s or %s\n", status_group, data_group);
+    exit(EX_NOHOST);
+  }
+  Status_in_fd = listen_mcast(NULL, &Status_sock, NULL);
+  /* TTL 0 keeps everything on the loopback interface */
+  Status_out.fd = connect_mcast(&Status_sock, NULL, 0, -1);
+  Data_out.fd = connect_mcast(&Data_sock, NULL, 0, -1);
+  if (Status_in_fd == -1 || Status_out.fd == -1 || Data_out.fd == -1) {
+    fprintf(stderr, "can't set up multicast sockets\n");
+    exit(EX_IOERR);
+  }
+  fprintf(stderr, "radiod-sim: status %s, data %s; latency %.1f+%.1f ms, loss %.1f%%, reorder %.1f%%\n",
+          formatsock(&Status_sock, false), formatsock(&Data_sock, false), Latency_ms, Jitter_ms, Loss_pct, Reorder_pct);
+
+  pthread_t reply_task, audio_task;
+  if (pthread_create(&reply_task, NULL, reply_thread, NULL) != 0
+      || pthread_create(&audio_task, NULL, audio_thread, NULL) != 0) {
+    perror("pthread_create");
+    exit(EX_OSERR);
+  }
+  command_thread(NULL);
+  return 0;
+}
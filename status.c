@@ -329,3 +329,44 @@ struct sockaddr *decode_socket(void *sock,uint8_t const *val,int optlen){
   }
   return NULL;
 }
+
+// Index the TLVs of a status or command packet in one pass
+// Returns the number of TLVs indexed, stopping at EOL or at the first malformed entry
+int tlv_index(struct tlv_index *idx,uint8_t const *buffer,size_t length){
+  uint8_t const *cp = buffer;
+  uint8_t const * const end = buffer + length;
+  int count = 0;
+
+  idx->base = buffer;
+  memset(idx->present,0,sizeof(idx->present));
+  while(cp < end){
+    enum status_type const type = *cp++; // increment cp to length field
+    if(type == EOL)
+      break; // end of list, no length
+    if(cp >= end)
+      break;
+
+    unsigned int optlen = *cp++;
+    if(optlen & 0x80){
+      // length is >= 128 bytes; fetch actual length from next N bytes, where N is low 7 bits of optlen
+      int length_of_length = optlen & 0x7f;
+      if(length_of_length > (int)sizeof(optlen) || cp + length_of_length > end)
+	break;
+      optlen = 0;
+      while(length_of_length > 0){
+	optlen <<= 8;
+	optlen |= *cp++;
+	length_of_length--;
+      }
+    }
+    if(optlen > (size_t)(end - cp) || cp - buffer > UINT16_MAX || optlen > UINT16_MAX)
+      break; // invalid length; we can't continue to scan
+
+    idx->present[type / 64] |= (uint64_t)1 << (type % 64);
+    idx->offset[type] = (uint16_t)(cp - buffer);
+    idx->length[type] = (uint16_t)optlen;
+    count++;
+    cp += optlen;
+  }
+  return count;
+}
@@ -192,6 +192,28 @@ char *decode_string(uint8_t const *,int);
 uint32_t get_ssrc(uint8_t const *buffer,unsigned long length);
 uint32_t get_tag(uint8_t const *buffer,unsigned long length);
 
+// Where each TLV of one status or command packet lies, by type, so several consumers
+// can look fields up after a single scan. Built by tlv_index(); when a type repeats,
+// the last instance wins, as it would in a sequential decode
+#define TLV_TYPES 256
+struct tlv_index {
+  uint8_t const *base;           // start of the TLV list (after the packet type byte)
+  uint64_t present[TLV_TYPES/64];
+  uint16_t offset[TLV_TYPES];    // value offset from base; valid only if present
+  uint16_t length[TLV_TYPES];
+};
+int tlv_index(struct tlv_index *idx,uint8_t const *buffer,size_t length);
+
+static inline bool tlv_present(struct tlv_index const *idx,enum status_type type){
+  return (idx->present[(unsigned)type / 64] >> ((unsigned)type % 64)) & 1;
+}
+static inline uint8_t const *tlv_value(struct tlv_index const *idx,enum status_type type){
+  return idx->base + idx->offset[type];
+}
+static inline int tlv_length(struct tlv_index const *idx,enum status_type type){
+  return idx->length[type];
+}
+
 void dump_metadata(FILE *,uint8_t const *,size_t,bool);
 
 #endif
@@ -0,0 +1,1210 @@
+//
+// ws-loadgen: headless WebSocket load generator for ka9q-web
+//
+// Opens N WebSocket sessions against the server's home() endpoint, drives
+// each with the command mix a browser produces, validates the frames that
+// come back and reports per-client frame rates, inter-frame jitter,
+// command-to-BFREQ latency and disconnects. With radiod-sim standing in for
+// radiod it needs no radio hardware.
+//
+
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sysexits.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <bsd/string.h>
+
+/*
+  What a client does
+  ------------------
+  Each client connects, upgrades to a WebSocket and then behaves like
+  radio.js: on open it sends Q:8, R:100:2000, S:STOP and S:, then its mode,
+  frequency and zoom wrapped as C:<clientId>:<seq>:<command>, and A:START
+  (and O:OPUS for the -O share of clients). After that it picks an action
+  every -c ms on average (exponentially distributed):
+
+    frequency drag   a run of 8-20 F: steps 40 ms apart (wrapped)
+    frequency entry  one F: to a new frequency (wrapped)
+    zoom             Z:+, Z:- or Z:<level> (wrapped)
+    zoom centre      Z:c:<kHz> (wrapped)
+    mode change      M:<preset> (wrapped)
+    spectrum toggle  S:STOP, then S: on the next action
+    audio toggle     A:STOP, then A:START on the next action
+
+  Wrapped commands expect ACK:<clientId>:<seq> and are resent after 1 s, at
+  most twice, as the browser does. An F: to a new frequency is timed until
+  the BFREQ: carrying it comes back; while the preset is CW the backend
+  frequency is offset by the shift, so those are not timed.
+
+  What is checked
+  ---------------
+  Every binary frame must carry an RTP version 2 header. Spectrum frames
+  (0x7C/0x7D/0x7F) must carry the session's spectrum SSRC and a complete
+  metadata block, and v2 frames a code count that matches their length.
+  Channel data (0x7E) must carry the session SSRC and a well-formed TLV
+  list. Audio must carry the session SSRC, PCM an even byte count, and
+  sequence gaps and reordering are counted. Anything else counts as
+  invalid.
+
+  Disconnects are counted and the client reconnects with the browser's
+  backoff (1 s doubling to 30 s); BUSY rejections at MAX_SESSIONS are
+  counted separately.
+
+  Source addresses
+  ----------------
+  ka9q-web reattaches a new WebSocket to an idle session from the same
+  client address, so many clients from one address would steal each
+  other's sessions. Against a loopback server each client therefore binds
+  its own source address, counting up from -b (127.1.0.1 by default; any
+  127/8 address works on Linux without configuration). -b none disables it.
+*/
+
+#define LG_MAX_CLIENTS 10000
+#define LG_MAX_THREADS 64
+#define LG_PENDING 16           /* outstanding F: commands per client */
+#define LG_ACKS 32              /* outstanding wrapped commands per client */
+#define LG_SAMPLES 256          /* BFREQ latency samples kept per client */
+#define LG_ACK_TIMEOUT_MS 1000
+#define LG_ACK_RETRIES 2
+#define LG_BFREQ_TIMEOUT_MS 5000
+#define LG_HANDSHAKE_TIMEOUT_MS 5000
+#define LG_MAX_FRAME (4 * 1024 * 1024)
+#define LG_ZOOM_LEVELS 23       /* size of ka9q-web's zoom_table */
+#define LG_SPECTRUM_META 92     /* spectrum_frame_header() bytes after RTP */
+#define LG_OPUS_PT 111
+
+enum lg_state { LG_IDLE, LG_CONNECTING, LG_HANDSHAKE, LG_OPEN, LG_DONE };
+
+/* Arrival statistics for one frame class; Welford's running variance of the gaps */
+struct lg_flow {
+  uint64_t frames;
+  uint64_t bytes;
+  uint64_t last_ns;
+  uint64_t gaps;
+  double mean_ms;
+  double m2;
+  double max_gap_ms;
+};
+
+struct lg_pending_freq {
+  bool used;
+  double hz;
+  uint64_t sent_ns;
+};
+
+struct lg_pending_ack {
+  bool used;
+  uint32_t seq;
+  int retries;
+  uint64_t sent_ns;
+  char msg[96];
+};
+
+struct lg_client {
+  int id;
+  int fd;
+  int ep;                       /* the owning worker's epoll set */
+  bool want_out;                /* EPOLLOUT armed */
+  enum lg_state state;
+  uint64_t state_ns;            /* when the state was entered, or next reconnect */
+  unsigned backoff_ms;
+  struct sockaddr_in src;
+  bool bind_src;
+  uint32_t rng;
+
+  /* session */
+  bool have_ssrc;
+  uint32_t ssrc;
+  char cid[16];
+  uint32_t seq;
+  double freq_khz;
+  double last_bfreq_hz;
+  int zoom;
+  int preset;
+  bool wants_audio;
+  bool wants_opus;
+  bool spectrum_on;
+  bool audio_on;
+  uint64_t next_action_ns;
+  int drag_left;
+  double drag_step_khz;
+
+  /* I/O */
+  uint8_t *in;
+  size_t in_len, in_cap;
+  uint8_t out[16384];
+  size_t out_len;
+
+  struct lg_pending_freq pending[LG_PENDING];
+  struct lg_pending_ack acks[LG_ACKS];
+
+  /* statistics */
+  struct lg_flow spectrum, status, audio;
+  bool audio_seq_valid;
+  uint16_t audio_seq;
+  uint64_t audio_lost, audio_reordered;
+  uint64_t text, invalid, cmds;
+  uint64_t connects, disconnects, busy, failed;
+  bool busy_now;                /* this connection was turned away */
+  bool open_at_stop;
+  uint64_t open_ns;             /* total time open */
+  uint64_t acked, ack_retries, ack_lost;
+  double ack_sum_ms, ack_max_ms;
+  uint64_t bfreq_n, bfreq_timeouts, bfreq_superseded;
+  double bfreq_sum_ms, bfreq_max_ms;
+  float bfreq_ms[LG_SAMPLES];
+  char last_invalid[64];
+};
+
+struct lg_worker {
+  pthread_t thread;
+  pthread_mutex_t mutex;        /* held while clients are serviced; the reporter takes it to read */
+  int ep;
+  struct lg_client *clients;
+  int nclients;
+};
+
+static struct sockaddr_in Server;
+static char Host_header[300];
+static int Nclients = 50;
+static int Nthreads = 4;
+static int Ramp_ms = 50;
+static int Action_ms = 3000;
+static int Duration_s = 60;
+static int Report_s = 10;
+static int Audio_pct = 100;
+static int Opus_pct = 0;
+static double Base_khz = 14000;
+static double Span_khz = 350;
+static int Verbose;
+static volatile sig_atomic_t Stop;
+static uint64_t Start_ns;
+
+static struct lg_client *Clients;
+static struct lg_worker Workers[LG_MAX_THREADS];
+
+static char const *const Presets[] = { "usb", "lsb", "cwu", "cwl", "am", "fm" };
+#define NPRESETS (int)(sizeof(Presets) / sizeof(Presets[0]))
+
+static uint64_t mono_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift32: each client has its own generator, so runs repeat for the same -n */
+static uint32_t lg_rand(struct lg_client *c)
+{
+  uint32_t x = c->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return c->rng = x;
+}
+
+static double lg_uniform(struct lg_client *c)
+{
+  return (lg_rand(c) >> 8) / 16777216.0;
+}
+
+static void flow_add(struct lg_flow *f, size_t bytes, uint64_t now)
+{
+  f->frames++;
+  f->bytes += bytes;
+  if (f->last_ns != 0) {
+    double const gap = (now - f->last_ns) / 1e6;
+    f->gaps++;
+    double const d = gap - f->mean_ms;
+    f->mean_ms += d / f->gaps;
+    f->m2 += d * (gap - f->mean_ms);
+    if (gap > f->max_gap_ms)
+      f->max_gap_ms = gap;
+  }
+  f->last_ns = now;
+}
+
+static double flow_jitter_ms(struct lg_flow const *f)
+{
+  return f->gaps > 1 ? sqrt(f->m2 / (f->gaps - 1)) : 0;
+}
+
+static void invalid(struct lg_client *c, char const *why)
+{
+  c->invalid++;
+  strlcpy(c->last_invalid, why, sizeof(c->last_invalid));
+  if (Verbose > 1)
+    fprintf(stderr, "client %d: invalid frame: %s\n", c->id, why);
+}
+
+/* Queue a masked text frame; sent now if the socket takes it */
+static void ws_send_text(struct lg_client *c, char const *msg)
+{
+  size_t const len = strlen(msg);
+  if (c->out_len + len + 8 > sizeof(c->out))
+    return; /* server isn't reading; the command is dropped like a stalled browser's */
+  uint8_t *p = c->out + c->out_len;
+  *p++ = 0x81; /* FIN + text */
+  if (len < 126) {
+    *p++ = 0x80 | (uint8_t)len;
+  } else {
+    *p++ = 0x80 | 126;
+    *p++ = (uint8_t)(len >> 8);
+    *p++ = (uint8_t)len;
+  }
+  uint32_t const key = lg_rand(c);
+  uint8_t const mask[4] = { key >> 24, key >> 16, key >> 8, key };
+  memcpy(p, mask, 4);
+  p += 4;
+  for (size_t i = 0; i < len; i++)
+    *p++ = (uint8_t)msg[i] ^ mask[i & 3];
+  c->out_len = (size_t)(p - c->out);
+  c->cmds++;
+
+  ssize_t const n = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL);
+  if (n > 0) {
+    memmove(c->out, c->out + n, c->out_len - (size_t)n);
+    c->out_len -= (size_t)n;
+  }
+}
+
+/* Send `cmd` wrapped as C:<clientId>:<seq>:<cmd> and remember it for ACK matching */
+static void ws_send_wrapped(struct lg_client *c, char const *cmd, uint64_t now)
+{
+  char msg[128];
+  uint32_t const seq = ++c->seq;
+  snprintf(msg, sizeof(msg), "C:%s:%u:%s", c->cid, seq, cmd);
+  ws_send_text(c, msg);
+  struct lg_pending_ack *slot = &c->acks[seq % LG_ACKS];
+  if (slot->used)
+    c->ack_lost++; /* overwritten before it was acknowledged */
+  slot->used = true;
+  slot->seq = seq;
+  slot->retries = 0;
+  slot->sent_ns = now;
+  strlcpy(slot->msg, msg, sizeof(slot->msg));
+}
+
+static bool preset_is_cw(int preset)
+{
+  return strncmp(Presets[preset], "cw", 2) == 0;
+}
+
+static void send_freq(struct lg_client *c, double khz, uint64_t now)
+{
+  char cmd[48];
+  c->freq_khz = khz;
+  snprintf(cmd, sizeof(cmd), "F:%.3f", khz);
+  ws_send_wrapped(c, cmd, now);
+  double const hz = round(khz * 1000);
+  if (preset_is_cw(c->preset) || fabs(hz - c->last_bfreq_hz) <= 1)
+    return; /* no BFREQ to wait for */
+  int oldest = 0;
+  for (int i = 0; i < LG_PENDING; i++) {
+    if (!c->pending[i].used) {
+      oldest = i;
+      break;
+    }
+    if (c->pending[i].sent_ns < c->pending[oldest].sent_ns)
+      oldest = i;
+  }
+  if (c->pending[oldest].used)
+    c->bfreq_superseded++;
+  c->pending[oldest] = (struct lg_pending_freq){ .used = true, .hz = hz, .sent_ns = now };
+}
+
+static double random_freq(struct lg_client *c)
+{
+  return round(Base_khz + lg_uniform(c) * Span_khz);
+}
+
+/* What radio.js sends on open */
+static void client_opened(struct lg_client *c, uint64_t now)
+{
+  char cmd[48];
+  ws_send_text(c, "Q:8");
+  ws_send_text(c, "R:100:2000");
+  ws_send_text(c, "S:STOP");
+  ws_send_text(c, "S:");
+  c->spectrum_on = true;
+  snprintf(cmd, sizeof(cmd), "M:%s", Presets[c->preset]);
+  ws_send_wrapped(c, cmd, now);
+  send_freq(c, c->freq_khz, now);
+  snprintf(cmd, sizeof(cmd), "Z:%d", c->zoom);
+  ws_send_wrapped(c, cmd, now);
+  snprintf(cmd, sizeof(cmd), "Z:c:%.3f", c->freq_khz);
+  ws_send_wrapped(c, cmd, now);
+  if (c->wants_opus)
+    ws_send_text(c, "O:OPUS");
+  if (c->wants_audio) {
+    ws_send_text(c, "A:START");
+    c->audio_on = true;
+  }
+  c->next_action_ns = now + (uint64_t)(-log(1 - lg_uniform(c)) * Action_ms * 1e6);
+}
+
+/* One step of the command mix */
+static void client_action(struct lg_client *c, uint64_t now)
+{
+  char cmd[48];
+  if (c->drag_left > 0) {
+    c->drag_left--;
+    send_freq(c, c->freq_khz + c->drag_step_khz, now);
+    c->next_action_ns = now + 40 * 1000000ULL;
+    return;
+  }
+  c->next_action_ns = now + (uint64_t)(-log(1 - lg_uniform(c)) * Action_ms * 1e6);
+  if (!c->spectrum_on) {
+    ws_send_text(c, "S:");
+    c->spectrum_on = true;
+    return;
+  }
+  if (c->wants_audio && !c->audio_on) {
+    ws_send_text(c, "A:START");
+    c->audio_on = true;
+    return;
+  }
+  double const r = lg_uniform(c) * 100;
+  if (r < 35) {
+    c->drag_left = 8 + (int)(lg_rand(c) % 13);
+    c->drag_step_khz = (lg_rand(c) & 1 ? 1 : -1) * (0.1 + 0.1 * (lg_rand(c) % 5));
+    c->next_action_ns = now;
+  } else if (r < 50) {
+    send_freq(c, random_freq(c), now);
+  } else if (r < 65) {
+    int const k = lg_rand(c) % 3;
+    if (k == 0 && c->zoom < LG_ZOOM_LEVELS - 1) {
+      c->zoom++;
+      ws_send_wrapped(c, "Z:+", now);
+    } else if (k == 1 && c->zoom > 1) {
+      c->zoom--;
+      ws_send_wrapped(c, "Z:-", now);
+    } else {
+      c->zoom = 1 + (int)(lg_rand(c) % (LG_ZOOM_LEVELS - 1));
+      snprintf(cmd, sizeof(cmd), "Z:%d", c->zoom);
+      ws_send_wrapped(c, cmd, now);
+    }
+  } else if (r < 75) {
+    snprintf(cmd, sizeof(cmd), "Z:c:%.3f", c->freq_khz);
+    ws_send_wrapped(c, cmd, now);
+  } else if (r < 90) {
+    c->preset = (int)(lg_rand(c) % NPRESETS);
+    snprintf(cmd, sizeof(cmd), "M:%s", Presets[c->preset]);
+    ws_send_wrapped(c, cmd, now);
+  } else if (r < 95) {
+    ws_send_text(c, "S:STOP");
+    c->spectrum_on = false;
+    c->spectrum.last_ns = 0; /* the pause is not a gap */
+  } else if (c->wants_audio) {
+    ws_send_text(c, "A:STOP");
+    c->audio_on = false;
+    c->audio.last_ns = 0;
+  }
+}
+
+static void client_close(struct lg_client *c, uint64_t now, char const *why)
+{
+  if (c->fd >= 0)
+    close(c->fd); /* also leaves the epoll set */
+  c->fd = -1;
+  if (c->state == LG_OPEN && c->busy_now) {
+    c->open_ns += now - c->state_ns;
+  } else if (c->state == LG_OPEN) {
+    c->disconnects++;
+    c->open_ns += now - c->state_ns;
+    c->backoff_ms = 1000; /* the browser starts over after a connection that worked */
+    if (Verbose)
+      fprintf(stderr, "client %d (ssrc %u): disconnected: %s\n", c->id, c->ssrc, why);
+  } else {
+    c->failed++;
+    if (Verbose > 1)
+      fprintf(stderr, "client %d: connect failed: %s\n", c->id, why);
+  }
+  c->busy_now = false;
+  c->in_len = 0;
+  c->out_len = 0;
+  c->spectrum.last_ns = c->status.last_ns = c->audio.last_ns = 0;
+  c->audio_seq_valid = false;
+  memset(c->pending, 0, sizeof(c->pending));
+  memset(c->acks, 0, sizeof(c->acks));
+  c->state = Stop ? LG_DONE : LG_IDLE;
+  c->state_ns = now + c->backoff_ms * 1000000ULL;
+  c->backoff_ms = c->backoff_ms * 2 > 30000 ? 30000 : c->backoff_ms * 2;
+}
+
+static void client_connect(struct lg_worker *w, struct lg_client *c, uint64_t now)
+{
+  c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (c->fd < 0) {
+    perror("socket");
+    c->state_ns = now + c->backoff_ms * 1000000ULL;
+    return;
+  }
+  int const one = 1;
+  setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (c->bind_src && bind(c->fd, (struct sockaddr *)&c->src, sizeof(c->src)) != 0) {
+    perror("bind");
+    close(c->fd);
+    c->fd = -1;
+    c->state_ns = now + c->backoff_ms * 1000000ULL;
+    return;
+  }
+  c->state = LG_CONNECTING;
+  c->state_ns = now;
+  c->connects++;
+  if (connect(c->fd, (struct sockaddr *)&Server, sizeof(Server)) != 0 && errno != EINPROGRESS) {
+    client_close(c, now, strerror(errno));
+    return;
+  }
+  struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP, .data.ptr = c };
+  c->ep = w->ep;
+  c->want_out = true;
+  if (epoll_ctl(w->ep, EPOLL_CTL_ADD, c->fd, &ev) != 0) {
+    perror("epoll_ctl");
+    client_close(c, now, "epoll");
+  }
+}
+
+static void client_handshake(struct lg_client *c)
+{
+  uint8_t key[16];
+  for (int i = 0; i < 16; i++)
+    key[i] = (uint8_t)lg_rand(c);
+  static char const b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char key64[25];
+  int k = 0;
+  for (int i = 0; i < 16; i += 3) {
+    uint32_t v = (uint32_t)key[i] << 16 | (i + 1 < 16 ? key[i + 1] << 8 : 0) | (i + 2 < 16 ? key[i + 2] : 0);
+    key64[k++] = b64[(v >> 18) & 63];
+    key64[k++] = b64[(v >> 12) & 63];
+    key64[k++] = i + 1 < 16 ? b64[(v >> 6) & 63] : '=';
+    key64[k++] = i + 2 < 16 ? b64[v & 63] : '=';
+  }
+  key64[k] = '\0';
+  int const n = snprintf((char *)c->out, sizeof(c->out),
+                         "GET / HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                         "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\nOrigin: http://%s\r\n"
+                         "User-Agent: ws-loadgen/%d\r\n\r\n",
+                         Host_header, key64, Host_header, c->id);
+  c->out_len = (size_t)n;
+}
+
+static uint32_t get_be32(uint8_t const *p)
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/* Walk a channel data TLV list: type, length (long form 0x80|n), value */
+static bool tlv_ok(uint8_t const *p, size_t len)
+{
+  size_t i = 0;
+  while (i < len) {
+    if (p[i] == 0) /* EOL */
+      return true;
+    if (i + 2 > len)
+      return false;
+    size_t optlen = p[i + 1];
+    i += 2;
+    if (optlen & 0x80) {
+      int const nb = optlen & 0x7f;
+      if (nb > 4 || i + nb > len)
+        return false;
+      optlen = 0;
+      for (int k = 0; k < nb; k++)
+        optlen = optlen << 8 | p[i++];
+    }
+    if (i + optlen > len)
+      return false;
+    i += optlen;
+  }
+  return true;
+}
+
+static void on_binary(struct lg_client *c, uint8_t const *p, size_t len, uint64_t now)
+{
+  if (len < 12 || (p[0] >> 6) != 2) {
+    invalid(c, "short or not RTP v2");
+    return;
+  }
+  size_t hlen = 12 + 4 * (p[0] & 0x0f);
+  if (p[0] & 0x10) {
+    if (len < hlen + 4) {
+      invalid(c, "truncated RTP extension");
+      return;
+    }
+    hlen += 4 + 4 * (((size_t)p[hlen + 2] << 8) | p[hlen + 3]);
+  }
+  if (len < hlen) {
+    invalid(c, "truncated RTP header");
+    return;
+  }
+  int const type = p[1] & 0x7f;
+  uint16_t const seq = (uint16_t)(p[2] << 8 | p[3]);
+  uint32_t const ssrc = get_be32(p + 8);
+  uint8_t const *dp = p + hlen;
+  size_t const dlen = len - hlen;
+
+  switch (type) {
+  case 0x7C:
+  case 0x7D:
+  case 0x7F:
+    if (c->have_ssrc && ssrc != c->ssrc + 1) {
+      invalid(c, "spectrum SSRC");
+      return;
+    }
+    if (dlen < LG_SPECTRUM_META + (type == 0x7F ? 1 : 4)) {
+      invalid(c, "truncated spectrum header");
+      return;
+    }
+    {
+      uint32_t const bins = get_be32(dp);
+      if (bins == 0 || bins > 65536) {
+        invalid(c, "spectrum bin count");
+        return;
+      }
+      if (type != 0x7F) {
+        uint8_t const *v = dp + LG_SPECTRUM_META;
+        int const bits = v[1];
+        unsigned const count = v[2] | v[3] << 8;
+        if (v[0] != 2 || (bits != 4 && bits != 8 && bits != 16)) {
+          invalid(c, "spectrum frame version/bits");
+          return;
+        }
+        if (count == 0 || count > bins) {
+          invalid(c, "spectrum code count");
+          return;
+        }
+        size_t const codes = dlen - LG_SPECTRUM_META - 4;
+        if (type == 0x7D && codes != ((size_t)count * bits + 7) / 8) {
+          invalid(c, "spectrum length vs code count");
+          return;
+        }
+      }
+    }
+    flow_add(&c->spectrum, len, now);
+    return;
+  case 0x7E:
+    if (!c->have_ssrc && ssrc % 2 == 0) {
+      c->ssrc = ssrc;
+      c->have_ssrc = true;
+    }
+    if (ssrc != c->ssrc) {
+      invalid(c, "channel data SSRC");
+      return;
+    }
+    if (!tlv_ok(dp, dlen)) {
+      invalid(c, "channel data TLV");
+      return;
+    }
+    flow_add(&c->status, len, now);
+    return;
+  default:
+    if (c->have_ssrc && ssrc != c->ssrc) {
+      invalid(c, "audio SSRC");
+      return;
+    }
+    if (dlen == 0 || (type != LG_OPUS_PT && dlen % 2 != 0)) {
+      invalid(c, "audio payload length");
+      return;
+    }
+    if (c->audio_seq_valid) {
+      uint16_t const d = (uint16_t)(seq - c->audio_seq);
+      if (d == 0 || d >= 0x8000) {
+        c->audio_reordered++;
+        flow_add(&c->audio, len, now);
+        return;
+      }
+      c->audio_lost += d - 1u;
+    }
+    c->audio_seq = seq;
+    c->audio_seq_valid = true;
+    flow_add(&c->audio, len, now);
+    return;
+  }
+}
+
+static void on_bfreq(struct lg_client *c, double hz, uint64_t now)
+{
+  c->last_bfreq_hz = hz;
+  int match = -1;
+  for (int i = 0; i < LG_PENDING; i++)
+    if (c->pending[i].used && fabs(c->pending[i].hz - hz) <= 1
+        && (match < 0 || c->pending[i].sent_ns > c->pending[match].sent_ns))
+      match = i;
+  if (match < 0)
+    return;
+  uint64_t const sent = c->pending[match].sent_ns;
+  double const ms = (now - sent) / 1e6;
+  c->bfreq_ms[c->bfreq_n % LG_SAMPLES] = (float)ms;
+  c->bfreq_n++;
+  c->bfreq_sum_ms += ms;
+  if (ms > c->bfreq_max_ms)
+    c->bfreq_max_ms = ms;
+  /* Anything sent before it was overtaken by this answer (a drag's middle steps) */
+  for (int i = 0; i < LG_PENDING; i++) {
+    if (c->pending[i].used && c->pending[i].sent_ns <= sent) {
+      if (i != match)
+        c->bfreq_superseded++;
+      c->pending[i].used = false;
+    }
+  }
+}
+
+static void on_text(struct lg_client *c, char *msg, uint64_t now)
+{
+  c->text++;
+  if (strncmp(msg, "BFREQ:", 6) == 0) {
+    on_bfreq(c, strtod(msg + 6, NULL), now);
+  } else if (strncmp(msg, "ACK:", 4) == 0) {
+    char *cid = msg + 4;
+    char *colon = strchr(cid, ':');
+    if (colon == NULL || (size_t)(colon - cid) != strlen(c->cid) || strncmp(cid, c->cid, strlen(c->cid)) != 0) {
+      invalid(c, "ACK for another client");
+      return;
+    }
+    uint32_t const seq = (uint32_t)strtoul(colon + 1, NULL, 10);
+    struct lg_pending_ack *a = &c->acks[seq % LG_ACKS];
+    if (a->used && a->seq == seq) {
+      double const ms = (now - a->sent_ns) / 1e6;
+      c->acked++;
+      c->ack_sum_ms += ms;
+      if (ms > c->ack_max_ms)
+        c->ack_max_ms = ms;
+      a->used = false;
+    }
+  } else if (msg[0] == 'S' && msg[1] == ':') {
+    long long const v = strtoll(msg + 2, NULL, 10);
+    c->ssrc = (uint32_t)v;
+    c->have_ssrc = true;
+  } else if (strncmp(msg, "BUSY", 4) == 0) {
+    c->busy++;
+    c->busy_now = true;
+  }
+}
+
+/* Parse complete frames out of the input buffer; false if the connection must go */
+static bool parse_frames(struct lg_client *c, uint64_t now)
+{
+  size_t off = 0;
+  bool ok = true;
+  while (ok && c->in_len - off >= 2) {
+    uint8_t const *p = c->in + off;
+    size_t const avail = c->in_len - off;
+    int const opcode = p[0] & 0x0f;
+    bool const fin = p[0] & 0x80;
+    uint64_t len = p[1] & 0x7f;
+    size_t h = 2;
+    if (p[1] & 0x80) {
+      invalid(c, "masked server frame");
+      ok = false;
+      break;
+    }
+    if (len == 126) {
+      if (avail < 4)
+        break;
+      len = (uint64_t)p[2] << 8 | p[3];
+      h = 4;
+    } else if (len == 127) {
+      if (avail < 10)
+        break;
+      len = 0;
+      for (int i = 0; i < 8; i++)
+        len = len << 8 | p[2 + i];
+      h = 10;
+    }
+    if (len > LG_MAX_FRAME) {
+      invalid(c, "oversized frame");
+      ok = false;
+      break;
+    }
+    if (avail < h + len)
+      break;
+    uint8_t *payload = c->in + off + h;
+    off += h + (size_t)len;
+    if (!fin || opcode == 0) {
+      invalid(c, "fragmented frame"); /* ka9q-web never fragments */
+      continue;
+    }
+    switch (opcode) {
+    case 1:
+      {
+        char msg[512];
+        size_t const n = len < sizeof(msg) - 1 ? (size_t)len : sizeof(msg) - 1;
+        memcpy(msg, payload, n);
+        msg[n] = '\0';
+        on_text(c, msg, now);
+      }
+      break;
+    case 2:
+      on_binary(c, payload, (size_t)len, now);
+      break;
+    case 8:
+      ok = false; /* server close */
+      break;
+    case 9:
+      {
+        /* pong with the ping's payload */
+        uint8_t pong[2 + 4 + 125];
+        size_t const n = len > 125 ? 125 : (size_t)len;
+        pong[0] = 0x8a;
+        pong[1] = 0x80 | (uint8_t)n;
+        memset(pong + 2, 0, 4); /* zero mask */
+        memcpy(pong + 6, payload, n);
+        if (c->out_len + 6 + n <= sizeof(c->out)) {
+          memcpy(c->out + c->out_len, pong, 6 + n);
+          c->out_len += 6 + n;
+        }
+      }
+      break;
+    case 10:
+      break;
+    default:
+      invalid(c, "unknown opcode");
+      break;
+    }
+  }
+  memmove(c->in, c->in + off, c->in_len - off);
+  c->in_len -= off;
+  return ok;
+}
+
+/* Read what the socket has; false on EOF or error */
+static bool client_read(struct lg_client *c)
+{
+  for (;;) {
+    if (c->in_cap - c->in_len < 65536) {
+      size_t const cap = c->in_cap ? c->in_cap * 2 : 262144;
+      if (cap > 2 * LG_MAX_FRAME + 65536)
+        return false;
+      uint8_t *in = realloc(c->in, cap);
+      if (in == NULL)
+        return false;
+      c->in = in;
+      c->in_cap = cap;
+    }
+    ssize_t const n = recv(c->fd, c->in + c->in_len, c->in_cap - c->in_len, 0);
+    if (n > 0) {
+      c->in_len += (size_t)n;
+      continue;
+    }
+    if (n == 0)
+      return false;
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  }
+}
+
+static bool client_flush(struct lg_client *c)
+{
+  while (c->out_len > 0) {
+    ssize_t const n = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL);
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    memmove(c->out, c->out + n, c->out_len - (size_t)n);
+    c->out_len -= (size_t)n;
+  }
+  return true;
+}
+
+/* Ask for EPOLLOUT only while output is queued; it is level-triggered */
+static void client_arm(struct lg_client *c)
+{
+  bool const want = c->out_len > 0 || c->state == LG_CONNECTING;
+  if (c->fd < 0 || want == c->want_out)
+    return;
+  struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | (want ? EPOLLOUT : 0), .data.ptr = c };
+  if (epoll_ctl(c->ep, EPOLL_CTL_MOD, c->fd, &ev) == 0)
+    c->want_out = want;
+}
+
+static void client_event(struct lg_client *c, uint32_t events, uint64_t now)
+{
+  if (c->state == LG_CONNECTING) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0) {
+      client_close(c, now, strerror(err));
+      return;
+    }
+    if (!(events & EPOLLOUT))
+      return;
+    client_handshake(c);
+    c->state = LG_HANDSHAKE;
+    c->state_ns = now;
+  }
+  if ((events & EPOLLOUT) && !client_flush(c)) {
+    client_close(c, now, strerror(errno));
+    return;
+  }
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    bool const alive = client_read(c);
+    if (c->state == LG_HANDSHAKE) {
+      uint8_t *end = memmem(c->in, c->in_len, "\r\n\r\n", 4);
+      if (end != NULL) {
+        if (c->in_len < 12 || memcmp(c->in, "HTTP/1.1 101", 12) != 0) {
+          client_close(c, now, "upgrade refused");
+          return;
+        }
+        size_t const hlen = (size_t)(end + 4 - c->in);
+        memmove(c->in, c->in + hlen, c->in_len - hlen);
+        c->in_len -= hlen;
+        c->state = LG_OPEN;
+        c->state_ns = now;
+        client_opened(c, now);
+      }
+    }
+    if (c->state == LG_OPEN && !parse_frames(c, now)) {
+      client_close(c, now, "server closed");
+      return;
+    }
+    if (!alive) {
+      client_close(c, now, c->busy_now ? "busy" : "connection lost");
+      return;
+    }
+  }
+  client_arm(c);
+}
+
+/* Timers: reconnects, handshake timeout, the command mix and ACK/BFREQ expiry */
+static void client_tick(struct lg_worker *w, struct lg_client *c, uint64_t now)
+{
+  switch (c->state) {
+  case LG_IDLE:
+    if (Stop)
+      c->state = LG_DONE;
+    else if (now >= c->state_ns)
+      client_connect(w, c, now);
+    return;
+  case LG_CONNECTING:
+  case LG_HANDSHAKE:
+    if (now - c->state_ns > LG_HANDSHAKE_TIMEOUT_MS * 1000000ULL)
+      client_close(c, now, "handshake timeout");
+    return;
+  case LG_OPEN:
+    break;
+  default:
+    return;
+  }
+  if (Stop) {
+    c->open_ns += now - c->state_ns;
+    close(c->fd);
+    c->fd = -1;
+    c->state = LG_DONE;
+    c->open_at_stop = true;
+    return;
+  }
+  if (now >= c->next_action_ns)
+    client_action(c, now);
+  for (int i = 0; i < LG_ACKS; i++) {
+    struct lg_pending_ack *a = &c->acks[i];
+    if (!a->used || now - a->sent_ns < LG_ACK_TIMEOUT_MS * 1000000ULL)
+      continue;
+    if (a->retries >= LG_ACK_RETRIES) {
+      c->ack_lost++;
+      a->used = false;
+      continue;
+    }
+    a->retries++;
+    a->sent_ns = now;
+    c->ack_retries++;
+    ws_send_text(c, a->msg);
+  }
+  for (int i = 0; i < LG_PENDING; i++) {
+    if (c->pending[i].used && now - c->pending[i].sent_ns > LG_BFREQ_TIMEOUT_MS * 1000000ULL) {
+      c->pending[i].used = false;
+      c->bfreq_timeouts++;
+    }
+  }
+  if (c->out_len > 0 && !client_flush(c)) {
+    client_close(c, now, strerror(errno));
+    return;
+  }
+  client_arm(c);
+}
+
+static void *worker_thread(void *arg)
+{
+  struct lg_worker *w = arg;
+  struct epoll_event events[64];
+  for (;;) {
+    uint64_t now = mono_ns();
+    bool done = true;
+    pthread_mutex_lock(&w->mutex);
+    for (int i = 0; i < w->nclients; i++) {
+      client_tick(w, &w->clients[i], now);
+      if (w->clients[i].state != LG_DONE)
+        done = false;
+    }
+    pthread_mutex_unlock(&w->mutex);
+    if (done)
+      break;
+    int const n = epoll_wait(w->ep, events, 64, 10);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      break;
+    }
+    now = mono_ns();
+    pthread_mutex_lock(&w->mutex);
+    for (int i = 0; i < n; i++) {
+      struct lg_client *c = events[i].data.ptr;
+      if (c->fd >= 0)
+        client_event(c, events[i].events, now);
+    }
+    pthread_mutex_unlock(&w->mutex);
+  }
+  return NULL;
+}
+
+static int cmp_float(void const *a, void const *b)
+{
+  float const x = *(float const *)a, y = *(float const *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(float *v, size_t n, double pct)
+{
+  if (n == 0)
+    return NAN;
+  size_t i = (size_t)ceil(pct / 100 * n);
+  return v[i > 0 ? i - 1 : 0];
+}
+
+/* Aggregate line (every -p seconds), then the per-client table at the end */
+static void report(bool final)
+{
+  double const t = (mono_ns() - Start_ns) / 1e9;
+  uint64_t const now = mono_ns();
+  int nopen = 0;
+  uint64_t spectrum = 0, status = 0, audio = 0, invalid_frames = 0, disconnects = 0, busy = 0;
+  uint64_t acked = 0, ack_retries = 0, ack_lost = 0;
+  uint64_t timeouts = 0;
+  double ack_sum = 0;
+  size_t nsamples = 0;
+  float *samples = malloc(sizeof(float) * LG_SAMPLES * (size_t)Nclients);
+
+  for (int k = 0; k < Nthreads; k++)
+    pthread_mutex_lock(&Workers[k].mutex);
+  for (int i = 0; i < Nclients; i++) {
+    struct lg_client const *c = &Clients[i];
+    nopen += c->state == LG_OPEN || c->open_at_stop;
+    spectrum += c->spectrum.frames;
+    status += c->status.frames;
+    audio += c->audio.frames;
+    invalid_frames += c->invalid;
+    disconnects += c->disconnects;
+    busy += c->busy;
+    acked += c->acked;
+    ack_retries += c->ack_retries;
+    ack_lost += c->ack_lost;
+    ack_sum += c->ack_sum_ms;
+    timeouts += c->bfreq_timeouts;
+    size_t const n = c->bfreq_n < LG_SAMPLES ? c->bfreq_n : LG_SAMPLES;
+    if (samples != NULL) {
+      memcpy(samples + nsamples, c->bfreq_ms, n * sizeof(float));
+      nsamples += n;
+    }
+  }
+
+  if (samples != NULL)
+    qsort(samples, nsamples, sizeof(float), cmp_float);
+  printf("%7.1fs: %d/%d open, frames/s spectrum %.1f status %.1f audio %.1f, invalid %llu, disconnects %llu, busy %llu, "
+         "ACK %.1f ms avg (%llu resent, %llu lost), BFREQ p50/p95/max %.1f/%.1f/%.1f ms (%llu timeouts)\n",
+         t, nopen, Nclients, spectrum / t, status / t, audio / t,
+         (unsigned long long)invalid_frames, (unsigned long long)disconnects, (unsigned long long)busy,
+         acked ? ack_sum / acked : 0.0, (unsigned long long)ack_retries, (unsigned long long)ack_lost,
+         percentile(samples, nsamples, 50), percentile(samples, nsamples, 95),
+         nsamples ? samples[nsamples - 1] : NAN, (unsigned long long)timeouts);
+
+  if (final) {
+    printf("\n%6s %10s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s %7s %7s %6s %5s\n",
+           "client", "ssrc", "spec/s", "spec-jit", "spec-max", "stat/s", "audio/s", "aud-jit", "aud-lost",
+           "bfreq-n", "bfreq-p50", "bfreq-max", "ack-ms", "invalid", "disc", "busy");
+    for (int i = 0; i < Nclients; i++) {
+      struct lg_client *c = &Clients[i];
+      double open_s = (c->open_ns + (c->state == LG_OPEN ? now - c->state_ns : 0)) / 1e9;
+      if (open_s <= 0)
+        open_s = NAN;
+      size_t const n = c->bfreq_n < LG_SAMPLES ? c->bfreq_n : LG_SAMPLES;
+      qsort(c->bfreq_ms, n, sizeof(float), cmp_float);
+      printf("%6d %10u %8.2f %8.1f %8.1f %8.2f %8.2f %8.1f %8llu %8llu %8.1f %8.1f %7.1f %7llu %6llu %5llu\n",
+             c->id, c->ssrc, c->spectrum.frames / open_s, flow_jitter_ms(&c->spectrum), c->spectrum.max_gap_ms,
+             c->status.frames / open_s, c->audio.frames / open_s, flow_jitter_ms(&c->audio),
+             (unsigned long long)c->audio_lost, (unsigned long long)c->bfreq_n,
+             percentile(c->bfreq_ms, n, 50), c->bfreq_max_ms,
+             c->acked ? c->ack_sum_ms / c->acked : 0.0, (unsigned long long)c->invalid,
+             (unsigned long long)c->disconnects, (unsigned long long)c->busy);
+      if (c->invalid && Verbose)
+        printf("       last invalid: %s\n", c->last_invalid);
+    }
+  }
+  for (int k = 0; k < Nthreads; k++)
+    pthread_mutex_unlock(&Workers[k].mutex);
+  fflush(stdout);
+  free(samples);
+}
+
+static void on_signal(int sig)
+{
+  (void)sig;
+  Stop = 1;
+}
+
+static void usage(char const *name)
+{
+  fprintf(stderr, "Usage: %s [-n clients] [-t threads] [-r ramp_ms] [-c action_ms] [-d duration_s] [-p report_s] "
+          "[-a audio_pct] [-O opus_pct] [-f base_khz[:span_khz]] [-b first_source_addr|none] [-v] [host[:port]]\n", name);
+  exit(EX_USAGE);
+}
+
+int main(int argc, char *argv[])
+{
+  char const *bind_base = NULL;
+  int c;
+  while ((c = getopt(argc, argv, "n:t:r:c:d:p:a:O:f:b:vh")) != -1) {
+    switch (c) {
+    case 'n': Nclients = atoi(optarg); break;
+    case 't': Nthreads = atoi(optarg); break;
+    case 'r': Ramp_ms = atoi(optarg); break;
+    case 'c': Action_ms = atoi(optarg); break;
+    case 'd': Duration_s = atoi(optarg); break;
+    case 'p': Report_s = atoi(optarg); break;
+    case 'a': Audio_pct = atoi(optarg); break;
+    case 'O': Opus_pct = atoi(optarg); break;
+    case 'f':
+      {
+        char *end;
+        Base_khz = strtod(optarg, &end);
+        if (*end == ':')
+          Span_khz = strtod(end + 1, NULL);
+      }
+      break;
+    case 'b': bind_base = optarg; break;
+    case 'v': Verbose++; break;
+    default: usage(argv[0]);
+    }
+  }
+  if (Nclients < 1 || Nclients > LG_MAX_CLIENTS || Nthreads < 1 || Action_ms < 1 || Ramp_ms < 0)
+    usage(argv[0]);
+  if (Nthreads > LG_MAX_THREADS)
+    Nthreads = LG_MAX_THREADS;
+  if (Nthreads > Nclients)
+    Nthreads = Nclients;
+
+  /* host[:port], default the local server on ka9q-web's default port */
+  char host[256] = "127.0.0.1";
+  char const *port = "8081";
+  if (optind < argc) {
+    strlcpy(host, argv[optind], sizeof(host));
+    char *colon = strrchr(host, ':');
+    if (colon != NULL) {
+      *colon = '\0';
+      port = argv[optind] + (colon - host) + 1;
+    }
+  }
+  struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *ai;
+  int const r = getaddrinfo(host, port, &hints, &ai);
+  if (r != 0) {
+    fprintf(stderr, "%s:%s: %s\n", host, port, gai_strerror(r));
+    exit(EX_NOHOST);
+  }
+  memcpy(&Server, ai->ai_addr, sizeof(Server));
+  freeaddrinfo(ai);
+  snprintf(Host_header, sizeof(Host_header), "%s:%s", host, port);
+
+  struct in_addr src_base = { 0 };
+  bool const loopback = (ntohl(Server.sin_addr.s_addr) >> 24) == 127;
+  if (bind_base == NULL && loopback)
+    bind_base = "127.1.0.1";
+  if (bind_base != NULL && strcmp(bind_base, "none") == 0)
+    bind_base = NULL;
+  if (bind_base != NULL && inet_pton(AF_INET, bind_base, &src_base) != 1) {
+    fprintf(stderr, "bad source address %s\n", bind_base);
+    exit(EX_USAGE);
+  }
+
+  Clients = calloc((size_t)Nclients, sizeof(*Clients));
+  if (Clients == NULL) {
+    perror("calloc");
+    exit(EX_OSERR);
+  }
+  Start_ns = mono_ns();
+  for (int i = 0; i < Nclients; i++) {
+    struct lg_client *cl = &Clients[i];
+    cl->id = i;
+    cl->fd = -1;
+    cl->rng = 2463534242u ^ (uint32_t)(i * 2654435761u);
+    if (cl->rng == 0)
+      cl->rng = 1;
+    cl->state = LG_IDLE;
+    cl->state_ns = Start_ns + (uint64_t)i * Ramp_ms * 1000000ULL;
+    cl->backoff_ms = 1000;
+    cl->bind_src = bind_base != NULL;
+    cl->src.sin_family = AF_INET;
+    cl->src.sin_addr.s_addr = htonl(ntohl(src_base.s_addr) + (uint32_t)i);
+    snprintf(cl->cid, sizeof(cl->cid), "lg%08x", lg_rand(cl));
+    cl->freq_khz = random_freq(cl);
+    cl->last_bfreq_hz = NAN;
+    cl->zoom = 1 + (int)(lg_rand(cl) % 12);
+    cl->preset = (int)(lg_rand(cl) % NPRESETS);
+    cl->wants_audio = (int)(lg_rand(cl) % 100) < Audio_pct;
+    cl->wants_opus = (int)(lg_rand(cl) % 100) < Opus_pct;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+  fprintf(stderr, "ws-loadgen: %d clients on %d threads against %s, source %s\n",
+          Nclients, Nthreads, Host_header, bind_base ? bind_base : "default");
+
+  /* Each worker owns a contiguous slice of the clients */
+  int const per = (Nclients + Nthreads - 1) / Nthreads;
+  for (int t = 0; t < Nthreads; t++) {
+    struct lg_worker *w = &Workers[t];
+    pthread_mutex_init(&w->mutex, NULL);
+    w->clients = Clients + t * per;
+    w->nclients = t * per + per > Nclients ? Nclients - t * per : per;
+    w->ep = epoll_create1(EPOLL_CLOEXEC);
+    if (w->ep < 0) {
+      perror("epoll_create1");
+      exit(EX_OSERR);
+    }
+    if (w->nclients > 0 && pthread_create(&w->thread, NULL, worker_thread, w) != 0) {
+      perror("pthread_create");
+      exit(EX_OSERR);
+    }
+  }
+
+  uint64_t next_report = Start_ns + (uint64_t)Report_s * 1000000000ULL;
+  while (!Stop) {
+    usleep(100000);
+    uint64_t const now = mono_ns();
+    if (Duration_s > 0 && now - Start_ns >= (uint64_t)Duration_s * 1000000000ULL)
+      Stop = 1;
+    if (!Stop && Report_s > 0 && now >= next_report) {
+      report(false);
+      next_report += (uint64_t)Report_s * 1000000000ULL;
+    }
+  }
+  for (int t = 0; t < Nthreads; t++)
+    if (Workers[t].nclients > 0)
+      pthread_join(Workers[t].thread, NULL);
+  report(true);
+  return 0;
+}